@@ -0,0 +1,638 @@
+// Standalone latency and throughput benchmark for MyExchange. Replays
+// synthetic order flows, times every InsertOrder and DeleteOrder call with the
+// TSC and reports ops/sec and latency percentiles per operation type.
+//
+//     bench.out [--ops N] [--ladder LEVELS] [--flow NAME] [--out FILE]
+//               [--baseline FILE] [--tolerance FRACTION] [--cpu N] [--arena MB]
+//
+// --cpu pins the benchmark to a core and --arena places the order pool in
+// that many MB of prefaulted huge pages on its node, see PlacementConfig.
+//
+// The replay flow journals a uniform run and times MyExchange::Replay, which
+// has no per record latency, so only its throughput and mean are reported.
+//
+// Results are written as CSV to --out (bench_results.csv by default). With
+// --baseline the results are compared against an earlier CSV and the exit
+// status is 1 if any throughput dropped or p99 latency grew by more than
+// --tolerance (0.10 by default).
+
+#include "LatencyHistogram.h"
+#include "MyExchange.h"
+#include "Tsc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchOptions
+{
+    // Measured operations per flow, prefill is not counted
+    std::size_t operations{1000000};
+    std::size_t ladder_levels{0};
+    int         cpu{-1};
+    std::size_t arena_mb{0};
+    // Run only this flow when not empty
+    std::string flow;
+    std::string output{"bench_results.csv"};
+    std::string baseline;
+    double      tolerance{0.10};
+};
+
+// Latency of one operation type, in TSC ticks
+struct OperationStats
+{
+    LatencyHistogram latency;
+    std::uint64_t    total_ticks{0};
+
+    void Record(std::uint64_t ticks)
+    {
+        latency.Record(ticks);
+        total_ticks += ticks;
+    }
+};
+
+struct ResultRow
+{
+    std::string   flow;
+    std::string   operation;
+    std::uint64_t count;
+    double        ops_per_sec;
+    double        mean_ns;
+    double        p50_ns;
+    double        p99_ns;
+    double        p999_ns;
+    double        max_ns;
+};
+
+// Samples ranks 1..n with probability proportional to 1 / rank^exponent
+class ZipfDistribution
+{
+  public:
+    ZipfDistribution(std::size_t n, double exponent) : m_cdf(n)
+    {
+        double sum = 0;
+        for (std::size_t rank = 1; rank <= n; ++rank)
+        {
+            sum += 1.0 / std::pow(double(rank), exponent);
+            m_cdf[rank - 1] = sum;
+        }
+        for (double& value : m_cdf)
+        {
+            value /= sum;
+        }
+    }
+
+    template <typename Rng>
+    std::size_t operator()(Rng& rng)
+    {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return std::size_t(std::lower_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin()) + 1;
+    }
+
+  private:
+    std::vector<double> m_cdf;
+};
+
+constexpr Price kMidPrice = 100000;
+
+// Drives one exchange and keeps the ids of its resting orders so that
+// deletes always hit a live order. Only the exchange calls are timed.
+class FlowDriver
+{
+  public:
+    FlowDriver(const ExchangeConfig& config, std::uint64_t seed) : m_exchange(config), m_rng(seed)
+    {
+        m_exchange.OnOrderInserted = [this](UserReference, InsertError error, OrderId orderId) {
+            m_last_id = error == InsertError::OK ? orderId : 0;
+        };
+        m_exchange.OnOrderDeleted     = [](OrderId, DeleteError) {};
+        m_exchange.OnBestPriceChanged = [](const std::string&, Price, Volume, Price, Volume) {};
+    }
+
+    MyExchange&      Exchange() { return m_exchange; }
+    std::mt19937_64& Rng() { return m_rng; }
+    std::size_t      Live() const { return m_live.size(); }
+
+    // Start timing, everything before this call is prefill
+    void StartMeasuring()
+    {
+        m_measuring  = true;
+        m_wall_start = std::chrono::steady_clock::now();
+    }
+    void StopMeasuring() { m_wall_end = std::chrono::steady_clock::now(); }
+
+    void Insert(SymbolId symbol, Side side, Price price, Volume volume)
+    {
+        std::uint64_t start = ReadTsc();
+        m_exchange.InsertOrder(symbol, side, price, volume, 0);
+        std::uint64_t end = ReadTsc();
+        if (m_measuring)
+        {
+            m_insert.Record(end - start);
+        }
+        if (m_last_id != 0)
+        {
+            m_live.push_back(m_last_id);
+        }
+    }
+
+    // Delete the live order at index, the last live order takes its place
+    void DeleteAt(std::size_t index)
+    {
+        OrderId orderId = m_live[index];
+        m_live[index]   = m_live.back();
+        m_live.pop_back();
+
+        std::uint64_t start = ReadTsc();
+        m_exchange.DeleteOrder(orderId);
+        std::uint64_t end = ReadTsc();
+        if (m_measuring)
+        {
+            m_delete.Record(end - start);
+        }
+    }
+
+    void DeleteRandom() { DeleteAt(std::uniform_int_distribution<std::size_t>(0, m_live.size() - 1)(m_rng)); }
+
+    // Delete one of the most recently inserted orders
+    void DeleteRecent(std::size_t window)
+    {
+        std::size_t span = std::min(window, m_live.size());
+        DeleteAt(m_live.size() - 1 - std::uniform_int_distribution<std::size_t>(0, span - 1)(m_rng));
+    }
+
+    void Report(const std::string& flow, std::vector<ResultRow>& rows) const
+    {
+        double ticks_per_ns = TscTicksPerNanosecond();
+        double wall_ns
+            = double(std::chrono::duration_cast<std::chrono::nanoseconds>(m_wall_end - m_wall_start).count());
+
+        auto add = [&](const char* operation, const OperationStats& stats) {
+            const LatencyHistogram& latency = stats.latency;
+            if (latency.Count() == 0)
+            {
+                return;
+            }
+            double busy_ns = double(stats.total_ticks) / ticks_per_ns;
+            rows.push_back(ResultRow{flow,
+                                     operation,
+                                     latency.Count(),
+                                     busy_ns > 0 ? double(latency.Count()) * 1e9 / busy_ns : 0.0,
+                                     latency.Mean() / ticks_per_ns,
+                                     double(latency.Percentile(0.50)) / ticks_per_ns,
+                                     double(latency.Percentile(0.99)) / ticks_per_ns,
+                                     double(latency.Percentile(0.999)) / ticks_per_ns,
+                                     double(latency.Max()) / ticks_per_ns});
+        };
+        add("insert", m_insert);
+        add("delete", m_delete);
+
+        // Whole flow including order generation, by wall clock
+        OperationStats all;
+        all.latency.Merge(m_insert.latency);
+        all.latency.Merge(m_delete.latency);
+        all.total_ticks = m_insert.total_ticks + m_delete.total_ticks;
+        add("all", all);
+        if (wall_ns > 0)
+        {
+            rows.back().ops_per_sec = double(all.latency.Count()) * 1e9 / wall_ns;
+        }
+    }
+
+  private:
+    MyExchange           m_exchange;
+    std::mt19937_64      m_rng;
+    std::vector<OrderId> m_live;
+    OrderId              m_last_id{0};
+
+    bool                                  m_measuring{false};
+    std::chrono::steady_clock::time_point m_wall_start;
+    std::chrono::steady_clock::time_point m_wall_end;
+    OperationStats                        m_insert;
+    OperationStats                        m_delete;
+};
+
+Side RandomSide(std::mt19937_64& rng)
+{
+    return (rng() & 1) ? Side::Buy : Side::Sell;
+}
+
+// Bids rest below the mid and asks above it, distance ticks away
+Price AwayFromMid(Side side, std::size_t distance)
+{
+    return side == Side::Buy ? kMidPrice - Price(distance) : kMidPrice + Price(distance);
+}
+
+Volume RandomVolume(std::mt19937_64& rng)
+{
+    return Volume(1 + rng() % 1000);
+}
+
+ExchangeConfig BaseConfig(const BenchOptions& options)
+{
+    ExchangeConfig config;
+    config.ladder_levels         = options.ladder_levels;
+    config.placement.cpu         = options.cpu;
+    config.placement.arena_bytes = options.arena_mb << 20;
+    config.placement.prefault    = options.arena_mb != 0;
+    return config;
+}
+
+// Steady state insert/delete mix at a constant book depth, distance from the
+// mid drawn by next_distance
+template <typename Distance>
+void RunSteadyState(FlowDriver& driver,
+                    SymbolId    symbol,
+                    std::size_t depth,
+                    std::size_t operations,
+                    Distance    next_distance)
+{
+    std::mt19937_64& rng = driver.Rng();
+    while (driver.Live() < depth)
+    {
+        Side side = RandomSide(rng);
+        driver.Insert(symbol, side, AwayFromMid(side, next_distance(rng)), RandomVolume(rng));
+    }
+
+    driver.StartMeasuring();
+    for (std::size_t i = 0; i < operations; ++i)
+    {
+        if (driver.Live() > depth || (driver.Live() == depth && (rng() & 1)))
+        {
+            driver.DeleteRandom();
+        }
+        else
+        {
+            Side side = RandomSide(rng);
+            driver.Insert(symbol, side, AwayFromMid(side, next_distance(rng)), RandomVolume(rng));
+        }
+    }
+    driver.StopMeasuring();
+}
+
+// Prices uniform over 500 ticks either side of the mid, 10k resting orders
+void UniformFlow(const BenchOptions& options, std::vector<ResultRow>& rows)
+{
+    FlowDriver                                 driver(BaseConfig(options), 1);
+    SymbolId                                   symbol = driver.Exchange().FindSymbol("AAPL");
+    std::uniform_int_distribution<std::size_t> distance(1, 500);
+    RunSteadyState(driver, symbol, 10000, options.operations, distance);
+    driver.Report("uniform", rows);
+}
+
+// Distance from the mid Zipf distributed, most orders join the first levels
+void ZipfFlow(const BenchOptions& options, std::vector<ResultRow>& rows)
+{
+    FlowDriver       driver(BaseConfig(options), 2);
+    SymbolId         symbol = driver.Exchange().FindSymbol("AAPL");
+    ZipfDistribution distance(2000, 1.2);
+    RunSteadyState(driver, symbol, 10000, options.operations, distance);
+    driver.Report("zipf", rows);
+}
+
+// Half a million resting orders spread over 5000 levels per side
+void DeepBookFlow(const BenchOptions& options, std::vector<ResultRow>& rows)
+{
+    ExchangeConfig config      = BaseConfig(options);
+    config.order_pool.capacity = 1 << 20;
+
+    FlowDriver                                 driver(config, 3);
+    SymbolId                                   symbol = driver.Exchange().FindSymbol("AAPL");
+    std::uniform_int_distribution<std::size_t> distance(1, 5000);
+    RunSteadyState(driver, symbol, 500000, options.operations, distance);
+    driver.Report("deep_book", rows);
+}
+
+// Quotes at the touch cancelled a few operations after they were inserted,
+// over a 10k order background book. Most deletes empty the best level.
+void HeavyCancelFlow(const BenchOptions& options, std::vector<ResultRow>& rows)
+{
+    FlowDriver       driver(BaseConfig(options), 4);
+    std::mt19937_64& rng    = driver.Rng();
+    SymbolId         symbol = driver.Exchange().FindSymbol("AAPL");
+
+    std::uniform_int_distribution<std::size_t> background(10, 500);
+    while (driver.Live() < 10000)
+    {
+        Side side = RandomSide(rng);
+        driver.Insert(symbol, side, AwayFromMid(side, background(rng)), RandomVolume(rng));
+    }
+
+    std::size_t base_depth = driver.Live();
+    driver.StartMeasuring();
+    for (std::size_t i = 0; i < options.operations; ++i)
+    {
+        // One cancel per insert on average once a few quotes are out
+        std::size_t quotes = driver.Live() - base_depth;
+        if (quotes > 0 && (quotes >= 8 || (rng() & 1)))
+        {
+            driver.DeleteRecent(quotes);
+        }
+        else
+        {
+            Side side = RandomSide(rng);
+            driver.Insert(symbol, side, AwayFromMid(side, 1 + rng() % 3), RandomVolume(rng));
+        }
+    }
+    driver.StopMeasuring();
+    driver.Report("heavy_cancel", rows);
+}
+
+// 1000 listed symbols with 20 resting orders each, symbols picked uniformly
+void MultiSymbolFlow(const BenchOptions& options, std::vector<ResultRow>& rows)
+{
+    constexpr std::size_t kSymbols = 1000;
+    constexpr std::size_t kDepth   = 20;
+
+    ExchangeConfig config = BaseConfig(options);
+    for (std::size_t i = 0; i < kSymbols; ++i)
+    {
+        char name[16];
+        std::snprintf(name, sizeof(name), "S%04zu", i);
+        config.symbols.emplace_back();
+        config.symbols.back().symbol         = name;
+        config.symbols.back().expected_depth = kDepth * 2;
+    }
+    FlowDriver       driver(config, 5);
+    std::mt19937_64& rng = driver.Rng();
+
+    std::uniform_int_distribution<SymbolId>    symbol(0, kSymbols - 1);
+    std::uniform_int_distribution<std::size_t> distance(1, 100);
+    std::size_t                                depth = kSymbols * kDepth;
+    while (driver.Live() < depth)
+    {
+        Side side = RandomSide(rng);
+        driver.Insert(symbol(rng), side, AwayFromMid(side, distance(rng)), RandomVolume(rng));
+    }
+
+    driver.StartMeasuring();
+    for (std::size_t i = 0; i < options.operations; ++i)
+    {
+        if (driver.Live() > depth || (driver.Live() == depth && (rng() & 1)))
+        {
+            driver.DeleteRandom();
+        }
+        else
+        {
+            Side side = RandomSide(rng);
+            driver.Insert(symbol(rng), side, AwayFromMid(side, distance(rng)), RandomVolume(rng));
+        }
+    }
+    driver.StopMeasuring();
+    driver.Report("multi_symbol", rows);
+}
+
+// Journal the uniform flow, then time rebuilding the books from the journal
+void ReplayFlow(const BenchOptions& options, std::vector<ResultRow>& rows)
+{
+    const char*    path   = "bench_journal.bin";
+    ExchangeConfig config = BaseConfig(options);
+    config.journal_file   = path;
+    std::remove(path);
+    {
+        FlowDriver                                 driver(config, 6);
+        SymbolId                                   symbol = driver.Exchange().FindSymbol("AAPL");
+        std::uniform_int_distribution<std::size_t> distance(1, 500);
+        RunSteadyState(driver, symbol, 10000, options.operations, distance);
+    }
+
+    MyExchange  exchange(config);
+    auto        start   = std::chrono::steady_clock::now();
+    std::size_t records = exchange.Replay();
+    auto        end     = std::chrono::steady_clock::now();
+    std::remove(path);
+
+    double elapsed_ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    double mean_ns    = records ? elapsed_ns / double(records) : 0.0;
+    rows.push_back(ResultRow{"journal",
+                             "replay",
+                             records,
+                             elapsed_ns > 0 ? double(records) * 1e9 / elapsed_ns : 0.0,
+                             mean_ns,
+                             0,
+                             0,
+                             0,
+                             0});
+}
+
+void WriteResults(const std::string& path, const std::vector<ResultRow>& rows)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "cannot write " << path << "\n";
+        return;
+    }
+    out << "flow,operation,count,ops_per_sec,mean_ns,p50_ns,p99_ns,p999_ns,max_ns\n";
+    for (const ResultRow& row : rows)
+    {
+        out << row.flow << ',' << row.operation << ',' << row.count << ',' << row.ops_per_sec << ',' << row.mean_ns
+            << ',' << row.p50_ns << ',' << row.p99_ns << ',' << row.p999_ns << ',' << row.max_ns << '\n';
+    }
+}
+
+void PrintResults(const std::vector<ResultRow>& rows)
+{
+    std::printf("%-13s %-9s %10s %14s %9s %9s %9s %10s %11s\n",
+                "flow",
+                "operation",
+                "count",
+                "ops/sec",
+                "mean ns",
+                "p50 ns",
+                "p99 ns",
+                "p99.9 ns",
+                "max ns");
+    for (const ResultRow& row : rows)
+    {
+        std::printf("%-13s %-9s %10llu %14.0f %9.1f %9.0f %9.0f %10.0f %11.0f\n",
+                    row.flow.c_str(),
+                    row.operation.c_str(),
+                    static_cast<unsigned long long>(row.count),
+                    row.ops_per_sec,
+                    row.mean_ns,
+                    row.p50_ns,
+                    row.p99_ns,
+                    row.p999_ns,
+                    row.max_ns);
+    }
+}
+
+// Returns the number of rows that regressed against the baseline CSV
+int CompareWithBaseline(const std::string& path, double tolerance, const std::vector<ResultRow>& rows)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "cannot read baseline " << path << "\n";
+        return 1;
+    }
+
+    std::map<std::string, ResultRow> baseline;
+    std::string                      line;
+    std::getline(in, line);
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        ResultRow          row{};
+        std::string        count;
+        std::string        values[6];
+        std::getline(fields, row.flow, ',');
+        std::getline(fields, row.operation, ',');
+        std::getline(fields, count, ',');
+        for (std::string& value : values)
+        {
+            std::getline(fields, value, ',');
+        }
+        if (row.operation.empty())
+        {
+            continue;
+        }
+        row.ops_per_sec = std::atof(values[0].c_str());
+        row.p99_ns      = std::atof(values[3].c_str());
+        baseline[row.flow + '/' + row.operation] = row;
+    }
+
+    int regressions = 0;
+    for (const ResultRow& row : rows)
+    {
+        auto it = baseline.find(row.flow + '/' + row.operation);
+        if (it == baseline.end())
+        {
+            continue;
+        }
+        const ResultRow& before = it->second;
+        if (row.ops_per_sec < before.ops_per_sec * (1.0 - tolerance))
+        {
+            std::printf("REGRESSION %s/%s ops/sec %.0f -> %.0f\n",
+                        row.flow.c_str(),
+                        row.operation.c_str(),
+                        before.ops_per_sec,
+                        row.ops_per_sec);
+            ++regressions;
+        }
+        if (row.p99_ns > before.p99_ns * (1.0 + tolerance))
+        {
+            std::printf("REGRESSION %s/%s p99 %.0fns -> %.0fns\n",
+                        row.flow.c_str(),
+                        row.operation.c_str(),
+                        before.p99_ns,
+                        row.p99_ns);
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+bool ParseOptions(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg   = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr)
+        {
+            return false;
+        }
+        if (std::strcmp(arg, "--ops") == 0)
+        {
+            options.operations = std::strtoull(value, nullptr, 10);
+        }
+        else if (std::strcmp(arg, "--ladder") == 0)
+        {
+            options.ladder_levels = std::strtoull(value, nullptr, 10);
+        }
+        else if (std::strcmp(arg, "--cpu") == 0)
+        {
+            options.cpu = std::atoi(value);
+        }
+        else if (std::strcmp(arg, "--arena") == 0)
+        {
+            options.arena_mb = std::strtoull(value, nullptr, 10);
+        }
+        else if (std::strcmp(arg, "--flow") == 0)
+        {
+            options.flow = value;
+        }
+        else if (std::strcmp(arg, "--out") == 0)
+        {
+            options.output = value;
+        }
+        else if (std::strcmp(arg, "--baseline") == 0)
+        {
+            options.baseline = value;
+        }
+        else if (std::strcmp(arg, "--tolerance") == 0)
+        {
+            options.tolerance = std::atof(value);
+        }
+        else
+        {
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " [--ops N] [--ladder LEVELS] [--flow NAME] [--out FILE] [--baseline FILE] [--tolerance FRACTION]"
+                     " [--cpu N] [--arena MB]\n";
+        return 2;
+    }
+    if (!PinCurrentThread(options.cpu))
+    {
+        std::cerr << "cannot pin to cpu " << options.cpu << "\n";
+        return 2;
+    }
+
+    using FlowFunction = void (*)(const BenchOptions&, std::vector<ResultRow>&);
+    const std::pair<const char*, FlowFunction> flows[] = {{"uniform", UniformFlow},
+                                                          {"zipf", ZipfFlow},
+                                                          {"deep_book", DeepBookFlow},
+                                                          {"heavy_cancel", HeavyCancelFlow},
+                                                          {"multi_symbol", MultiSymbolFlow},
+                                                          {"replay", ReplayFlow}};
+
+    std::vector<ResultRow> rows;
+    for (const auto& flow : flows)
+    {
+        if (options.flow.empty() || options.flow == flow.first)
+        {
+            flow.second(options, rows);
+        }
+    }
+    if (rows.empty())
+    {
+        std::cerr << "unknown flow " << options.flow << "\n";
+        return 2;
+    }
+
+    PrintResults(rows);
+    WriteResults(options.output, rows);
+
+    if (!options.baseline.empty() && CompareWithBaseline(options.baseline, options.tolerance, rows) != 0)
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,298 @@
+#include "BookReader.h"
+
+#include <functional>
+#include <thread>
+
+EpochDomain::EpochDomain(std::size_t reader_slots)
+    : m_epoch(1), m_slot_count(reader_slots == 0 ? 1 : reader_slots), m_slots(new Slot[m_slot_count])
+{
+}
+
+EpochDomain::Guard::Guard(const EpochDomain& domain) : m_domain(domain), m_slot(0)
+{
+    // Threads start looking at different slots so that they rarely collide
+    std::size_t first = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for (std::size_t i = 0;; ++i)
+    {
+        m_slot              = (first + i) % m_domain.m_slot_count;
+        std::uint64_t free  = 0;
+        std::uint64_t epoch = m_domain.m_epoch.load(std::memory_order_seq_cst);
+        if (m_domain.m_slots[m_slot].epoch.compare_exchange_strong(free, epoch, std::memory_order_seq_cst))
+        {
+            break;
+        }
+        if (i % m_domain.m_slot_count == m_domain.m_slot_count - 1)
+        {
+            std::this_thread::yield();
+        }
+    }
+    // The writer sees the pin before it reuses anything this reader loads
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+EpochDomain::Guard::~Guard()
+{
+    m_domain.m_slots[m_slot].epoch.store(0, std::memory_order_release);
+}
+
+std::uint64_t EpochDomain::Advance()
+{
+    std::uint64_t oldest = m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (std::size_t i = 0; i < m_slot_count; ++i)
+    {
+        std::uint64_t epoch = m_slots[i].epoch.load(std::memory_order_acquire);
+        if (epoch != 0 && epoch < oldest)
+        {
+            oldest = epoch;
+        }
+    }
+    return oldest;
+}
+
+void BookReader::DepthImage::CopyTo(std::size_t levels, DepthView& view) const
+{
+    const DepthLevel* bids = m_levels.data();
+    const DepthLevel* asks = m_levels.data() + m_levels.size() / 2;
+    view.bids.assign(bids, bids + (levels < m_bids ? levels : m_bids));
+    view.asks.assign(asks, asks + (levels < m_asks ? levels : m_asks));
+}
+
+BookReader::BookReader(std::size_t depth_levels, std::size_t reader_slots)
+    : m_depth_levels(depth_levels), m_epochs(reader_slots), m_version(0), m_last_page(0)
+{
+}
+
+// Readers are gone by now, so everything is freed whatever its epoch
+BookReader::~BookReader() = default;
+
+void BookReader::AddBook(SymbolId symbol)
+{
+    if (m_books.Get(symbol) != nullptr)
+    {
+        return;
+    }
+    m_book_storage.push_back(std::make_unique<Book>());
+    m_books.Set(symbol, m_book_storage.back().get(), m_epochs);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        m_images.push_back(std::make_unique<DepthImage>(m_depth_levels));
+        m_free_images.push_back(m_images.back().get());
+    }
+    m_retired_images.reserve(m_book_storage.size());
+}
+
+void BookReader::BeginPublish()
+{
+    m_version.store(m_version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void BookReader::EndPublish()
+{
+    m_version.store(m_version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void BookReader::PublishTop(SymbolId symbol, Price bid, Volume bid_volume, Price ask, Volume ask_volume)
+{
+    Book&         book  = *m_books.Get(symbol);
+    std::uint64_t stamp = book.stamp.load(std::memory_order_relaxed);
+    book.stamp.store(stamp + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    book.bid.store(bid, std::memory_order_relaxed);
+    book.bid_volume.store(bid_volume, std::memory_order_relaxed);
+    book.ask.store(ask, std::memory_order_relaxed);
+    book.ask_volume.store(ask_volume, std::memory_order_relaxed);
+    book.stamp.store(stamp + 2, std::memory_order_release);
+}
+
+BookReader::DepthImage& BookReader::NewDepth()
+{
+    if (m_free_images.empty())
+    {
+        m_images.push_back(std::make_unique<DepthImage>(m_depth_levels));
+        m_free_images.push_back(m_images.back().get());
+    }
+    DepthImage* image = m_free_images.back();
+    m_free_images.pop_back();
+    image->Clear();
+    return *image;
+}
+
+void BookReader::PublishDepth(SymbolId symbol, DepthImage& image)
+{
+    DepthImage* previous = m_books.Get(symbol)->depth.exchange(&image, std::memory_order_acq_rel);
+    if (previous != nullptr)
+    {
+        m_retired_images.emplace_back(m_epochs.Current(), previous);
+    }
+}
+
+BookReader::OrderSlot& BookReader::Slot(OrderId orderId)
+{
+    std::size_t page = std::size_t(orderId) >> kPageShift;
+    if (m_pages.Get(page) == nullptr)
+    {
+        if (m_free_pages.empty())
+        {
+            m_page_storage.push_back(std::make_unique<OrderPage>());
+            m_free_pages.push_back(m_page_storage.back().get());
+        }
+        m_pages.Set(page, m_free_pages.back(), m_epochs);
+        m_free_pages.pop_back();
+    }
+    if (page > m_last_page)
+    {
+        // The previous head page will not receive new ids any more
+        std::size_t last = m_last_page;
+        m_last_page      = page;
+        RecycleIfEmpty(last);
+    }
+    return m_pages.Get(page)->slots[std::size_t(orderId) & (kPageSize - 1)];
+}
+
+void BookReader::PublishOrder(OrderId orderId, SymbolId symbol, Side side, Price price, Volume volume)
+{
+    OrderSlot& slot = Slot(orderId);
+    if (slot.volume.load(std::memory_order_relaxed) == 0)
+    {
+        ++m_pages.Get(std::size_t(orderId) >> kPageShift)->live;
+    }
+    std::uint32_t stamp = slot.stamp.load(std::memory_order_relaxed);
+    slot.stamp.store(stamp + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.symbol.store(symbol, std::memory_order_relaxed);
+    slot.side.store(std::uint8_t(side), std::memory_order_relaxed);
+    slot.price.store(price, std::memory_order_relaxed);
+    slot.volume.store(volume, std::memory_order_relaxed);
+    slot.stamp.store(stamp + 2, std::memory_order_release);
+}
+
+void BookReader::EraseOrder(OrderId orderId)
+{
+    std::size_t page  = std::size_t(orderId) >> kPageShift;
+    OrderPage*  slots = m_pages.Get(page);
+    if (slots == nullptr)
+    {
+        return;
+    }
+    OrderSlot& slot = slots->slots[std::size_t(orderId) & (kPageSize - 1)];
+    if (slot.volume.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+    // A lone store, readers see the order or its absence
+    slot.volume.store(0, std::memory_order_release);
+    --slots->live;
+    RecycleIfEmpty(page);
+}
+
+void BookReader::RecycleIfEmpty(std::size_t page)
+{
+    OrderPage* slots = m_pages.Get(page);
+    if (page >= m_last_page || slots == nullptr || slots->live != 0)
+    {
+        return;
+    }
+    // Every slot is already empty for the page's next use
+    m_pages.Set(page, nullptr, m_epochs);
+    m_retired_pages.emplace_back(m_epochs.Current(), slots);
+}
+
+void BookReader::Reclaim()
+{
+    if (m_retired_images.empty() && m_retired_pages.empty() && m_books.Retired() == 0 && m_pages.Retired() == 0)
+    {
+        return;
+    }
+    std::uint64_t safe = m_epochs.Advance();
+
+    std::size_t images = 0;
+    for (; images < m_retired_images.size() && m_retired_images[images].first < safe; ++images)
+    {
+        m_free_images.push_back(m_retired_images[images].second);
+    }
+    m_retired_images.erase(m_retired_images.begin(), m_retired_images.begin() + images);
+
+    std::size_t pages = 0;
+    for (; pages < m_retired_pages.size() && m_retired_pages[pages].first < safe; ++pages)
+    {
+        m_free_pages.push_back(m_retired_pages[pages].second);
+    }
+    m_retired_pages.erase(m_retired_pages.begin(), m_retired_pages.begin() + pages);
+
+    m_books.Reclaim(safe);
+    m_pages.Reclaim(safe);
+}
+
+bool BookReader::GetTopOfBook(SymbolId symbol, TopView& top) const
+{
+    EpochDomain::Guard guard(m_epochs);
+    const Book*        book = m_books.Load(symbol);
+    if (book == nullptr)
+    {
+        return false;
+    }
+    for (;;)
+    {
+        std::uint64_t stamp = book->stamp.load(std::memory_order_acquire);
+        top.bid             = book->bid.load(std::memory_order_relaxed);
+        top.bid_volume      = book->bid_volume.load(std::memory_order_relaxed);
+        top.ask             = book->ask.load(std::memory_order_relaxed);
+        top.ask_volume      = book->ask_volume.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((stamp & 1) == 0 && book->stamp.load(std::memory_order_relaxed) == stamp)
+        {
+            return true;
+        }
+    }
+}
+
+bool BookReader::GetDepth(SymbolId symbol, std::size_t levels, DepthView& depth) const
+{
+    EpochDomain::Guard guard(m_epochs);
+    const Book*        book = m_books.Load(symbol);
+    if (book == nullptr)
+    {
+        return false;
+    }
+    // Images are never written once published, only reused after the guard
+    const DepthImage* image = book->depth.load(std::memory_order_acquire);
+    if (image == nullptr)
+    {
+        depth.bids.clear();
+        depth.asks.clear();
+        return true;
+    }
+    image->CopyTo(levels, depth);
+    return true;
+}
+
+bool BookReader::GetOrder(OrderId orderId, OrderView& order) const
+{
+    if (orderId <= 0)
+    {
+        return false;
+    }
+    EpochDomain::Guard guard(m_epochs);
+    const OrderPage*   page = m_pages.Load(std::size_t(orderId) >> kPageShift);
+    if (page == nullptr)
+    {
+        return false;
+    }
+    const OrderSlot& slot = page->slots[std::size_t(orderId) & (kPageSize - 1)];
+    for (;;)
+    {
+        std::uint32_t stamp = slot.stamp.load(std::memory_order_acquire);
+        order.symbol        = slot.symbol.load(std::memory_order_relaxed);
+        order.side          = Side(slot.side.load(std::memory_order_relaxed));
+        order.price         = slot.price.load(std::memory_order_relaxed);
+        order.volume        = slot.volume.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((stamp & 1) == 0 && slot.stamp.load(std::memory_order_relaxed) == stamp)
+        {
+            return order.volume != 0;
+        }
+    }
+}
@@ -0,0 +1,314 @@
+#pragma once
+
+#include "IExchange.h"
+#include "SymbolTable.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Read-only views of the books for threads other than the one driving the
+// exchange. The exchange writes them after each request, or each batch, and
+// readers copy them out from any thread: neither ever waits for the other.
+// Best prices are per-book seqlocks; depth and resting orders live in
+// storage that is only reused once no reader can still see it, tracked by
+// epochs (see EpochDomain). Each publication is bracketed by a version, so
+// readers can tell whether several reads saw the same one.
+
+// Latest best prices of a book
+struct TopView
+{
+    Price  bid;
+    Volume bid_volume;
+    Price  ask;
+    Volume ask_volume;
+};
+
+struct DepthLevel
+{
+    Price  price;
+    Volume volume;
+};
+
+// Levels of a book, best first
+struct DepthView
+{
+    std::vector<DepthLevel> bids;
+    std::vector<DepthLevel> asks;
+};
+
+// A resting order
+struct OrderView
+{
+    SymbolId symbol;
+    Side     side;
+    Price    price;
+    Volume   volume;
+};
+
+// Epoch-based reclamation with one writer. A reader pins the current epoch
+// for as long as it holds pointers into shared storage. The writer tags what
+// it unpublishes with the epoch at that time and may reuse it once every
+// pinned reader is in a later epoch, so readers never take a lock and the
+// writer never waits: storage a slow reader pins is just reused later.
+class EpochDomain
+{
+  public:
+    // At most reader_slots readers are pinned at once, more wait for a slot
+    explicit EpochDomain(std::size_t reader_slots);
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Reader side, pins the epoch for its lifetime
+    class Guard
+    {
+      public:
+        explicit Guard(const EpochDomain& domain);
+        ~Guard();
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+      private:
+        const EpochDomain& m_domain;
+        std::size_t        m_slot;
+    };
+
+    // Writer side. What is unpublished now is tagged with Current(); Advance
+    // starts a new epoch and returns the oldest one a reader may still be
+    // in, so that anything tagged before it can be reused.
+    std::uint64_t Current() const { return m_epoch.load(std::memory_order_relaxed); }
+    std::uint64_t Advance();
+
+  private:
+    // 0 while free, else the epoch its reader pinned
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> epoch{0};
+    };
+
+    std::atomic<std::uint64_t> m_epoch;
+    std::size_t                m_slot_count;
+    std::unique_ptr<Slot[]>    m_slots;
+};
+
+namespace book_reader {
+
+// Array of pointers indexed by readers under an epoch guard. Entries are set
+// in place; outgrowing the array publishes a copy twice the size and retires
+// the old one.
+template <typename T>
+class PublishedArray
+{
+  public:
+    PublishedArray() : m_array(new Array(16)) {}
+    ~PublishedArray()
+    {
+        delete m_array.load(std::memory_order_relaxed);
+        for (const auto& retired : m_retired)
+        {
+            delete retired.second;
+        }
+    }
+
+    PublishedArray(const PublishedArray&) = delete;
+    PublishedArray& operator=(const PublishedArray&) = delete;
+
+    // Reader, nullptr past the end
+    T* Load(std::size_t index) const
+    {
+        const Array* array = m_array.load(std::memory_order_acquire);
+        return index < array->size ? array->entries[index].load(std::memory_order_acquire) : nullptr;
+    }
+
+    // Writer
+    T* Get(std::size_t index) const
+    {
+        const Array* array = m_array.load(std::memory_order_relaxed);
+        return index < array->size ? array->entries[index].load(std::memory_order_relaxed) : nullptr;
+    }
+    void Set(std::size_t index, T* value, const EpochDomain& epochs)
+    {
+        Array* array = m_array.load(std::memory_order_relaxed);
+        if (index >= array->size)
+        {
+            std::size_t size = array->size;
+            while (size <= index)
+            {
+                size *= 2;
+            }
+            Array* grown = new Array(size);
+            for (std::size_t i = 0; i < array->size; ++i)
+            {
+                grown->entries[i].store(array->entries[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            m_array.store(grown, std::memory_order_release);
+            m_retired.emplace_back(epochs.Current(), array);
+            array = grown;
+        }
+        array->entries[index].store(value, std::memory_order_release);
+    }
+    // Arrays waiting for readers to leave their epoch
+    std::size_t Retired() const { return m_retired.size(); }
+    // Free the arrays retired before epoch safe
+    void Reclaim(std::uint64_t safe)
+    {
+        std::size_t freed = 0;
+        for (; freed < m_retired.size() && m_retired[freed].first < safe; ++freed)
+        {
+            delete m_retired[freed].second;
+        }
+        m_retired.erase(m_retired.begin(), m_retired.begin() + freed);
+    }
+
+  private:
+    struct Array
+    {
+        explicit Array(std::size_t capacity) : size(capacity), entries(new std::atomic<T*>[capacity])
+        {
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                entries[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        std::size_t                        size;
+        std::unique_ptr<std::atomic<T*>[]> entries;
+    };
+
+    std::atomic<Array*> m_array;
+    // Oldest first, each tagged with the epoch it was retired in
+    std::vector<std::pair<std::uint64_t, Array*>> m_retired;
+};
+
+}  // namespace book_reader
+
+// The views themselves. Publish* and Erase* are the writer's, called by the
+// exchange; Get* may be called from any thread, concurrently with them.
+class BookReader
+{
+  public:
+    static constexpr std::size_t kPageShift = 12;
+    static constexpr std::size_t kPageSize  = std::size_t(1) << kPageShift;
+
+    // Depth of depth_levels levels per side, reader_slots as for EpochDomain
+    BookReader(std::size_t depth_levels, std::size_t reader_slots);
+    ~BookReader();
+
+    BookReader(const BookReader&) = delete;
+    BookReader& operator=(const BookReader&) = delete;
+
+    // Levels of one side or both, filled best first by the writer
+    class DepthImage
+    {
+      public:
+        explicit DepthImage(std::size_t levels) : m_bids(0), m_asks(0), m_levels(2 * levels) {}
+
+        // False once the side is full
+        bool AddBid(Price price, Volume volume) { return Add(m_bids, 0, price, volume); }
+        bool AddAsk(Price price, Volume volume) { return Add(m_asks, m_levels.size() / 2, price, volume); }
+
+        void Clear() { m_bids = m_asks = 0; }
+        void CopyTo(std::size_t levels, DepthView& view) const;
+
+      private:
+        bool Add(std::size_t& count, std::size_t offset, Price price, Volume volume)
+        {
+            if (count == m_levels.size() / 2)
+            {
+                return false;
+            }
+            m_levels[offset + count++] = DepthLevel{price, volume};
+            return true;
+        }
+
+        std::size_t             m_bids;
+        std::size_t             m_asks;
+        std::vector<DepthLevel> m_levels;
+    };
+
+    // Writer side. A book comes with two depth images, one published and one
+    // to build the next from, so the writer only allocates while readers pin
+    // retired images.
+    void AddBook(SymbolId symbol);
+    // Bracket the Publish* and Erase* calls of one publication
+    void BeginPublish();
+    void EndPublish();
+    void PublishTop(SymbolId symbol, Price bid, Volume bid_volume, Price ask, Volume ask_volume);
+    // An empty image to fill and pass to PublishDepth
+    DepthImage& NewDepth();
+    void        PublishDepth(SymbolId symbol, DepthImage& image);
+    void        PublishOrder(OrderId orderId, SymbolId symbol, Side side, Price price, Volume volume);
+    void        EraseOrder(OrderId orderId);
+    // Reuse storage no reader can see any more
+    void Reclaim();
+
+    // Reader side, false for unknown symbols and orders not resting
+    bool GetTopOfBook(SymbolId symbol, TopView& top) const;
+    // At most levels levels per side, and no more than depth_levels
+    bool GetDepth(SymbolId symbol, std::size_t levels, DepthView& depth) const;
+    bool GetOrder(OrderId orderId, OrderView& order) const;
+    // Odd while a publication is under way. Reads made between two equal
+    // even versions all saw the same publication.
+    std::uint64_t Version() const
+    {
+        // Reads made before are ordered before the version is loaded
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_version.load(std::memory_order_acquire);
+    }
+
+  private:
+    // Readers retry while the stamp is odd or changes under them
+    struct alignas(64) Book
+    {
+        std::atomic<std::uint64_t> stamp{0};
+        std::atomic<Price>         bid{0};
+        std::atomic<Volume>        bid_volume{0};
+        std::atomic<Price>         ask{0};
+        std::atomic<Volume>        ask_volume{0};
+        std::atomic<DepthImage*>   depth{nullptr};
+    };
+
+    // A volume of 0 marks a slot without a resting order
+    struct OrderSlot
+    {
+        std::atomic<std::uint32_t> stamp{0};
+        std::atomic<SymbolId>      symbol{0};
+        std::atomic<Price>         price{0};
+        std::atomic<Volume>        volume{0};
+        std::atomic<std::uint8_t>  side{0};
+    };
+
+    // Slots of the ids sharing OrderId >> kPageShift, recycled as in
+    // OrderIdTable once every id of the page was issued and has gone
+    struct OrderPage
+    {
+        OrderSlot   slots[kPageSize];
+        std::size_t live{0};
+    };
+
+    OrderSlot& Slot(OrderId orderId);
+    void       RecycleIfEmpty(std::size_t page);
+
+    std::size_t                m_depth_levels;
+    EpochDomain                m_epochs;
+    std::atomic<std::uint64_t> m_version;
+
+    book_reader::PublishedArray<Book>      m_books;
+    book_reader::PublishedArray<OrderPage> m_pages;
+
+    // Writer only: everything allocated, what is free to reuse and what
+    // waits for readers to leave its epoch
+    std::vector<std::unique_ptr<Book>>                 m_book_storage;
+    std::vector<std::unique_ptr<DepthImage>>           m_images;
+    std::vector<DepthImage*>                           m_free_images;
+    std::vector<std::pair<std::uint64_t, DepthImage*>> m_retired_images;
+    std::vector<std::unique_ptr<OrderPage>>            m_page_storage;
+    std::vector<OrderPage*>                            m_free_pages;
+    std::vector<std::pair<std::uint64_t, OrderPage*>>  m_retired_pages;
+    std::size_t                                        m_last_page;
+};
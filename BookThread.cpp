@@ -0,0 +1,180 @@
+#include "BookThread.h"
+#include "MyExchangeImpl.h"
+
+namespace {
+
+// Upper bound on commands handed to ProcessBatch at once
+constexpr std::size_t kMaxBatch = 256;
+
+}  // namespace
+
+BookThread::BookThread(const ExchangeConfig& exchange_config, const BookThreadConfig& config)
+    : m_exchange(exchange_config, Listener{this}),
+      m_commands(config.command_capacity),
+      m_events(config.event_capacity),
+      m_commands_ready(config.book_wait),
+      m_events_ready(config.consumer_wait),
+      m_running(true)
+{
+    m_thread = std::thread([this, cpu = exchange_config.placement.cpu] {
+        PinCurrentThread(cpu);
+        Run();
+    });
+}
+
+BookThread::~BookThread()
+{
+    m_running.store(false, std::memory_order_seq_cst);
+    m_commands_ready.Notify();
+    m_thread.join();
+}
+
+bool BookThread::TrySubmit(const OrderCommand& command)
+{
+    if (!m_commands.TryPush(command))
+    {
+        return false;
+    }
+    m_commands_ready.Notify();
+    return true;
+}
+
+void BookThread::Submit(const OrderCommand& command)
+{
+    while (!TrySubmit(command))
+    {
+        std::this_thread::yield();
+    }
+}
+
+bool BookThread::TryPoll(ExchangeEvent& event)
+{
+    return m_events.TryPop(event);
+}
+
+void BookThread::Poll(ExchangeEvent& event)
+{
+    while (!m_events.TryPop(event))
+    {
+        std::uint32_t key = m_events_ready.PrepareWait();
+        if (m_events.TryPop(event))
+        {
+            m_events_ready.CancelWait();
+            return;
+        }
+        m_events_ready.Wait(key);
+    }
+}
+
+void BookThread::Run()
+{
+    OrderCommand batch[kMaxBatch];
+    for (;;)
+    {
+        std::size_t count = 0;
+        while (count < kMaxBatch && m_commands.TryPop(batch[count]))
+        {
+            ++count;
+        }
+
+        if (count == 0)
+        {
+            std::uint32_t key = m_commands_ready.PrepareWait();
+            if (m_commands.TryPop(batch[0]))
+            {
+                m_commands_ready.CancelWait();
+                count = 1;
+            }
+            else if (!m_running.load(std::memory_order_seq_cst))
+            {
+                // Stop only once the ring has been drained
+                m_commands_ready.CancelWait();
+                return;
+            }
+            else
+            {
+                m_commands_ready.Wait(key);
+                continue;
+            }
+        }
+
+        m_exchange.ProcessBatch(batch, count);
+        // One wake-up per batch rather than per event
+        m_events_ready.Notify();
+    }
+}
+
+void BookThread::Publish(const ExchangeEvent& event)
+{
+    while (!m_events.TryPush(event))
+    {
+        // The consumer may be asleep on events not announced yet
+        m_events_ready.Notify();
+        CpuRelax();
+    }
+}
+
+void BookThread::Listener::OnOrderInserted(const OrderInsertedEvent& event)
+{
+    ExchangeEvent published{};
+    published.type          = ExchangeEvent::Type::OrderInserted;
+    published.insertError   = event.error;
+    published.riskError     = event.risk;
+    published.userReference = event.userReference;
+    published.orderId       = event.orderId;
+    thread->Publish(published);
+}
+
+void BookThread::Listener::OnOrderDeleted(const OrderDeletedEvent& event)
+{
+    ExchangeEvent published{};
+    published.type        = ExchangeEvent::Type::OrderDeleted;
+    published.deleteError = event.error;
+    published.orderId     = event.orderId;
+    thread->Publish(published);
+}
+
+void BookThread::Listener::OnOrderAmended(const OrderAmendedEvent& event)
+{
+    ExchangeEvent published{};
+    published.type       = ExchangeEvent::Type::OrderAmended;
+    published.amendError = event.error;
+    published.orderId    = event.orderId;
+    thread->Publish(published);
+}
+
+void BookThread::Listener::OnOrdersCancelled(const OrdersCancelledEvent& event)
+{
+    ExchangeEvent published{};
+    published.type = ExchangeEvent::Type::OrderCancelled;
+    for (std::size_t i = 0; i < event.count; ++i)
+    {
+        published.orderId = event.orderIds[i];
+        thread->Publish(published);
+    }
+}
+
+void BookThread::Listener::OnBestPriceChanged(const BestPriceChangedEvent& event)
+{
+    // Symbols arrive as ids, no name lookup on the book thread
+    ExchangeEvent published{};
+    published.type           = ExchangeEvent::Type::BestPriceChanged;
+    published.symbol         = event.symbol;
+    published.bestBid        = event.bestBid;
+    published.totalBidVolume = event.totalBidVolume;
+    published.bestAsk        = event.bestAsk;
+    published.totalAskVolume = event.totalAskVolume;
+    thread->Publish(published);
+}
+
+void BookThread::Listener::OnTrade(const TradeEvent& event)
+{
+    ExchangeEvent published{};
+    published.type      = ExchangeEvent::Type::Trade;
+    published.symbol    = event.symbol;
+    published.orderId   = event.aggressorId;
+    published.restingId = event.restingId;
+    published.price     = event.price;
+    published.volume    = event.volume;
+    thread->Publish(published);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "IExchange.h"
+#include "MyExchange.h"
+#include "RingBuffer.h"
+#include "WaitStrategy.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+// POD record of one exchange callback, published by the book thread
+struct ExchangeEvent
+{
+    enum class Type : std::uint8_t
+    {
+        OrderInserted,
+        OrderDeleted,
+        BestPriceChanged,
+        Trade,
+        OrderAmended,
+        // One per order removed by a mass cancel
+        OrderCancelled
+    };
+
+    Type        type;
+    InsertError insertError;  // OrderInserted
+    DeleteError deleteError;  // OrderDeleted
+    AmendError  amendError;   // OrderAmended
+    RiskError   riskError;    // OrderInserted
+    // OrderInserted
+    UserReference userReference;
+    // OrderInserted, OrderDeleted, OrderAmended, OrderCancelled, aggressor of a Trade
+    OrderId orderId;
+    // Resting order of a Trade
+    OrderId restingId;
+    // BestPriceChanged, Trade
+    SymbolId symbol;
+    // BestPriceChanged
+    Price  bestBid;
+    Volume totalBidVolume;
+    Price  bestAsk;
+    Volume totalAskVolume;
+    // Trade
+    Price  price;
+    Volume volume;
+};
+
+struct BookThreadConfig
+{
+    // Ring sizes, rounded up to powers of two
+    std::size_t command_capacity{1 << 16};
+    std::size_t event_capacity{1 << 18};
+    // How the book thread waits for commands
+    WaitStrategy book_wait{WaitStrategy::BusySpin};
+    // How Poll waits for events
+    WaitStrategy consumer_wait{WaitStrategy::Yield};
+};
+
+// Runs a MyExchange on its own thread so that neither gateway threads nor
+// event subscribers run on the matching thread. One gateway thread submits
+// OrderCommands into an SPSC command ring; the book thread drains it in
+// batches through ProcessBatch and publishes every callback as an
+// ExchangeEvent into an SPSC event ring, which one consumer thread polls.
+// The book thread is pinned to the core of ExchangeConfig::placement.
+//
+// A consumer that falls a whole event ring behind stalls the book, so the
+// event ring should be sized for the longest expected consumer hiccup.
+class BookThread
+{
+  public:
+    explicit BookThread(const ExchangeConfig& exchange_config, const BookThreadConfig& config = BookThreadConfig());
+    // Processes every command already submitted before returning
+    ~BookThread();
+
+    BookThread(const BookThread&) = delete;
+    BookThread& operator=(const BookThread&) = delete;
+
+    // Gateway thread. TrySubmit returns false if the command ring is full,
+    // Submit yields until there is room.
+    bool TrySubmit(const OrderCommand& command);
+    void Submit(const OrderCommand& command);
+
+    // Consumer thread. TryPoll returns false if no event is pending, Poll
+    // waits for one according to BookThreadConfig::consumer_wait.
+    bool TryPoll(ExchangeEvent& event);
+    void Poll(ExchangeEvent& event);
+
+    // Safe from any thread, the symbol universe is fixed once running
+    SymbolId      FindSymbol(const std::string& symbol) const { return m_exchange.FindSymbol(symbol); }
+    const Symbol& SymbolName(SymbolId symbol) const { return m_exchange.SymbolName(symbol); }
+    // Safe from any thread with ExchangeConfig::reader_depth, as of the last
+    // batch the book thread finished
+    bool GetTopOfBook(SymbolId symbol, TopView& top) const { return m_exchange.GetTopOfBook(symbol, top); }
+    bool GetDepth(SymbolId symbol, std::size_t levels, DepthView& depth) const
+    {
+        return m_exchange.GetDepth(symbol, levels, depth);
+    }
+    bool GetOrder(OrderId orderId, OrderView& order) const { return m_exchange.GetOrder(orderId, order); }
+
+  private:
+    // Turns every exchange event into an ExchangeEvent on the event ring
+    struct Listener
+    {
+        void OnOrderInserted(const OrderInsertedEvent& event);
+        void OnOrderDeleted(const OrderDeletedEvent& event);
+        void OnOrderAmended(const OrderAmendedEvent& event);
+        void OnOrdersCancelled(const OrdersCancelledEvent& event);
+        void OnBestPriceChanged(const BestPriceChangedEvent& event);
+        void OnTrade(const TradeEvent& event);
+
+        BookThread* thread;
+    };
+
+    void Run();
+    void Publish(const ExchangeEvent& event);
+
+    BasicExchange<Listener>   m_exchange;
+    SpscRing<OrderCommand>    m_commands;
+    SpscRing<ExchangeEvent>   m_events;
+    EventCount                m_commands_ready;
+    EventCount                m_events_ready;
+    std::atomic<bool>         m_running;
+    std::thread               m_thread;
+};
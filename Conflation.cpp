@@ -0,0 +1,100 @@
+#include "Conflation.h"
+
+BestPriceConflator::BestPriceConflator(std::size_t symbol_count)
+{
+    Grow(symbol_count);
+}
+
+BestPriceConflator::SubscriberId BestPriceConflator::AddSubscriber(BestPriceFunction callback,
+                                                                   Clock::duration   cadence)
+{
+    Subscriber subscriber;
+    subscriber.callback = std::move(callback);
+    subscriber.cadence  = cadence;
+    subscriber.next_due = Clock::time_point::min();
+    // A new subscriber starts from empty books, so every symbol with prices
+    // is published to it first
+    subscriber.published.resize(m_latest.size(), Prices{0, 0, 0, 0});
+    subscriber.marked.resize(m_latest.size(), false);
+    subscriber.dirty.reserve(m_latest.size());
+    for (SymbolId symbol = 0; symbol < m_latest.size(); ++symbol)
+    {
+        if (!(m_latest[symbol] == Prices{0, 0, 0, 0}))
+        {
+            subscriber.marked[symbol] = true;
+            subscriber.dirty.push_back(symbol);
+        }
+    }
+    m_subscribers.push_back(std::move(subscriber));
+    return SubscriberId(m_subscribers.size() - 1);
+}
+
+void BestPriceConflator::Update(const BestPriceChangedEvent& event)
+{
+    if (event.symbol >= m_latest.size())
+    {
+        Grow(std::size_t(event.symbol) + 1);
+    }
+    m_latest[event.symbol] = Prices{event.bestBid, event.totalBidVolume, event.bestAsk, event.totalAskVolume};
+    for (Subscriber& subscriber : m_subscribers)
+    {
+        if (!subscriber.marked[event.symbol])
+        {
+            subscriber.marked[event.symbol] = true;
+            subscriber.dirty.push_back(event.symbol);
+        }
+    }
+}
+
+std::size_t BestPriceConflator::Poll(Clock::time_point now)
+{
+    std::size_t published = 0;
+    for (SubscriberId id = 0; id < m_subscribers.size(); ++id)
+    {
+        Subscriber& subscriber = m_subscribers[id];
+        if (subscriber.cadence == Clock::duration::zero() || now < subscriber.next_due)
+        {
+            continue;
+        }
+        // Due again one cadence from now, not from when it was last due, so a
+        // late poll never publishes twice in a row
+        subscriber.next_due = now + subscriber.cadence;
+        published += Publish(id);
+    }
+    return published;
+}
+
+std::size_t BestPriceConflator::Publish(SubscriberId id)
+{
+    Subscriber& subscriber = m_subscribers[id];
+    std::size_t published  = 0;
+    for (SymbolId symbol : subscriber.dirty)
+    {
+        subscriber.marked[symbol] = false;
+        const Prices& latest      = m_latest[symbol];
+        if (subscriber.published[symbol] == latest)
+        {
+            continue;
+        }
+        subscriber.published[symbol] = latest;
+        ++published;
+        if (subscriber.callback)
+        {
+            subscriber.callback(
+                BestPriceChangedEvent{symbol, latest.bid, latest.bid_volume, latest.ask, latest.ask_volume});
+        }
+    }
+    subscriber.dirty.clear();
+    return published;
+}
+
+void BestPriceConflator::Grow(std::size_t symbol_count)
+{
+    m_latest.resize(symbol_count, Prices{0, 0, 0, 0});
+    for (Subscriber& subscriber : m_subscribers)
+    {
+        subscriber.published.resize(symbol_count, Prices{0, 0, 0, 0});
+        subscriber.marked.resize(symbol_count, false);
+        subscriber.dirty.reserve(symbol_count);
+    }
+}
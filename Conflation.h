@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ExchangeListener.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Conflates best price changes for subscribers that cannot take every one.
+// The exchange feeds each change in with Update, which only records the
+// latest prices of the symbol and marks it dirty for every subscriber. Each
+// subscriber is published to at its own cadence (see Poll) or on demand,
+// and then gets one event per dirty symbol whose prices differ from the last
+// ones it was sent: a change that was undone in between, such as a delete
+// and an insert at the same price, is not published at all. Publishing
+// costs O(dirty symbols), however many changes were fed in.
+//
+// Not thread safe: Update, Poll and Publish run on one thread, and callbacks
+// must not call back into the conflator.
+class BestPriceConflator
+{
+  public:
+    using SubscriberId      = std::uint32_t;
+    using BestPriceFunction = std::function<void(const BestPriceChangedEvent&)>;
+    using Clock             = std::chrono::steady_clock;
+
+    // Sized for symbol_count symbols, later ones grow the tables on first use
+    explicit BestPriceConflator(std::size_t symbol_count = 0);
+
+    // A cadence of zero publishes on demand only. The first Poll publishes.
+    SubscriberId AddSubscriber(BestPriceFunction callback, Clock::duration cadence = Clock::duration::zero());
+
+    // Record the latest best prices of a symbol
+    void Update(const BestPriceChangedEvent& event);
+
+    // Publish to every subscriber whose cadence is due at now. Returns the
+    // number of events published.
+    std::size_t Poll(Clock::time_point now = Clock::now());
+    // Publish the dirty symbols of one subscriber now
+    std::size_t Publish(SubscriberId subscriber);
+
+    // Symbols waiting to be published to subscriber, changed or not
+    std::size_t Dirty(SubscriberId subscriber) const { return m_subscribers[subscriber].dirty.size(); }
+
+  private:
+    struct Prices
+    {
+        Price  bid;
+        Volume bid_volume;
+        Price  ask;
+        Volume ask_volume;
+
+        bool operator==(const Prices& other) const
+        {
+            return bid == other.bid && bid_volume == other.bid_volume && ask == other.ask
+                   && ask_volume == other.ask_volume;
+        }
+    };
+
+    struct Subscriber
+    {
+        BestPriceFunction callback;
+        Clock::duration   cadence;
+        Clock::time_point next_due;
+        // Prices last published, and whether a symbol is in dirty, by SymbolId
+        std::vector<Prices> published;
+        std::vector<bool>   marked;
+        // Symbols updated since the last publish, each once
+        std::vector<SymbolId> dirty;
+    };
+
+    void Grow(std::size_t symbol_count);
+
+    // Latest prices by SymbolId
+    std::vector<Prices>     m_latest;
+    std::vector<Subscriber> m_subscribers;
+};
+
+// Listener feeding a BasicExchange's best price changes into a conflator
+struct ConflatingListener : NullListener
+{
+    void OnBestPriceChanged(const BestPriceChangedEvent& event) { conflator->Update(event); }
+
+    BestPriceConflator* conflator;
+};
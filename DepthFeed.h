@@ -0,0 +1,68 @@
+#pragma once
+
+#include "IExchange.h"
+#include "SymbolTable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One change of the total volume resting at a price level
+struct DepthUpdate
+{
+    enum class Action : std::uint8_t
+    {
+        // A level appeared, changed volume or emptied
+        Add,
+        Modify,
+        Delete,
+        // Forget every level of the symbol, the Adds of a snapshot follow
+        Clear
+    };
+
+    // Increases by one per update published, across all symbols
+    std::uint64_t sequence;
+    SymbolId      symbol;
+    Price         price;
+    // Total volume left at the level, 0 for Delete and Clear
+    Volume       volume;
+    std::uint8_t side;
+    Action       action;
+};
+
+static_assert(sizeof(DepthUpdate) == 24, "depth updates are 24 bytes");
+
+// Fixed-capacity buffer of depth updates filled by the book and drained by
+// the reader between calls into the exchange. Nothing is allocated after
+// construction. When the buffer is full updates are dropped but still take a
+// sequence number, so the reader sees the gap and requests a snapshot.
+class DepthPublisher
+{
+  public:
+    explicit DepthPublisher(std::size_t capacity = 0) : m_updates(capacity), m_size(0), m_sequence(0) {}
+
+    bool Enabled() const { return !m_updates.empty(); }
+
+    void Publish(DepthUpdate::Action action, SymbolId symbol, Side side, Price price, Volume volume)
+    {
+        std::uint64_t sequence = ++m_sequence;
+        if (m_size < m_updates.size())
+        {
+            m_updates[m_size++] = DepthUpdate{sequence, symbol, price, volume, std::uint8_t(side), action};
+        }
+    }
+
+    // Updates published since the last Clear, oldest first
+    const DepthUpdate* Updates() const { return m_updates.data(); }
+    std::size_t        Size() const { return m_size; }
+    std::size_t        Free() const { return m_updates.size() - m_size; }
+    void               Clear() { m_size = 0; }
+
+    // Sequence number of the last update published
+    std::uint64_t Sequence() const { return m_sequence; }
+
+  private:
+    std::vector<DepthUpdate> m_updates;
+    std::size_t              m_size;
+    std::uint64_t            m_sequence;
+};
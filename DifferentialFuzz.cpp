@@ -0,0 +1,344 @@
+#include "DifferentialFuzz.h"
+
+#include <algorithm>
+#include <ostream>
+#include <random>
+#include <unordered_map>
+
+namespace {
+
+// Collects the events of one engine and maps its order ids back to inserts
+class FuzzRecorder
+{
+  public:
+    FuzzRecorder(FuzzEngine& engine, const FuzzOptions& options, std::size_t op_count)
+        : m_engine(engine), m_options(options), m_ids(op_count, 0), m_inserted(op_count, false)
+    {
+        IExchange& exchange = *m_engine.exchange;
+
+        exchange.OnOrderInserted = [this](UserReference userReference, InsertError error, OrderId orderId) {
+            FuzzEvent event = Event(FuzzEvent::Type::OrderInserted, std::uint8_t(error));
+            event.userReference = userReference;
+            std::size_t op      = std::size_t(userReference);
+            if (error == InsertError::OK && op < m_ids.size())
+            {
+                m_ids[op]         = orderId;
+                m_inserted[op]    = true;
+                m_orders[orderId] = op;
+                event.order       = op;
+            }
+            else
+            {
+                event.order_id = orderId;
+            }
+            m_events.push_back(event);
+        };
+        exchange.OnOrderDeleted = [this](OrderId orderId, DeleteError error) {
+            FuzzEvent event = Event(FuzzEvent::Type::OrderDeleted, std::uint8_t(error));
+            auto      found = m_orders.find(orderId);
+            if (found != m_orders.end())
+            {
+                event.order = found->second;
+            }
+            else
+            {
+                event.order_id = orderId;
+            }
+            m_events.push_back(event);
+        };
+        exchange.OnBestPriceChanged = [this](const std::string& symbol,
+                                             Price              bestBid,
+                                             Volume             totalBidVolume,
+                                             Price              bestAsk,
+                                             Volume             totalAskVolume) {
+            FuzzEvent event  = Event(FuzzEvent::Type::BestPriceChanged, 0);
+            auto      found  = std::find(m_options.symbols.begin(), m_options.symbols.end(), symbol);
+            event.symbol     = std::uint32_t(found - m_options.symbols.begin());
+            event.bid        = bestBid;
+            event.bid_volume = totalBidVolume;
+            event.ask        = bestAsk;
+            event.ask_volume = totalAskVolume;
+            m_events.push_back(event);
+        };
+    }
+
+    void Run(const FuzzOp& op, std::size_t index)
+    {
+        IExchange& exchange = *m_engine.exchange;
+        if (op.type == FuzzOp::Type::Insert)
+        {
+            exchange.InsertOrder(m_options.symbols[op.symbol], op.side, op.price, op.volume, UserReference(index));
+        }
+        else if (op.target != FuzzOp::kNoTarget && m_inserted[op.target])
+        {
+            exchange.DeleteOrder(m_ids[op.target]);
+        }
+        else
+        {
+            exchange.DeleteOrder(op.order_id);
+        }
+        if (m_engine.settle)
+        {
+            m_engine.settle();
+        }
+    }
+
+    std::vector<FuzzEvent>& Events() { return m_events; }
+
+  private:
+    static FuzzEvent Event(FuzzEvent::Type type, std::uint8_t error)
+    {
+        FuzzEvent event{};
+        event.type  = type;
+        event.error = error;
+        event.order = FuzzEvent::kUnknownOrder;
+        return event;
+    }
+
+    FuzzEngine&                              m_engine;
+    const FuzzOptions&                       m_options;
+    std::vector<FuzzEvent>                   m_events;
+    std::vector<OrderId>                     m_ids;
+    std::vector<bool>                        m_inserted;
+    std::unordered_map<OrderId, std::size_t> m_orders;
+};
+
+// Drop count requests at first, retargeting deletes past them
+std::vector<FuzzOp> RemoveOps(const std::vector<FuzzOp>& ops, std::size_t first, std::size_t count)
+{
+    std::vector<FuzzOp> result;
+    result.reserve(ops.size() - count);
+    for (std::size_t i = 0; i < ops.size(); ++i)
+    {
+        if (i >= first && i < first + count)
+        {
+            continue;
+        }
+        FuzzOp op = ops[i];
+        if (op.type == FuzzOp::Type::Delete && op.target != FuzzOp::kNoTarget && op.target >= first)
+        {
+            op.target = op.target < first + count ? FuzzOp::kNoTarget : op.target - count;
+        }
+        result.push_back(op);
+    }
+    return result;
+}
+
+const char* TypeName(FuzzEvent::Type type)
+{
+    switch (type)
+    {
+    case FuzzEvent::Type::OrderInserted:
+        return "OrderInserted";
+    case FuzzEvent::Type::OrderDeleted:
+        return "OrderDeleted";
+    case FuzzEvent::Type::BestPriceChanged:
+        return "BestPriceChanged";
+    }
+    return "?";
+}
+
+}  // namespace
+
+bool FuzzEvent::operator==(const FuzzEvent& other) const
+{
+    return type == other.type && error == other.error && symbol == other.symbol && userReference == other.userReference
+           && order == other.order && order_id == other.order_id && bid == other.bid && bid_volume == other.bid_volume
+           && ask == other.ask && ask_volume == other.ask_volume;
+}
+
+std::vector<FuzzOp> GenerateFuzzOps(const FuzzOptions& options)
+{
+    std::mt19937_64                              random(options.seed);
+    std::uniform_int_distribution<unsigned>      percent(0, 99);
+    std::uniform_int_distribution<std::uint32_t> listed(0, std::uint32_t(options.listed_symbols - 1));
+    std::uniform_int_distribution<std::uint32_t> any_symbol(0, std::uint32_t(options.symbols.size() - 1));
+    std::uniform_int_distribution<Price>         price(options.min_price, options.max_price);
+    std::uniform_int_distribution<Volume>        volume(1, options.max_volume);
+    // Engines number orders differently, so a bogus id must not be one any
+    // of them could issue: they are all positive
+    std::uniform_int_distribution<OrderId> bogus_id(-1000000000, 0);
+
+    std::vector<FuzzOp> ops;
+    ops.reserve(options.operations);
+    // Inserts that may still rest, deleted ones are mostly dropped
+    std::vector<std::size_t> live;
+
+    for (std::size_t i = 0; i < options.operations; ++i)
+    {
+        FuzzOp   op{};
+        unsigned roll = percent(random);
+        op.target     = FuzzOp::kNoTarget;
+        if (roll < options.delete_percent && !live.empty())
+        {
+            std::size_t slot = random() % live.size();
+            op.type          = FuzzOp::Type::Delete;
+            op.target        = live[slot];
+            // Leave some behind so they are deleted twice
+            if (percent(random) < 90)
+            {
+                live[slot] = live.back();
+                live.pop_back();
+            }
+        }
+        else if (roll < options.delete_percent + 3)
+        {
+            op.type     = FuzzOp::Type::Delete;
+            op.order_id = bogus_id(random);
+        }
+        else
+        {
+            op.type   = FuzzOp::Type::Insert;
+            op.side   = random() & 1 ? Side::Buy : Side::Sell;
+            op.symbol = listed(random);
+            op.price  = price(random);
+            op.volume = volume(random);
+            // A few invalid inserts of every kind
+            switch (roll - options.delete_percent)
+            {
+            case 3:
+                op.symbol = any_symbol(random);
+                break;
+            case 4:
+                op.price = 0;
+                break;
+            case 5:
+                op.volume = 0;
+                break;
+            default:
+                live.push_back(i);
+                break;
+            }
+        }
+        ops.push_back(op);
+    }
+    return ops;
+}
+
+FuzzResult RunDifferential(const std::vector<FuzzOp>& ops,
+                           const FuzzOptions&         options,
+                           const FuzzEngineFactory&   reference,
+                           const FuzzEngineFactory&   candidate)
+{
+    FuzzEngine   reference_engine = reference();
+    FuzzEngine   candidate_engine = candidate();
+    FuzzRecorder expected(reference_engine, options, ops.size());
+    FuzzRecorder actual(candidate_engine, options, ops.size());
+
+    FuzzResult result;
+    for (std::size_t i = 0; i < ops.size(); ++i)
+    {
+        expected.Run(ops[i], i);
+        actual.Run(ops[i], i);
+        if (expected.Events() != actual.Events())
+        {
+            result.failed   = true;
+            result.op       = i;
+            result.expected = std::move(expected.Events());
+            result.actual   = std::move(actual.Events());
+            break;
+        }
+        expected.Events().clear();
+        actual.Events().clear();
+    }
+    return result;
+}
+
+std::vector<FuzzOp> ShrinkFailure(std::vector<FuzzOp>      ops,
+                                  const FuzzOptions&       options,
+                                  const FuzzEngineFactory& reference,
+                                  const FuzzEngineFactory& candidate)
+{
+    // Nothing after the first divergence matters
+    auto fails = [&](std::vector<FuzzOp>& attempt) {
+        FuzzResult result = RunDifferential(attempt, options, reference, candidate);
+        if (result.failed)
+        {
+            attempt.resize(result.op + 1);
+        }
+        return result.failed;
+    };
+    if (!fails(ops))
+    {
+        return ops;
+    }
+
+    // Remove ever smaller runs of requests, then single ones until none can go
+    std::size_t chunk = std::max<std::size_t>(ops.size() / 2, 1);
+    for (;;)
+    {
+        bool removed = false;
+        for (std::size_t first = 0; first < ops.size();)
+        {
+            std::vector<FuzzOp> attempt = RemoveOps(ops, first, std::min(chunk, ops.size() - first));
+            if (fails(attempt))
+            {
+                ops     = std::move(attempt);
+                removed = true;
+            }
+            else
+            {
+                first += chunk;
+            }
+        }
+        if (chunk > 1)
+        {
+            chunk /= 2;
+        }
+        else if (!removed)
+        {
+            return ops;
+        }
+    }
+}
+
+void PrintFuzzOps(std::ostream& os, const std::vector<FuzzOp>& ops, const FuzzOptions& options)
+{
+    for (std::size_t i = 0; i < ops.size(); ++i)
+    {
+        const FuzzOp& op = ops[i];
+        os << i << ": ";
+        if (op.type == FuzzOp::Type::Insert)
+        {
+            os << "InsertOrder " << options.symbols[op.symbol] << (op.side == Side::Buy ? " Buy " : " Sell ")
+               << op.volume << " @ " << op.price << '\n';
+        }
+        else if (op.target != FuzzOp::kNoTarget)
+        {
+            os << "DeleteOrder order of " << op.target << " (else id " << op.order_id << ")\n";
+        }
+        else
+        {
+            os << "DeleteOrder id " << op.order_id << '\n';
+        }
+    }
+}
+
+void PrintFuzzEvents(std::ostream& os, const std::vector<FuzzEvent>& events, const FuzzOptions& options)
+{
+    for (const FuzzEvent& event : events)
+    {
+        os << "    " << TypeName(event.type);
+        if (event.type == FuzzEvent::Type::BestPriceChanged)
+        {
+            os << ' '
+               << (event.symbol < options.symbols.size() ? options.symbols[event.symbol] : std::string("?"))
+               << ' ' << event.bid_volume << " @ " << event.bid << " / " << event.ask_volume << " @ " << event.ask
+               << '\n';
+            continue;
+        }
+        os << " error " << unsigned(event.error);
+        if (event.type == FuzzEvent::Type::OrderInserted)
+        {
+            os << " reference " << event.userReference;
+        }
+        if (event.order != FuzzEvent::kUnknownOrder)
+        {
+            os << " order of " << event.order << '\n';
+        }
+        else
+        {
+            os << " id " << event.order_id << '\n';
+        }
+    }
+}
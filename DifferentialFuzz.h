@@ -0,0 +1,131 @@
+#pragma once
+
+#include "IExchange.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Differential fuzzing of exchange engines. A seeded stream of inserts,
+// deletes and invalid requests is run through a reference engine and a
+// candidate, and the OnOrderInserted, OnOrderDeleted and OnBestPriceChanged
+// events each request produces are compared. A failing stream is shrunk to
+// a minimal one that still makes the engines disagree.
+//
+// Engines may number orders differently: order ids in events are compared
+// as the request that inserted the order, see FuzzEvent.
+
+// One request of a fuzz stream
+struct FuzzOp
+{
+    enum class Type : std::uint8_t
+    {
+        Insert,
+        Delete
+    };
+
+    // Delete of an id no insert of the stream returned
+    static constexpr std::size_t kNoTarget = ~std::size_t(0);
+
+    Type type;
+    Side side;
+    // Index into FuzzOptions::symbols
+    std::uint32_t symbol;
+    Price         price;
+    Volume        volume;
+    // Deletes: the insert whose order to delete, or kNoTarget to send
+    // order_id, which is never a valid id. order_id is also sent when the
+    // insert was rejected.
+    std::size_t target;
+    OrderId     order_id;
+};
+
+struct FuzzOptions
+{
+    std::uint64_t seed{1};
+    std::size_t   operations{1000000};
+    // Listed symbols first, the rest unknown to the engines
+    std::vector<std::string> symbols{"AAPL", "MSFT", "GOOG", "UNLISTED"};
+    std::size_t              listed_symbols{3};
+    // Valid prices are drawn from this band
+    Price  min_price{90};
+    Price  max_price{110};
+    Volume max_volume{100};
+    // Percent of requests deleting an order of the stream. Inserts make up
+    // most of the rest, so from about 50 on the books stay shallow and
+    // keep running empty.
+    unsigned delete_percent{40};
+};
+
+// An event as recorded for comparison. Order ids of orders inserted by the
+// stream are replaced by the index of their insert; other ids are kept.
+struct FuzzEvent
+{
+    enum class Type : std::uint8_t
+    {
+        OrderInserted,
+        OrderDeleted,
+        BestPriceChanged
+    };
+
+    static constexpr std::size_t kUnknownOrder = ~std::size_t(0);
+
+    Type          type;
+    std::uint8_t  error;
+    std::uint32_t symbol;
+    UserReference userReference;
+    // Insert index of the order, or kUnknownOrder and the id as reported
+    std::size_t order;
+    OrderId     order_id;
+    Price       bid;
+    Volume      bid_volume;
+    Price       ask;
+    Volume      ask_volume;
+
+    bool operator==(const FuzzEvent& other) const;
+    bool operator!=(const FuzzEvent& other) const { return !(*this == other); }
+};
+
+// An engine under test and how to wait until it has delivered the events of
+// the requests made so far, empty for engines that deliver them in the call
+struct FuzzEngine
+{
+    std::unique_ptr<IExchange> exchange;
+    std::function<void()>      settle;
+};
+
+using FuzzEngineFactory = std::function<FuzzEngine()>;
+
+// Where a run diverged
+struct FuzzResult
+{
+    bool        failed{false};
+    std::size_t op{0};
+    // Events of that request from each engine
+    std::vector<FuzzEvent> expected;
+    std::vector<FuzzEvent> actual;
+};
+
+std::vector<FuzzOp> GenerateFuzzOps(const FuzzOptions& options);
+
+// Run ops through fresh engines and stop at the first request whose events
+// differ. User references are the index of the request.
+FuzzResult RunDifferential(const std::vector<FuzzOp>& ops,
+                           const FuzzOptions&         options,
+                           const FuzzEngineFactory&   reference,
+                           const FuzzEngineFactory&   candidate);
+
+// Smallest stream found by removing requests from ops that still fails:
+// removing any single remaining request makes it pass
+std::vector<FuzzOp> ShrinkFailure(std::vector<FuzzOp>      ops,
+                                  const FuzzOptions&       options,
+                                  const FuzzEngineFactory& reference,
+                                  const FuzzEngineFactory& candidate);
+
+// Human readable reproducer, one request or event per line
+void PrintFuzzOps(std::ostream& os, const std::vector<FuzzOp>& ops, const FuzzOptions& options);
+void PrintFuzzEvents(std::ostream& os, const std::vector<FuzzEvent>& events, const FuzzOptions& options);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "IExchange.h"
+#include "SymbolTable.h"
+
+#include <cstddef>
+#include <cstdint>
+
+enum class AmendError
+{
+    OK,
+    OrderNotFound,
+    InvalidPrice,
+    InvalidVolume,
+    SystemError,
+    // The new price or volume breaks a limit of the owning account
+    RiskRejected,
+    // The symbol is halted and the amend is not a reduction in place
+    SymbolHalted
+};
+
+// Limit of the owning account an order would break, see RiskGate
+enum class RiskError : std::uint8_t
+{
+    OK,
+    OrderVolume,
+    OpenOrders,
+    SymbolNotional,
+    PriceBand
+};
+
+// Events a BasicExchange hands to its listener, by const reference and in the
+// order they happen. They are plain structs; symbols are SymbolIds, see
+// MyExchange::SymbolName.
+
+struct OrderInsertedEvent
+{
+    UserReference userReference;
+    InsertError   error;
+    OrderId       orderId;
+    // Why the risk gate rejected the order, error is SystemError then
+    RiskError risk{RiskError::OK};
+};
+
+struct OrderDeletedEvent
+{
+    OrderId     orderId;
+    DeleteError error;
+};
+
+struct OrderAmendedEvent
+{
+    OrderId    orderId;
+    AmendError error;
+};
+
+// Orders removed by one MassCancel, valid during the call only
+struct OrdersCancelledEvent
+{
+    const OrderId* orderIds;
+    std::size_t    count;
+};
+
+struct BestPriceChangedEvent
+{
+    SymbolId symbol;
+    Price    bestBid;
+    Volume   totalBidVolume;
+    Price    bestAsk;
+    Volume   totalAskVolume;
+};
+
+struct TradeEvent
+{
+    SymbolId symbol;
+    OrderId  aggressorId;
+    OrderId  restingId;
+    Price    price;
+    Volume   volume;
+};
+
+// Listener ignoring every event. Derive from it and hide the handlers of the
+// events of interest; the exchange calls them directly, so they can be inlined.
+struct NullListener
+{
+    void OnOrderInserted(const OrderInsertedEvent&) {}
+    void OnOrderDeleted(const OrderDeletedEvent&) {}
+    void OnOrderAmended(const OrderAmendedEvent&) {}
+    void OnOrdersCancelled(const OrdersCancelledEvent&) {}
+    void OnBestPriceChanged(const BestPriceChangedEvent&) {}
+    void OnTrade(const TradeEvent&) {}
+};
+
+// Listener of MyExchange: events go to the std::function members of
+// IExchange and MyExchange, symbols translated back to names
+struct CallbackListener
+{
+};
@@ -0,0 +1,174 @@
+// Differential fuzzer: runs seeded request streams through MyExchange, the
+// reference, and a candidate engine and compares their events, see
+// DifferentialFuzz.h. On the first divergence the stream is shrunk and the
+// reproducer printed with the events each engine produced for its last
+// request.
+//
+//     fuzz.out [--ops N] [--seed S] [--runs R] [--candidate NAME]
+//
+// Candidates are ladder (MyExchange with a 64 slot price ladder, fed prices
+// over several windows and books that keep running empty, so orders fall
+// back to the tree and the window recenters), sharded (ShardedExchange over
+// two shards) or all. N defaults to a million requests per run, and run R
+// uses seed S + R. The exit status is 1 if any run diverged.
+
+#include "DifferentialFuzz.h"
+#include "MyExchange.h"
+#include "ShardedExchange.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+struct FuzzToolOptions
+{
+    FuzzOptions fuzz;
+    std::size_t runs{1};
+    std::string candidate{"all"};
+};
+
+FuzzEngine ReferenceEngine()
+{
+    return FuzzEngine{std::make_unique<MyExchange>(), {}};
+}
+
+// The smallest ladder there is, PriceLadder rounds up to one 64 slot word
+constexpr std::size_t kLadderLevels = 64;
+
+FuzzEngine LadderEngine()
+{
+    ExchangeConfig config;
+    config.ladder_levels = kLadderLevels;
+    return FuzzEngine{std::make_unique<MyExchange>(config), {}};
+}
+
+// Prices over four ladder windows, and about as many deletes as inserts
+FuzzOptions LadderOptions(FuzzOptions options)
+{
+    options.min_price      = 1000;
+    options.max_price      = Price(1000 + 4 * kLadderLevels);
+    options.delete_percent = 50;
+    return options;
+}
+
+FuzzEngine ShardedEngine()
+{
+    auto       exchange = std::make_unique<ShardedExchange>(ExchangeConfig(), 2);
+    FuzzEngine engine;
+    engine.settle   = [sharded = exchange.get()] { sharded->Drain(); };
+    engine.exchange = std::move(exchange);
+    return engine;
+}
+
+FuzzOptions ShardedOptions(FuzzOptions options)
+{
+    return options;
+}
+
+struct Candidate
+{
+    const char* name;
+    FuzzEngine  (*engine)();
+    // The stream it is fuzzed with, from the one given on the command line
+    FuzzOptions (*options)(FuzzOptions);
+};
+
+bool ParseOptions(int argc, char** argv, FuzzToolOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg   = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr)
+        {
+            return false;
+        }
+        if (std::strcmp(arg, "--ops") == 0)
+        {
+            options.fuzz.operations = std::strtoull(value, nullptr, 10);
+        }
+        else if (std::strcmp(arg, "--seed") == 0)
+        {
+            options.fuzz.seed = std::strtoull(value, nullptr, 10);
+        }
+        else if (std::strcmp(arg, "--runs") == 0)
+        {
+            options.runs = std::strtoull(value, nullptr, 10);
+        }
+        else if (std::strcmp(arg, "--candidate") == 0)
+        {
+            options.candidate = value;
+        }
+        else
+        {
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+// Fuzz one candidate, false if it diverged
+bool Fuzz(const Candidate& engine, const FuzzToolOptions& options)
+{
+    const char*       name      = engine.name;
+    FuzzEngineFactory candidate = engine.engine;
+    FuzzOptions       fuzz      = engine.options(options.fuzz);
+    for (std::size_t run = 0; run < options.runs; ++run, ++fuzz.seed)
+    {
+        std::vector<FuzzOp> ops    = GenerateFuzzOps(fuzz);
+        FuzzResult          result = RunDifferential(ops, fuzz, ReferenceEngine, candidate);
+        if (!result.failed)
+        {
+            std::cout << name << " seed " << fuzz.seed << ": " << ops.size() << " requests agree" << std::endl;
+            continue;
+        }
+
+        std::cout << name << " seed " << fuzz.seed << ": diverged at request " << result.op << ", shrinking"
+                  << std::endl;
+        ops    = ShrinkFailure(std::move(ops), fuzz, ReferenceEngine, candidate);
+        result = RunDifferential(ops, fuzz, ReferenceEngine, candidate);
+        std::cout << "reproducer, " << ops.size() << " requests:\n";
+        PrintFuzzOps(std::cout, ops, fuzz);
+        std::cout << "reference events of request " << result.op << ":\n";
+        PrintFuzzEvents(std::cout, result.expected, fuzz);
+        std::cout << name << " events of request " << result.op << ":\n";
+        PrintFuzzEvents(std::cout, result.actual, fuzz);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    FuzzToolOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::cerr << "usage: " << argv[0] << " [--ops N] [--seed S] [--runs R] [--candidate ladder|sharded|all]\n";
+        return 2;
+    }
+
+    const Candidate candidates[] = {{"ladder", LadderEngine, LadderOptions},
+                                    {"sharded", ShardedEngine, ShardedOptions}};
+
+    bool ran    = false;
+    bool agreed = true;
+    for (const Candidate& candidate : candidates)
+    {
+        if (options.candidate == "all" || options.candidate == candidate.name)
+        {
+            ran    = true;
+            agreed = Fuzz(candidate, options) && agreed;
+        }
+    }
+    if (!ran)
+    {
+        std::cerr << "unknown candidate " << options.candidate << "\n";
+        return 2;
+    }
+    return agreed ? 0 : 1;
+}
@@ -0,0 +1,457 @@
+#include "Gateway.h"
+#include "MyExchangeImpl.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// epoll tags of the descriptors that are not connections, which are tagged
+// with their SessionId
+constexpr std::uint64_t kWakeTag = 0;
+constexpr std::uint64_t kTcpTag  = UINT64_MAX - 1;
+constexpr std::uint64_t kUnixTag = UINT64_MAX;
+
+// Events handled per epoll_wait
+constexpr int kMaxEvents = 64;
+
+}  // namespace
+
+Gateway::Gateway(const GatewayConfig& config)
+    : m_config(config),
+      m_exchange(config.exchange, Listener{{}, this}),
+      m_epoll_fd(::epoll_create1(EPOLL_CLOEXEC)),
+      m_tcp_fd(-1),
+      m_unix_fd(-1),
+      m_wake_fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      m_tcp_port(-1),
+      m_running(true),
+      m_open(0),
+      m_connections(1),
+      m_current(nullptr)
+{
+    if (m_epoll_fd < 0 || m_wake_fd < 0)
+    {
+        throw std::runtime_error("cannot create the gateway event loop");
+    }
+    epoll_event event{};
+    event.events   = EPOLLIN;
+    event.data.u64 = kWakeTag;
+    ::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event);
+
+    if (m_config.tcp_port >= 0)
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port   = htons(std::uint16_t(m_config.tcp_port));
+        if (::inet_pton(AF_INET, m_config.tcp_address.c_str(), &address.sin_addr) != 1)
+        {
+            throw std::runtime_error("invalid gateway address " + m_config.tcp_address);
+        }
+        m_tcp_fd = Listen(AF_INET, &address, sizeof(address));
+        socklen_t size = sizeof(address);
+        ::getsockname(m_tcp_fd, reinterpret_cast<sockaddr*>(&address), &size);
+        m_tcp_port     = ntohs(address.sin_port);
+        event.data.u64 = kTcpTag;
+        ::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_tcp_fd, &event);
+    }
+    if (!m_config.unix_path.empty())
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (m_config.unix_path.size() >= sizeof(address.sun_path))
+        {
+            throw std::runtime_error("gateway socket path too long: " + m_config.unix_path);
+        }
+        std::memcpy(address.sun_path, m_config.unix_path.c_str(), m_config.unix_path.size() + 1);
+        ::unlink(m_config.unix_path.c_str());
+        m_unix_fd      = Listen(AF_UNIX, &address, sizeof(address));
+        event.data.u64 = kUnixTag;
+        ::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_unix_fd, &event);
+    }
+    m_batch.reserve(m_config.input_capacity / sizeof(WireDelete));
+}
+
+Gateway::~Gateway()
+{
+    for (std::unique_ptr<Connection>& connection : m_connections)
+    {
+        if (connection && connection->fd >= 0)
+        {
+            ::close(connection->fd);
+        }
+    }
+    for (int fd : {m_tcp_fd, m_unix_fd, m_wake_fd, m_epoll_fd})
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+    if (m_unix_fd >= 0)
+    {
+        ::unlink(m_config.unix_path.c_str());
+    }
+}
+
+int Gateway::Listen(int family, const void* address, std::size_t address_size)
+{
+    int fd  = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int yes = 1;
+    if (fd >= 0 && family == AF_INET)
+    {
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    }
+    if (fd < 0 || ::bind(fd, static_cast<const sockaddr*>(address), socklen_t(address_size)) != 0
+        || ::listen(fd, SOMAXCONN) != 0)
+    {
+        std::string error = std::strerror(errno);
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        throw std::runtime_error("gateway cannot listen: " + error);
+    }
+    return fd;
+}
+
+void Gateway::Run()
+{
+    PinCurrentThread(m_config.exchange.placement.cpu);
+    while (Poll(-1))
+    {
+    }
+}
+
+void Gateway::Stop()
+{
+    m_running.store(false);
+    Wake();
+}
+
+void Gateway::Wake()
+{
+    std::uint64_t one = 1;
+    ssize_t       result = ::write(m_wake_fd, &one, sizeof(one));
+    (void)result;
+}
+
+bool Gateway::Poll(int timeout_ms)
+{
+    if (!m_running.load())
+    {
+        return false;
+    }
+
+    epoll_event events[kMaxEvents];
+    int         count = ::epoll_wait(m_epoll_fd, events, kMaxEvents, timeout_ms);
+    for (int i = 0; i < count; ++i)
+    {
+        std::uint64_t tag = events[i].data.u64;
+        if (tag == kWakeTag)
+        {
+            std::uint64_t value;
+            ssize_t       result = ::read(m_wake_fd, &value, sizeof(value));
+            (void)result;
+        }
+        else if (tag == kTcpTag || tag == kUnixTag)
+        {
+            Accept(tag == kTcpTag ? m_tcp_fd : m_unix_fd);
+        }
+        else if (tag < m_connections.size() && m_connections[tag] && m_connections[tag]->fd >= 0)
+        {
+            Connection& connection = *m_connections[tag];
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                Close(connection);
+            }
+            else if (events[i].events & EPOLLOUT)
+            {
+                // Room for acks again, so requests already received can run
+                connection.blocked = false;
+                Watch(connection, true, false);
+                Decode(connection);
+                m_dirty.push_back(connection.session);
+            }
+            else
+            {
+                Read(connection);
+            }
+        }
+    }
+
+    // One writev per connection for all the acks of the round
+    for (SessionId session : m_dirty)
+    {
+        Connection& connection = *m_connections[session];
+        if (connection.fd >= 0 && !Flush(connection))
+        {
+            Close(connection);
+        }
+    }
+    m_dirty.clear();
+    return m_running.load();
+}
+
+void Gateway::Accept(int listen_fd)
+{
+    for (;;)
+    {
+        int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        if (listen_fd == m_tcp_fd)
+        {
+            int yes = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        }
+
+        // Sessions are reused so that they stay small and dense
+        SessionId session;
+        if (!m_free_sessions.empty())
+        {
+            session = m_free_sessions.back();
+            m_free_sessions.pop_back();
+        }
+        else
+        {
+            session = SessionId(m_connections.size());
+            m_connections.push_back(std::make_unique<Connection>());
+            m_connections.back()->input.resize(m_config.input_capacity);
+            m_connections.back()->output.resize(m_config.output_capacity);
+        }
+        Connection& connection = *m_connections[session];
+        connection.fd          = fd;
+        connection.session     = session;
+        connection.input_size  = 0;
+        connection.output_head = 0;
+        connection.output_size = 0;
+        connection.blocked     = false;
+        ++m_open;
+
+        epoll_event event{};
+        event.events   = EPOLLIN;
+        event.data.u64 = session;
+        ::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void Gateway::Read(Connection& connection)
+{
+    ssize_t received = ::recv(connection.fd,
+                              connection.input.data() + connection.input_size,
+                              connection.input.size() - connection.input_size,
+                              0);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR))
+    {
+        Close(connection);
+        return;
+    }
+    if (received > 0)
+    {
+        connection.input_size += std::size_t(received);
+        Decode(connection);
+        m_dirty.push_back(connection.session);
+    }
+}
+
+void Gateway::Decode(Connection& connection)
+{
+    const unsigned char* input  = connection.input.data();
+    std::size_t          offset = 0;
+    // Acks of the commands decoded so far must fit the ring
+    std::size_t room = (connection.output.size() - connection.output_size) / kWireMaxAck;
+
+    m_batch.clear();
+    while (connection.input_size - offset >= sizeof(WireHeader) && m_batch.size() < room)
+    {
+        WireHeader header;
+        std::memcpy(&header, input + offset, sizeof(header));
+        if (header.length < sizeof(WireHeader) || header.length > connection.input.size())
+        {
+            Close(connection);
+            return;
+        }
+        if (connection.input_size - offset < header.length)
+        {
+            break;
+        }
+
+        const unsigned char* message = input + offset;
+        offset += header.length;
+        if (header.type == WireType::Insert && header.length >= sizeof(WireInsert))
+        {
+            WireInsert insert;
+            std::memcpy(&insert, message, sizeof(insert));
+            if (insert.side > std::uint8_t(Side::Sell))
+            {
+                Close(connection);
+                return;
+            }
+            m_batch.push_back(OrderCommand::Insert(insert.symbol,
+                                                   Side(insert.side),
+                                                   insert.price,
+                                                   insert.volume,
+                                                   insert.userReference,
+                                                   connection.session));
+        }
+        else if (header.type == WireType::Delete && header.length >= sizeof(WireDelete))
+        {
+            WireDelete request;
+            std::memcpy(&request, message, sizeof(request));
+            m_batch.push_back(OrderCommand::Delete(request.orderId, connection.session));
+        }
+        else if (header.type == WireType::Amend && header.length >= sizeof(WireAmend))
+        {
+            WireAmend amend;
+            std::memcpy(&amend, message, sizeof(amend));
+            m_batch.push_back(OrderCommand::Amend(amend.orderId, amend.price, amend.volume, connection.session));
+        }
+        else
+        {
+            // Requests must be understood, otherwise acks would be out of step
+            Close(connection);
+            return;
+        }
+    }
+
+    if (!m_batch.empty())
+    {
+        m_current = &connection;
+        m_exchange.ProcessBatch(m_batch.data(), m_batch.size());
+        m_current = nullptr;
+    }
+
+    // Keep the partial request at the front of the buffer
+    std::memmove(connection.input.data(), input + offset, connection.input_size - offset);
+    connection.input_size -= offset;
+
+    // A whole request is waiting but its ack has no room: stop reading
+    if (connection.input_size >= sizeof(WireHeader) && m_batch.size() == room && !connection.blocked)
+    {
+        connection.blocked = true;
+        Watch(connection, false, true);
+    }
+}
+
+void Gateway::Queue(const void* ack, std::size_t size)
+{
+    if (m_current == nullptr)
+    {
+        return;
+    }
+    // Room was checked in Decode, one ack per command
+    Connection&          connection = *m_current;
+    const unsigned char* bytes      = static_cast<const unsigned char*>(ack);
+    std::size_t          capacity   = connection.output.size();
+    std::size_t          tail       = (connection.output_head + connection.output_size) % capacity;
+    std::size_t          first      = size < capacity - tail ? size : capacity - tail;
+    std::memcpy(connection.output.data() + tail, bytes, first);
+    std::memcpy(connection.output.data(), bytes + first, size - first);
+    connection.output_size += size;
+}
+
+bool Gateway::Flush(Connection& connection)
+{
+    if (connection.output_size == 0)
+    {
+        return true;
+    }
+    // The ring wraps at most once, so two pieces cover it
+    std::size_t capacity = connection.output.size();
+    std::size_t first    = capacity - connection.output_head;
+    if (first > connection.output_size)
+    {
+        first = connection.output_size;
+    }
+    iovec pieces[2];
+    pieces[0].iov_base = connection.output.data() + connection.output_head;
+    pieces[0].iov_len  = first;
+    pieces[1].iov_base = connection.output.data();
+    pieces[1].iov_len  = connection.output_size - first;
+
+    // writev through sendmsg, so a peer gone away cannot raise SIGPIPE
+    msghdr message{};
+    message.msg_iov    = pieces;
+    message.msg_iovlen = pieces[1].iov_len ? 2 : 1;
+    ssize_t written    = ::sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+    if (written < 0)
+    {
+        return errno == EAGAIN || errno == EINTR;
+    }
+    connection.output_head = (connection.output_head + std::size_t(written)) % capacity;
+    connection.output_size -= std::size_t(written);
+    if (connection.output_size != 0 && !connection.blocked)
+    {
+        // Finish once the socket drains
+        connection.blocked = true;
+        Watch(connection, false, true);
+    }
+    return true;
+}
+
+void Gateway::Watch(Connection& connection, bool readable, bool writable)
+{
+    epoll_event event{};
+    event.events   = (readable ? EPOLLIN : 0u) | (writable ? EPOLLOUT : 0u);
+    event.data.u64 = connection.session;
+    ::epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void Gateway::Close(Connection& connection)
+{
+    if (connection.fd < 0)
+    {
+        return;
+    }
+    ::epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    ::close(connection.fd);
+    connection.fd = -1;
+    --m_open;
+
+    // Cancel on disconnect, nobody is left to ack. Orders a failed cancel
+    // left behind keep the session from being handed to another client.
+    if (m_exchange.MassCancel(MassCancelFilter::Session(connection.session)) != kMassCancelFailed)
+    {
+        m_free_sessions.push_back(connection.session);
+    }
+}
+
+void Gateway::Listener::OnOrderInserted(const OrderInsertedEvent& event)
+{
+    WireInsertAck ack = MakeWire<WireInsertAck>(WireType::InsertAck);
+    ack.userReference = event.userReference;
+    ack.orderId       = event.orderId;
+    ack.error         = std::uint8_t(event.error);
+    ack.risk          = std::uint8_t(event.risk);
+    gateway->Queue(&ack, sizeof(ack));
+}
+
+void Gateway::Listener::OnOrderDeleted(const OrderDeletedEvent& event)
+{
+    WireDeleteAck ack = MakeWire<WireDeleteAck>(WireType::DeleteAck);
+    ack.orderId       = event.orderId;
+    ack.error         = std::uint8_t(event.error);
+    gateway->Queue(&ack, sizeof(ack));
+}
+
+void Gateway::Listener::OnOrderAmended(const OrderAmendedEvent& event)
+{
+    WireAmendAck ack = MakeWire<WireAmendAck>(WireType::AmendAck);
+    ack.orderId      = event.orderId;
+    ack.error        = std::uint8_t(event.error);
+    gateway->Queue(&ack, sizeof(ack));
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "MyExchange.h"
+#include "WireProtocol.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct GatewayConfig
+{
+    ExchangeConfig exchange;
+    // TCP port to listen on, 0 for one chosen by the system, -1 for none
+    int         tcp_port{-1};
+    std::string tcp_address{"127.0.0.1"};
+    // Unix domain socket to listen on, none when empty
+    std::string unix_path;
+    // Bytes of request and ack buffering per connection
+    std::size_t input_capacity{1 << 16};
+    std::size_t output_capacity{1 << 16};
+};
+
+// Single-threaded order entry gateway in front of one exchange. One epoll loop
+// accepts TCP and Unix socket clients and decodes the wire protocol (see
+// WireProtocol.h) straight out of each receive buffer into OrderCommands,
+// which run through ProcessBatch once per read. Acks collect in a ring per
+// connection and are written with one writev per connection and loop round.
+// A client that stops reading its acks stops being read from.
+//
+// Every connection is a session: it can only delete and amend its own orders,
+// others are answered with OrderNotFound, and its resting orders are mass
+// cancelled when it disconnects.
+class Gateway
+{
+  public:
+    // Throws std::runtime_error if a listening socket cannot be set up
+    explicit Gateway(const GatewayConfig& config);
+    ~Gateway();
+
+    Gateway(const Gateway&) = delete;
+    Gateway& operator=(const Gateway&) = delete;
+
+    // Serve until Stop, from the thread owning the gateway, which is first
+    // pinned to the core of ExchangeConfig::placement
+    void Run();
+    // One round of the loop waiting up to timeout_ms, false once stopped
+    bool Poll(int timeout_ms);
+    // Safe from any thread
+    void Stop();
+
+    // Port actually bound, see GatewayConfig::tcp_port
+    int TcpPort() const { return m_tcp_port; }
+
+    // Open connections, safe from any thread
+    std::size_t Connections() const { return m_open.load(); }
+    // Arena of the exchange's order pool, see PlacementConfig
+    const MemoryArena* Arena() const { return m_exchange.Arena(); }
+
+  private:
+    // Queues the ack of each command for the connection it came from
+    struct Listener : NullListener
+    {
+        void OnOrderInserted(const OrderInsertedEvent& event);
+        void OnOrderDeleted(const OrderDeletedEvent& event);
+        void OnOrderAmended(const OrderAmendedEvent& event);
+
+        Gateway* gateway;
+    };
+
+    struct Connection
+    {
+        int       fd{-1};
+        SessionId session{kNoSession};
+        // Received bytes not decoded yet
+        std::vector<unsigned char> input;
+        std::size_t                input_size{0};
+        // Ring of encoded acks
+        std::vector<unsigned char> output;
+        std::size_t                output_head{0};
+        std::size_t                output_size{0};
+        // Waiting for the socket to take more acks before reading again
+        bool blocked{false};
+    };
+
+    void Accept(int listen_fd);
+    void Read(Connection& connection);
+    // Decode and run every whole request that has room for its ack
+    void Decode(Connection& connection);
+    // writev the pending acks, false if the connection failed
+    bool Flush(Connection& connection);
+    void Close(Connection& connection);
+    void Watch(Connection& connection, bool readable, bool writable);
+
+    void Queue(const void* ack, std::size_t size);
+
+    int  Listen(int family, const void* address, std::size_t address_size);
+    void Wake();
+
+    GatewayConfig            m_config;
+    BasicExchange<Listener>  m_exchange;
+    int                      m_epoll_fd;
+    int                      m_tcp_fd;
+    int                      m_unix_fd;
+    int                      m_wake_fd;
+    int                      m_tcp_port;
+    std::atomic<bool>        m_running;
+    std::atomic<std::size_t> m_open;
+
+    // Indexed by SessionId, slot 0 is never used
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    std::vector<SessionId>                   m_free_sessions;
+    // Connections with acks to write at the end of the round
+    std::vector<SessionId> m_dirty;
+    // Connection whose commands are running
+    Connection*               m_current;
+    std::vector<OrderCommand> m_batch;
+};
@@ -0,0 +1,177 @@
+// Order entry gateway serving one MyExchange over TCP and Unix domain sockets,
+// see Gateway.h for the loop and WireProtocol.h for the messages.
+//
+//     gateway.out [--port N] [--address IP] [--unix PATH] [--symbols FILE]
+//                 [--matching 0|1] [--journal FILE] [--cpu N] [--arena MB]
+//                 [--huge-pages none|thp|2mb|1gb] [--prefault 0|1]
+//
+// --cpu pins the gateway loop, --arena places the order pool in that many MB
+// of huge pages on the core's NUMA node, see PlacementConfig.
+//
+// Listens on 127.0.0.1:9000 when neither --port nor --unix is given. Stops
+// cleanly on SIGINT and SIGTERM.
+
+#include "Gateway.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+Gateway* g_gateway = nullptr;
+
+void StopGateway(int)
+{
+    if (g_gateway)
+    {
+        g_gateway->Stop();
+    }
+}
+
+bool ParseHugePages(const char* value, HugePages& huge_pages)
+{
+    const std::pair<const char*, HugePages> names[] = {{"none", HugePages::None},
+                                                       {"thp", HugePages::Transparent},
+                                                       {"2mb", HugePages::Huge2MB},
+                                                       {"1gb", HugePages::Huge1GB}};
+    for (const auto& name : names)
+    {
+        if (std::strcmp(value, name.first) == 0)
+        {
+            huge_pages = name.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* BackingName(MemoryArena::Backing backing)
+{
+    switch (backing)
+    {
+    case MemoryArena::Backing::None:
+        return "unmapped";
+    case MemoryArena::Backing::Pages:
+        return "ordinary pages";
+    case MemoryArena::Backing::Transparent:
+        return "transparent huge pages";
+    case MemoryArena::Backing::Huge2MB:
+        return "2MB huge pages";
+    case MemoryArena::Backing::Huge1GB:
+        return "1GB huge pages";
+    }
+    return "?";
+}
+
+bool ParseOptions(int argc, char** argv, GatewayConfig& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg   = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr)
+        {
+            return false;
+        }
+        if (std::strcmp(arg, "--port") == 0)
+        {
+            config.tcp_port = std::atoi(value);
+        }
+        else if (std::strcmp(arg, "--address") == 0)
+        {
+            config.tcp_address = value;
+        }
+        else if (std::strcmp(arg, "--unix") == 0)
+        {
+            config.unix_path = value;
+        }
+        else if (std::strcmp(arg, "--symbols") == 0)
+        {
+            config.exchange.symbol_file = value;
+        }
+        else if (std::strcmp(arg, "--matching") == 0)
+        {
+            config.exchange.matching = std::atoi(value) != 0;
+        }
+        else if (std::strcmp(arg, "--journal") == 0)
+        {
+            config.exchange.journal_file = value;
+        }
+        else if (std::strcmp(arg, "--cpu") == 0)
+        {
+            config.exchange.placement.cpu = std::atoi(value);
+        }
+        else if (std::strcmp(arg, "--arena") == 0)
+        {
+            config.exchange.placement.arena_bytes = std::strtoull(value, nullptr, 10) << 20;
+        }
+        else if (std::strcmp(arg, "--huge-pages") == 0)
+        {
+            if (!ParseHugePages(value, config.exchange.placement.huge_pages))
+            {
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--prefault") == 0)
+        {
+            config.exchange.placement.prefault = std::atoi(value) != 0;
+        }
+        else
+        {
+            return false;
+        }
+        ++i;
+    }
+    if (config.tcp_port < 0 && config.unix_path.empty())
+    {
+        config.tcp_port = 9000;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    GatewayConfig config;
+    if (!ParseOptions(argc, argv, config))
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " [--port N] [--address IP] [--unix PATH] [--symbols FILE] [--matching 0|1] [--journal FILE]"
+                     " [--cpu N] [--arena MB] [--huge-pages none|thp|2mb|1gb] [--prefault 0|1]\n";
+        return 2;
+    }
+
+    try
+    {
+        Gateway gateway(config);
+        g_gateway = &gateway;
+        std::signal(SIGINT, StopGateway);
+        std::signal(SIGTERM, StopGateway);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        if (const MemoryArena* arena = gateway.Arena())
+        {
+            std::cout << "order pool in " << (arena->Size() >> 20) << "MB of " << BackingName(arena->GetBacking())
+                      << ", numa node " << arena->NumaNode() << std::endl;
+        }
+        if (gateway.TcpPort() >= 0)
+        {
+            std::cout << "listening on " << config.tcp_address << ":" << gateway.TcpPort() << std::endl;
+        }
+        if (!config.unix_path.empty())
+        {
+            std::cout << "listening on " << config.unix_path << std::endl;
+        }
+        gateway.Run();
+        g_gateway = nullptr;
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "Journal.h"
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char          kMagic[8] = {'T', 'X', 'J', 'R', 'N', 'L', '0', '1'};
+constexpr std::uint32_t kVersion  = 2;
+
+// Records start one header after the beginning of the file
+struct JournalHeader
+{
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+    unsigned char reserved[24];
+};
+
+static_assert(sizeof(JournalHeader) == sizeof(JournalRecord), "header keeps records aligned");
+
+}  // namespace
+
+Journal::Journal(const std::string& path, std::size_t group_commit, std::size_t grow_bytes)
+    : m_fd(-1),
+      m_base(nullptr),
+      m_mapped(0),
+      m_records(nullptr),
+      m_size(0),
+      m_committed(0),
+      m_group_commit(group_commit),
+      m_grow_bytes(grow_bytes < 4096 ? 4096 : grow_bytes)
+{
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0)
+    {
+        throw std::runtime_error("cannot open journal " + path);
+    }
+
+    struct stat status;
+    if (::fstat(m_fd, &status) != 0)
+    {
+        ::close(m_fd);
+        throw std::runtime_error("cannot stat journal " + path);
+    }
+    std::size_t file_size = std::size_t(status.st_size);
+    bool        created   = file_size == 0;
+
+    if (!Map(file_size < m_grow_bytes ? m_grow_bytes : file_size))
+    {
+        ::close(m_fd);
+        throw std::runtime_error("cannot map journal " + path);
+    }
+
+    JournalHeader& header = *reinterpret_cast<JournalHeader*>(m_base);
+    if (created)
+    {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version     = kVersion;
+        header.record_size = sizeof(JournalRecord);
+        ::msync(m_base, sizeof(header), MS_SYNC);
+    }
+    else if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion
+             || header.record_size != sizeof(JournalRecord))
+    {
+        ::munmap(m_base, m_mapped);
+        ::close(m_fd);
+        throw std::runtime_error("not a journal " + path);
+    }
+
+    // Recover every record up to the first one that was never completed
+    std::size_t capacity = m_mapped / sizeof(JournalRecord) - 1;
+    while (m_size < capacity && m_records[m_size].sequence == m_size + 1)
+    {
+        ++m_size;
+    }
+    // Wipe what a crash left behind the recovered records, or stale records
+    // could be mistaken for new ones once the journal grows back over them
+    for (std::size_t index = m_size; index < capacity && m_records[index].sequence != 0; ++index)
+    {
+        m_records[index].sequence = 0;
+    }
+    m_committed = m_size;
+}
+
+Journal::~Journal()
+{
+    Commit();
+    ::munmap(m_base, m_mapped);
+    // Drop the unused tail so the file holds exactly the journal
+    if (::ftruncate(m_fd, off_t((m_size + 1) * sizeof(JournalRecord))) == 0)
+    {
+        ::fdatasync(m_fd);
+    }
+    ::close(m_fd);
+}
+
+bool Journal::Map(std::size_t bytes)
+{
+    if (::ftruncate(m_fd, off_t(bytes)) != 0)
+    {
+        return false;
+    }
+    void* base = m_base == nullptr ? ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0)
+                                   : ::mremap(m_base, m_mapped, bytes, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+    m_base    = static_cast<unsigned char*>(base);
+    m_mapped  = bytes;
+    m_records = reinterpret_cast<JournalRecord*>(m_base) + 1;
+    return true;
+}
+
+bool Journal::Append(const JournalRecord& record)
+{
+    if ((m_size + 2) * sizeof(JournalRecord) > m_mapped)
+    {
+        // Flush first so the new file size is made durable with the records
+        Commit();
+        if (!Map(m_mapped + m_grow_bytes) || ::fdatasync(m_fd) != 0)
+        {
+            return false;
+        }
+    }
+
+    JournalRecord& slot = m_records[m_size];
+    slot                = record;
+    slot.sequence       = 0;
+    // The sequence marks the record complete, keep it the last store
+    std::atomic_signal_fence(std::memory_order_release);
+    slot.sequence = ++m_size;
+
+    if (m_group_commit != 0 && m_size - m_committed >= m_group_commit)
+    {
+        Commit();
+    }
+    return true;
+}
+
+void Journal::Commit()
+{
+    if (m_committed == m_size)
+    {
+        return;
+    }
+    // msync wants a page aligned start
+    std::size_t page  = std::size_t(::sysconf(_SC_PAGESIZE));
+    std::size_t first = ((m_committed + 1) * sizeof(JournalRecord)) & ~(page - 1);
+    std::size_t last  = (m_size + 1) * sizeof(JournalRecord);
+    ::msync(m_base + first, last - first, MS_SYNC);
+    m_committed = m_size;
+}
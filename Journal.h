@@ -0,0 +1,145 @@
+#pragma once
+
+#include "IExchange.h"
+#include "SymbolTable.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Fixed-size journal entry. Records are numbered from 1 and the sequence is
+// written last, so a record torn by a crash ends the journal on recovery.
+struct JournalRecord
+{
+    enum class Type : std::uint8_t
+    {
+        Insert = 1,
+        Delete = 2,
+        // Closes the run of Batched records written by one ProcessBatch call
+        BatchEnd   = 3,
+        Amend      = 4,
+        MassCancel = 5,
+        Halt       = 6,
+        Resume     = 7,
+        // Lists or updates a symbol named by the run of SymbolName records
+        // right before it
+        AddSymbol  = 8,
+        SymbolName = 9
+    };
+
+    // Set on records written inside ProcessBatch
+    static constexpr std::uint8_t kBatched = 1;
+    // side of a MassCancel covering both sides
+    static constexpr std::uint8_t kBothSides = 2;
+    // Characters of a symbol name held by one SymbolName record
+    static constexpr std::size_t kNameBytes = 24;
+
+    Type          type;
+    std::uint8_t  flags;
+    std::uint8_t  side;
+    std::uint8_t  reserved;
+    SymbolId      symbol;
+    Price         price;
+    Volume        volume;
+    UserReference userReference;
+    // Id given to an inserted order, or the id being deleted or amended
+    OrderId orderId;
+    // Owner of an inserted order, or the session key of a MassCancel
+    std::uint32_t session;
+    std::uint32_t padding;
+    std::uint64_t sequence;
+
+    static JournalRecord Insert(SymbolId      symbol,
+                                Side          side,
+                                Price         price,
+                                Volume        volume,
+                                UserReference userReference,
+                                OrderId       orderId,
+                                std::uint32_t session)
+    {
+        return JournalRecord{
+            Type::Insert, 0, std::uint8_t(side), 0, symbol, price, volume, userReference, orderId, session, 0, 0};
+    }
+    static JournalRecord Delete(OrderId orderId)
+    {
+        return JournalRecord{Type::Delete, 0, 0, 0, 0, 0, 0, 0, orderId, 0, 0, 0};
+    }
+    static JournalRecord Amend(OrderId orderId, Price price, Volume volume)
+    {
+        return JournalRecord{Type::Amend, 0, 0, 0, 0, price, volume, 0, orderId, 0, 0, 0};
+    }
+    static JournalRecord MassCancel(SymbolId symbol, std::uint8_t side, std::uint32_t session)
+    {
+        return JournalRecord{Type::MassCancel, 0, side, 0, symbol, 0, 0, 0, 0, session, 0, 0};
+    }
+    static JournalRecord BatchEnd() { return JournalRecord{Type::BatchEnd, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}; }
+    static JournalRecord Halt(SymbolId symbol, bool halted)
+    {
+        return JournalRecord{halted ? Type::Halt : Type::Resume, 0, 0, 0, symbol, 0, 0, 0, 0, 0, 0, 0};
+    }
+    // The tick size goes in price, min_price in volume and max_price in session
+    static JournalRecord AddSymbol(SymbolId symbol, Price tick_size, Price min_price, Price max_price)
+    {
+        return JournalRecord{Type::AddSymbol, 0, 0, 0, symbol, tick_size, min_price, 0, 0, max_price, 0, 0};
+    }
+    // At most kNameBytes characters of name from offset, stored from price on
+    // with their count in side
+    static JournalRecord SymbolName(const std::string& name, std::size_t offset)
+    {
+        JournalRecord record{Type::SymbolName, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        std::size_t   length = std::min(name.size() - offset, kNameBytes);
+        record.side          = std::uint8_t(length);
+        std::memcpy(reinterpret_cast<char*>(&record) + offsetof(JournalRecord, price), name.data() + offset, length);
+        return record;
+    }
+    // Characters of a SymbolName record
+    const char* Name() const { return reinterpret_cast<const char*>(this) + offsetof(JournalRecord, price); }
+};
+
+static_assert(sizeof(JournalRecord) == 40, "journal records are 40 bytes on disk");
+static_assert(offsetof(JournalRecord, sequence) - offsetof(JournalRecord, price) >= JournalRecord::kNameBytes,
+              "symbol names stop before the sequence");
+
+// Write-ahead journal of JournalRecords appended to a memory-mapped file.
+// Appending is a copy into the mapping. Durability comes from Commit, which
+// msyncs everything appended since the previous commit; Append commits by
+// itself every group_commit records, so one fsync covers a whole group.
+//
+// Opening an existing journal keeps its records, stopping at the first torn
+// or missing one, and new records are appended after them. Throws
+// std::runtime_error if the file cannot be opened, mapped or is not a journal.
+class Journal
+{
+  public:
+    // group_commit 0 leaves every commit to the caller, the file grows in
+    // steps of grow_bytes
+    Journal(const std::string& path, std::size_t group_commit, std::size_t grow_bytes = std::size_t(1) << 24);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Sequence is filled in. Returns false if the file could not grow.
+    bool Append(const JournalRecord& record);
+    // Flush appended records to disk
+    void Commit();
+
+    // Records in the journal, recovered ones included
+    std::size_t          Size() const { return m_size; }
+    const JournalRecord& operator[](std::size_t index) const { return m_records[index]; }
+
+  private:
+    bool Map(std::size_t bytes);
+
+    int            m_fd;
+    unsigned char* m_base;
+    std::size_t    m_mapped;
+    JournalRecord* m_records;
+    std::size_t    m_size;
+    // Records already flushed by Commit
+    std::size_t m_committed;
+    std::size_t m_group_commit;
+    std::size_t m_grow_bytes;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Log-linear histogram of 64 bit samples (nanoseconds or TSC ticks). Every
+// power of two is split into 32 linear sub-buckets, so a recorded value is
+// off by at most ~3% while the whole 64 bit range fits in a fixed array.
+// Record is a handful of instructions and never allocates.
+class LatencyHistogram
+{
+  public:
+    static constexpr unsigned    kSubBits    = 5;
+    static constexpr std::size_t kSubBuckets = std::size_t(1) << kSubBits;
+    static constexpr std::size_t kBuckets    = (64 - kSubBits + 1) * kSubBuckets;
+
+    LatencyHistogram() { Reset(); }
+
+    void Reset()
+    {
+        std::memset(m_counts, 0, sizeof(m_counts));
+        m_count = 0;
+        m_max   = 0;
+        m_sum   = 0;
+    }
+
+    void Record(std::uint64_t value)
+    {
+        ++m_counts[BucketOf(value)];
+        ++m_count;
+        m_sum += value;
+        if (value > m_max)
+        {
+            m_max = value;
+        }
+    }
+
+    void Merge(const LatencyHistogram& other)
+    {
+        for (std::size_t i = 0; i < kBuckets; ++i)
+        {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        if (other.m_max > m_max)
+        {
+            m_max = other.m_max;
+        }
+    }
+
+    // Rebuild a histogram from bucket counts, see MetricHistogram
+    void AddBucket(std::size_t bucket, std::uint64_t count)
+    {
+        m_counts[bucket] += count;
+        m_count += count;
+    }
+    void AddTotals(std::uint64_t sum, std::uint64_t max)
+    {
+        m_sum += sum;
+        if (max > m_max)
+        {
+            m_max = max;
+        }
+    }
+
+    std::uint64_t Count() const { return m_count; }
+    std::uint64_t Max() const { return m_max; }
+    double        Mean() const { return m_count ? double(m_sum) / double(m_count) : 0.0; }
+
+    // Upper bound of the bucket holding the given quantile, 0 <= quantile <= 1
+    std::uint64_t Percentile(double quantile) const
+    {
+        if (m_count == 0)
+        {
+            return 0;
+        }
+        std::uint64_t rank = std::uint64_t(quantile * double(m_count));
+        if (rank == 0)
+        {
+            rank = 1;
+        }
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank)
+            {
+                std::uint64_t upper = UpperBoundOf(i);
+                return upper < m_max ? upper : m_max;
+            }
+        }
+        return m_max;
+    }
+
+    std::uint64_t CountAt(std::size_t bucket) const { return m_counts[bucket]; }
+
+    static std::size_t BucketOf(std::uint64_t value)
+    {
+        if (value < kSubBuckets)
+        {
+            return std::size_t(value);
+        }
+        unsigned shift = unsigned(63 - __builtin_clzll(value)) - kSubBits;
+        return (shift + 1) * kSubBuckets + std::size_t(value >> shift) - kSubBuckets;
+    }
+
+    static std::uint64_t UpperBoundOf(std::size_t bucket)
+    {
+        if (bucket < kSubBuckets)
+        {
+            return bucket;
+        }
+        unsigned      shift = unsigned(bucket / kSubBuckets) - 1;
+        std::uint64_t sub   = bucket % kSubBuckets + kSubBuckets;
+        return ((sub + 1) << shift) - 1;
+    }
+
+  private:
+    std::uint64_t m_counts[kBuckets];
+    std::uint64_t m_count;
+    std::uint64_t m_max;
+    std::uint64_t m_sum;
+};
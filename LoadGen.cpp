@@ -0,0 +1,295 @@
+// Load generator for the order entry gateway. Keeps a window of requests in
+// flight on one connection, inserting orders and deleting each one once a
+// window of newer ones rests, and reports round-trip latency percentiles per
+// request type. Acks come back in request order, so each is timed against the send
+// time of the oldest request outstanding.
+//
+//     loadgen.out [--port N] [--address IP] [--unix PATH] [--orders N]
+//                 [--window N] [--symbols N]
+//
+// Connects to 127.0.0.1:9000 unless --unix is given.
+
+#include "LatencyHistogram.h"
+#include "Tsc.h"
+#include "WireProtocol.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+struct LoadOptions
+{
+    int         port{9000};
+    std::string address{"127.0.0.1"};
+    std::string unix_path;
+    // Inserts sent, each followed later by a delete of the order
+    std::size_t orders{100000};
+    std::size_t window{64};
+    // Symbols 0 to symbols - 1 are traded
+    std::uint32_t symbols{3};
+};
+
+bool ParseOptions(int argc, char** argv, LoadOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg   = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr)
+        {
+            return false;
+        }
+        if (std::strcmp(arg, "--port") == 0)
+        {
+            options.port = std::atoi(value);
+        }
+        else if (std::strcmp(arg, "--address") == 0)
+        {
+            options.address = value;
+        }
+        else if (std::strcmp(arg, "--unix") == 0)
+        {
+            options.unix_path = value;
+        }
+        else if (std::strcmp(arg, "--orders") == 0)
+        {
+            options.orders = std::strtoull(value, nullptr, 10);
+        }
+        else if (std::strcmp(arg, "--window") == 0)
+        {
+            options.window = std::strtoull(value, nullptr, 10);
+        }
+        else if (std::strcmp(arg, "--symbols") == 0)
+        {
+            options.symbols = std::uint32_t(std::strtoul(value, nullptr, 10));
+        }
+        else
+        {
+            return false;
+        }
+        ++i;
+    }
+    return options.window > 0 && options.symbols > 0;
+}
+
+int Connect(const LoadOptions& options)
+{
+    int fd = -1;
+    if (!options.unix_path.empty())
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, options.unix_path.c_str(), sizeof(address.sun_path) - 1);
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    else
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port   = htons(std::uint16_t(options.port));
+        ::inet_pton(AF_INET, options.address.c_str(), &address.sin_addr);
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+        int yes = 1;
+        if (fd >= 0)
+        {
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        }
+    }
+    return fd;
+}
+
+bool SendAll(int fd, const unsigned char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno != EINTR)
+        {
+            return false;
+        }
+        if (sent > 0)
+        {
+            data += sent;
+            size -= std::size_t(sent);
+        }
+    }
+    return true;
+}
+
+void Report(const char* name, const LatencyHistogram& latency, double ticks_per_ns)
+{
+    std::printf("%-8s %10llu %10.0f %10.0f %10.0f %10.0f %12.0f\n",
+                name,
+                static_cast<unsigned long long>(latency.Count()),
+                latency.Mean() / ticks_per_ns,
+                double(latency.Percentile(0.50)) / ticks_per_ns,
+                double(latency.Percentile(0.99)) / ticks_per_ns,
+                double(latency.Percentile(0.999)) / ticks_per_ns,
+                double(latency.Max()) / ticks_per_ns);
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    LoadOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " [--port N] [--address IP] [--unix PATH] [--orders N] [--window N] [--symbols N]\n";
+        return 2;
+    }
+    int fd = Connect(options);
+    if (fd < 0)
+    {
+        std::cerr << "cannot connect: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    const double ticks_per_ns = TscTicksPerNanosecond();
+    std::mt19937 random(7);
+
+    // Send times of the requests in flight, oldest first
+    std::deque<std::uint64_t> in_flight;
+    // Orders acked but not yet deleted
+    std::deque<OrderId> resting;
+
+    LatencyHistogram insert_latency;
+    LatencyHistogram delete_latency;
+    std::size_t      inserts_sent = 0;
+    std::size_t      acked        = 0;
+    std::size_t      rejected     = 0;
+
+    std::vector<unsigned char> out;
+    std::vector<unsigned char> in(1 << 16);
+    std::size_t                in_size = 0;
+    std::uint64_t              start   = ReadTsc();
+
+    for (;;)
+    {
+        // Top the window up, deleting the oldest order once a window of them rests
+        out.clear();
+        while (in_flight.size() < options.window)
+        {
+            if (!resting.empty() && (resting.size() >= options.window || inserts_sent == options.orders))
+            {
+                WireDelete request = MakeWire<WireDelete>(WireType::Delete);
+                request.orderId    = resting.front();
+                resting.pop_front();
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&request);
+                out.insert(out.end(), bytes, bytes + sizeof(request));
+            }
+            else if (inserts_sent < options.orders)
+            {
+                WireInsert request = MakeWire<WireInsert>(WireType::Insert);
+                request.symbol     = std::uint32_t(random() % options.symbols);
+                request.side       = std::uint8_t(random() % 2);
+                // Bids below asks, so nothing trades even with matching on
+                request.price = request.side == std::uint8_t(Side::Buy) ? 1 + random() % 100 : 101 + random() % 100;
+                request.volume        = 1 + random() % 100;
+                request.userReference = UserReference(inserts_sent);
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&request);
+                out.insert(out.end(), bytes, bytes + sizeof(request));
+                ++inserts_sent;
+            }
+            else
+            {
+                break;
+            }
+            in_flight.push_back(ReadTsc());
+        }
+        if (in_flight.empty())
+        {
+            // Every insert was sent and every order deleted
+            break;
+        }
+        if (!out.empty() && !SendAll(fd, out.data(), out.size()))
+        {
+            std::cerr << "send failed: " << std::strerror(errno) << "\n";
+            return 1;
+        }
+
+        ssize_t received = ::recv(fd, in.data() + in_size, in.size() - in_size, 0);
+        if (received <= 0)
+        {
+            std::cerr << "gateway closed the connection\n";
+            return 1;
+        }
+        std::uint64_t now = ReadTsc();
+        in_size += std::size_t(received);
+
+        std::size_t offset = 0;
+        while (in_size - offset >= sizeof(WireHeader))
+        {
+            WireHeader header;
+            std::memcpy(&header, in.data() + offset, sizeof(header));
+            if (in_size - offset < header.length)
+            {
+                break;
+            }
+            std::uint64_t ticks = now - in_flight.front();
+            in_flight.pop_front();
+            if (header.type == WireType::InsertAck)
+            {
+                WireInsertAck ack;
+                std::memcpy(&ack, in.data() + offset, sizeof(ack));
+                insert_latency.Record(ticks);
+                if (ack.error == std::uint8_t(InsertError::OK))
+                {
+                    resting.push_back(ack.orderId);
+                }
+                else
+                {
+                    ++rejected;
+                }
+            }
+            else
+            {
+                delete_latency.Record(ticks);
+            }
+            offset += header.length;
+            ++acked;
+        }
+        std::memmove(in.data(), in.data() + offset, in_size - offset);
+        in_size -= offset;
+    }
+
+    double seconds = double(ReadTsc() - start) / ticks_per_ns / 1e9;
+    ::close(fd);
+
+    std::printf("%-8s %10s %10s %10s %10s %10s %12s\n", "request", "count", "mean ns", "p50 ns", "p99 ns", "p99.9 ns",
+                "max ns");
+    Report("insert", insert_latency, ticks_per_ns);
+    Report("delete", delete_latency, ticks_per_ns);
+    std::printf("%.0f requests/sec over %.3f s, window %zu, %zu inserts rejected\n",
+                double(acked) / seconds,
+                seconds,
+                options.window,
+                rejected);
+    return 0;
+}
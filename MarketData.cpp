@@ -0,0 +1,249 @@
+#include "MarketData.h"
+
+#include "RingBuffer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace market_data;
+
+namespace {
+
+// A stamp is odd while the update of sequence is written and even once it
+// is complete
+std::uint64_t Writing(std::uint64_t sequence) { return 2 * sequence - 1; }
+std::uint64_t Written(std::uint64_t sequence) { return 2 * sequence; }
+
+void Store(Words& target, std::uint64_t sequence, const MarketDataUpdate& update)
+{
+    std::uint64_t words[3];
+    std::memcpy(words, &update, sizeof(words));
+
+    target.stamp.store(Writing(sequence), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < 3; ++i)
+    {
+        target.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    target.stamp.store(Written(sequence), std::memory_order_release);
+}
+
+// The stamp seen, odd if the copy is torn
+std::uint64_t Load(const Words& source, MarketDataUpdate& update)
+{
+    std::uint64_t stamp = source.stamp.load(std::memory_order_acquire);
+    std::uint64_t words[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        words[i] = source.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (source.stamp.load(std::memory_order_relaxed) != stamp)
+    {
+        return 1;
+    }
+    std::memcpy(&update, words, sizeof(words));
+    return stamp;
+}
+
+}  // namespace
+
+MarketDataPublisher::MarketDataPublisher(const std::string& name,
+                                         std::size_t        symbol_count,
+                                         std::size_t        log_capacity,
+                                         bool               replace)
+    : m_name(name), m_device(0), m_inode(0), m_size(0), m_header(nullptr), m_table(nullptr), m_log(nullptr), m_mask(0)
+{
+    log_capacity = RoundUpToPowerOfTwo(log_capacity < 2 ? 2 : log_capacity);
+    m_size       = SegmentSize(symbol_count, log_capacity);
+    m_mask       = log_capacity - 1;
+
+    // Another exchange's readers are only taken over when asked for, an
+    // existing segment is replaced then, never reused
+    if (replace)
+    {
+        ::shm_unlink(name.c_str());
+    }
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error(errno == EEXIST ? "market data segment " + name + " already exists"
+                                                 : "cannot create market data segment " + name);
+    }
+    void*       base = MAP_FAILED;
+    struct stat status;
+    if (::fstat(fd, &status) == 0 && ::ftruncate(fd, off_t(m_size)) == 0)
+    {
+        m_device = status.st_dev;
+        m_inode  = status.st_ino;
+        base     = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error("cannot map market data segment " + name);
+    }
+
+    // The segment starts zeroed: no updates and every stamp 0
+    unsigned char* bytes = static_cast<unsigned char*>(base);
+    m_header             = reinterpret_cast<Header*>(bytes);
+    m_table              = reinterpret_cast<TopSlot*>(bytes + sizeof(Header));
+    m_log                = reinterpret_cast<LogEntry*>(bytes + sizeof(Header) + symbol_count * sizeof(TopSlot));
+
+    m_header->version      = kVersion;
+    m_header->symbol_count = std::uint32_t(symbol_count);
+    m_header->log_capacity = log_capacity;
+    m_header->next_sequence.store(1, std::memory_order_relaxed);
+    // Readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(m_header->magic, kMagic, sizeof(kMagic));
+}
+
+MarketDataPublisher::~MarketDataPublisher()
+{
+    ::munmap(m_header, m_size);
+    // Leave a segment that replaced this one to its publisher
+    int fd = ::shm_open(m_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return;
+    }
+    struct stat status;
+    bool        own = ::fstat(fd, &status) == 0 && status.st_dev == m_device && status.st_ino == m_inode;
+    ::close(fd);
+    if (own)
+    {
+        ::shm_unlink(m_name.c_str());
+    }
+}
+
+void MarketDataPublisher::PublishBest(SymbolId symbol, Price bid, Volume bid_volume, Price ask, Volume ask_volume)
+{
+    MarketDataUpdate update{};
+    update.symbol     = symbol;
+    update.type       = MarketDataUpdate::Type::BestPrice;
+    update.price      = bid;
+    update.volume     = bid_volume;
+    update.ask_price  = ask;
+    update.ask_volume = ask_volume;
+
+    std::uint64_t sequence = Log(update);
+    if (symbol < m_header->symbol_count)
+    {
+        Store(m_table[symbol].update, sequence, update);
+    }
+}
+
+void MarketDataPublisher::PublishDepth(SymbolId symbol, Side side, DepthUpdate::Action action, Price price, Volume volume)
+{
+    MarketDataUpdate update{};
+    update.symbol = symbol;
+    update.type   = MarketDataUpdate::Type::Depth;
+    update.side   = std::uint8_t(side);
+    update.action = action;
+    update.price  = price;
+    update.volume = volume;
+    Log(update);
+}
+
+std::uint64_t MarketDataPublisher::Log(const MarketDataUpdate& update)
+{
+    // Only this thread writes next_sequence
+    std::uint64_t sequence = m_header->next_sequence.load(std::memory_order_relaxed);
+    Store(m_log[sequence & m_mask].update, sequence, update);
+    m_header->next_sequence.store(sequence + 1, std::memory_order_release);
+    return sequence;
+}
+
+MarketDataSubscriber::MarketDataSubscriber(const std::string& name)
+    : m_size(0), m_header(nullptr), m_table(nullptr), m_log(nullptr), m_mask(0), m_next(0)
+{
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error("cannot open market data segment " + name);
+    }
+    struct stat status;
+    void*       base = MAP_FAILED;
+    if (::fstat(fd, &status) == 0 && std::size_t(status.st_size) >= sizeof(Header))
+    {
+        m_size = std::size_t(status.st_size);
+        base   = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+        throw std::runtime_error("cannot map market data segment " + name);
+    }
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(base);
+    m_header                   = reinterpret_cast<const Header*>(bytes);
+    if (std::memcmp(m_header->magic, kMagic, sizeof(kMagic)) != 0 || m_header->version != kVersion
+        || SegmentSize(m_header->symbol_count, m_header->log_capacity) != m_size)
+    {
+        ::munmap(base, m_size);
+        throw std::runtime_error("not a market data segment " + name);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    m_table = reinterpret_cast<const TopSlot*>(bytes + sizeof(Header));
+    m_log   = reinterpret_cast<const LogEntry*>(bytes + sizeof(Header) + m_header->symbol_count * sizeof(TopSlot));
+    m_mask  = m_header->log_capacity - 1;
+    Resync();
+}
+
+MarketDataSubscriber::~MarketDataSubscriber()
+{
+    ::munmap(const_cast<Header*>(m_header), m_size);
+}
+
+bool MarketDataSubscriber::ReadTopOfBook(SymbolId symbol, TopOfBook& top) const
+{
+    if (symbol >= m_header->symbol_count)
+    {
+        return false;
+    }
+
+    MarketDataUpdate update;
+    std::uint64_t    stamp = Load(m_table[symbol].update, update);
+    if (stamp & 1)
+    {
+        return false;
+    }
+    if (stamp == 0)
+    {
+        top = TopOfBook{0, 0, 0, 0, 0};
+        return true;
+    }
+    top = TopOfBook{update.price, update.volume, update.ask_price, update.ask_volume, stamp / 2};
+    return true;
+}
+
+MarketDataSubscriber::Status MarketDataSubscriber::Next(MarketDataUpdate& update)
+{
+    if (m_header->next_sequence.load(std::memory_order_acquire) <= m_next)
+    {
+        return Status::Empty;
+    }
+
+    // The entry holds m_next or, if the writer lapped us, a later update
+    std::uint64_t stamp = Load(m_log[m_next & m_mask].update, update);
+    if (stamp != Written(m_next))
+    {
+        return Status::Overrun;
+    }
+    ++m_next;
+    return Status::Ok;
+}
+
+void MarketDataSubscriber::Resync()
+{
+    m_next = m_header->next_sequence.load(std::memory_order_acquire);
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "DepthFeed.h"
+#include "IExchange.h"
+#include "SymbolTable.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <sys/types.h>
+
+// Market data shared with any number of local processes through one POSIX
+// shared memory segment written by the exchange alone. The segment holds a
+// latest-value table with the top of book of every symbol and a sequenced
+// log of best price and depth updates. Both are seqlocks: readers never
+// write to the segment, so the exchange neither knows nor waits for them,
+// and a reader that falls a whole log behind sees an overrun.
+
+// One best price or depth change, 24 bytes so that it moves as three words
+struct MarketDataUpdate
+{
+    enum class Type : std::uint8_t
+    {
+        BestPrice = 1,
+        Depth     = 2
+    };
+
+    SymbolId symbol;
+    Type     type;
+    // Depth only
+    std::uint8_t        side;
+    DepthUpdate::Action action;
+    std::uint8_t        reserved;
+    // Best bid for BestPrice, the level for Depth
+    Price  price;
+    Volume volume;
+    // Best ask for BestPrice
+    Price  ask_price;
+    Volume ask_volume;
+};
+
+static_assert(sizeof(MarketDataUpdate) == 24, "market data updates are three words");
+
+// Latest best prices of a symbol
+struct TopOfBook
+{
+    Price  bid;
+    Volume bid_volume;
+    Price  ask;
+    Volume ask_volume;
+    // Log sequence of the update that set it, 0 if none yet
+    std::uint64_t sequence;
+};
+
+namespace market_data {
+
+constexpr char          kMagic[8] = {'T', 'X', 'M', 'D', 'A', 'T', 'A', '1'};
+constexpr std::uint32_t kVersion  = 1;
+
+// Readers retry or give up while the stamp is odd, see Publisher
+struct Words
+{
+    std::atomic<std::uint64_t> stamp;
+    std::atomic<std::uint64_t> words[3];
+};
+
+// The stamp of a slot is that of the last update logged for the symbol
+struct alignas(64) TopSlot
+{
+    Words update;
+};
+
+struct LogEntry
+{
+    Words update;
+};
+
+struct alignas(64) Header
+{
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t symbol_count;
+    std::uint64_t log_capacity;
+    // Sequence the next logged update gets, the first is 1
+    alignas(64) std::atomic<std::uint64_t> next_sequence;
+};
+
+// The table follows the header, the log follows the table
+inline std::size_t SegmentSize(std::size_t symbol_count, std::size_t log_capacity)
+{
+    return sizeof(Header) + symbol_count * sizeof(TopSlot) + log_capacity * sizeof(LogEntry);
+}
+
+}  // namespace market_data
+
+// Writer side, owned by the exchange. Creates the segment under name (as
+// for shm_open, e.g. "/exchange_md") and unlinks it when destroyed, unless
+// another publisher replaced it by then; readers that still map it keep
+// working.
+class MarketDataPublisher
+{
+  public:
+    // log_capacity is rounded up to a power of two. A segment already under
+    // name is unlinked first with replace: its readers keep their mapping but
+    // see no more updates. Throws std::runtime_error if the segment cannot be
+    // created, or exists and replace is false.
+    MarketDataPublisher(const std::string& name, std::size_t symbol_count, std::size_t log_capacity, bool replace);
+    ~MarketDataPublisher();
+
+    MarketDataPublisher(const MarketDataPublisher&) = delete;
+    MarketDataPublisher& operator=(const MarketDataPublisher&) = delete;
+
+    // Update the table entry of the symbol and log the change
+    void PublishBest(SymbolId symbol, Price bid, Volume bid_volume, Price ask, Volume ask_volume);
+    // Log a depth change
+    void PublishDepth(SymbolId symbol, Side side, DepthUpdate::Action action, Price price, Volume volume);
+
+    std::size_t SymbolCount() const { return m_header->symbol_count; }
+
+  private:
+    std::uint64_t Log(const MarketDataUpdate& update);
+
+    std::string m_name;
+    // Identify the segment, the name may point at another one by the end
+    dev_t                  m_device;
+    ino_t                  m_inode;
+    std::size_t            m_size;
+    market_data::Header*   m_header;
+    market_data::TopSlot*  m_table;
+    market_data::LogEntry* m_log;
+    std::uint64_t          m_mask;
+};
+
+// Reader side, any number per segment and process. Wait-free: a read that
+// overlaps a write fails rather than waiting for it.
+class MarketDataSubscriber
+{
+  public:
+    enum class Status
+    {
+        // An update was read
+        Ok,
+        // No update past the last one read yet
+        Empty,
+        // The log wrapped past the next update, see Resync
+        Overrun
+    };
+
+    // Starts at the next update published. Throws std::runtime_error if the
+    // segment does not exist or is not a market data segment.
+    explicit MarketDataSubscriber(const std::string& name);
+    ~MarketDataSubscriber();
+
+    MarketDataSubscriber(const MarketDataSubscriber&) = delete;
+    MarketDataSubscriber& operator=(const MarketDataSubscriber&) = delete;
+
+    // Latest top of book of symbol, false if it was being written (try again)
+    // or the symbol is not in the table
+    bool ReadTopOfBook(SymbolId symbol, TopOfBook& top) const;
+
+    // Next logged update in sequence
+    Status Next(MarketDataUpdate& update);
+    // Skip to the next update published, after an overrun. Rebuild state
+    // from ReadTopOfBook; updates with a sequence above a symbol's
+    // TopOfBook::sequence apply on top of it.
+    void Resync();
+
+    // Sequence of the update Next returns next
+    std::uint64_t NextSequence() const { return m_next; }
+    std::size_t   SymbolCount() const { return m_header->symbol_count; }
+
+  private:
+    std::size_t                  m_size;
+    const market_data::Header*   m_header;
+    const market_data::TopSlot*  m_table;
+    const market_data::LogEntry* m_log;
+    std::uint64_t                m_mask;
+    std::uint64_t                m_next;
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "ExchangeListener.h"
+#include "IExchange.h"
+#include "LatencyHistogram.h"
+#include "Tsc.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Exchange instrumentation is built in unless compiled with
+// -DEXCHANGE_METRICS=0, which removes every counter, timer and the
+// MyExchange::Metrics accessor.
+#ifndef EXCHANGE_METRICS
+#define EXCHANGE_METRICS 1
+#endif
+
+#if EXCHANGE_METRICS
+#define EXCHANGE_METRIC(statement) statement
+#else
+#define EXCHANGE_METRIC(statement)
+#endif
+
+// Value written by a single thread and read by any. Updates are a relaxed
+// load and store, so they cost what a plain add does, and readers never see
+// a torn value.
+class MetricCounter
+{
+  public:
+    void          Add(std::uint64_t n = 1) { Set(Load() + n); }
+    void          Sub(std::uint64_t n = 1) { Set(Load() - n); }
+    void          Set(std::uint64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    std::uint64_t Load() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<std::uint64_t> m_value{0};
+};
+
+// LatencyHistogram of TSC ticks that can be read while it is recorded into
+class MetricHistogram
+{
+  public:
+    void Record(std::uint64_t ticks)
+    {
+        m_counts[LatencyHistogram::BucketOf(ticks)].Add();
+        m_sum.Add(ticks);
+        if (ticks > m_max.Load())
+        {
+            m_max.Set(ticks);
+        }
+    }
+
+    // Buckets are copied one by one, so the copy may be a few samples off
+    void CopyTo(LatencyHistogram& histogram) const
+    {
+        histogram.Reset();
+        for (std::size_t i = 0; i < LatencyHistogram::kBuckets; ++i)
+        {
+            histogram.AddBucket(i, m_counts[i].Load());
+        }
+        histogram.AddTotals(m_sum.Load(), m_max.Load());
+    }
+
+  private:
+    MetricCounter m_counts[LatencyHistogram::kBuckets];
+    MetricCounter m_sum;
+    MetricCounter m_max;
+};
+
+// Records the ticks between construction and destruction
+class MetricTimer
+{
+  public:
+    explicit MetricTimer(MetricHistogram& histogram) : m_histogram(histogram), m_start(ReadTsc()) {}
+    ~MetricTimer() { m_histogram.Record(ReadTsc() - m_start); }
+
+    MetricTimer(const MetricTimer&) = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+  private:
+    MetricHistogram& m_histogram;
+    std::uint64_t    m_start;
+};
+
+constexpr std::size_t kInsertResults = std::size_t(InsertError::SystemError) + 1;
+constexpr std::size_t kDeleteResults = std::size_t(DeleteError::SystemError) + 1;
+constexpr std::size_t kAmendResults  = std::size_t(AmendError::SymbolHalted) + 1;
+constexpr std::size_t kRiskResults   = std::size_t(RiskError::PriceBand) + 1;
+
+// Gauges of one book
+struct BookGauges
+{
+    std::uint64_t orders;
+    std::uint64_t bid_levels;
+    std::uint64_t ask_levels;
+    // Order records and price levels, tree nodes not included
+    std::uint64_t memory_bytes;
+};
+
+// Plain copy of ExchangeMetrics, see ExchangeMetrics::Snapshot
+struct MetricsSnapshot
+{
+    // Indexed by the InsertError, DeleteError and AmendError answered
+    std::uint64_t insert_results[kInsertResults];
+    std::uint64_t delete_results[kDeleteResults];
+    std::uint64_t amend_results[kAmendResults];
+    // Inserts rejected by the risk gate, indexed by RiskError
+    std::uint64_t risk_rejects[kRiskResults];
+    std::uint64_t cancelled;
+    std::uint64_t trades;
+    std::uint64_t level_creates;
+    std::uint64_t level_erases;
+    // Bytes reserved by the order arena
+    std::uint64_t pool_bytes;
+
+    // TSC ticks, see TscTicksPerNanosecond. Callbacks of MyExchange are timed
+    // on their own and as part of the insert or delete that fired them;
+    // listeners of other BasicExchanges are not timed.
+    LatencyHistogram insert_ticks;
+    LatencyHistogram delete_ticks;
+    LatencyHistogram callback_ticks;
+
+    // Indexed by SymbolId
+    std::vector<BookGauges> books;
+};
+
+// Instrumentation of one exchange, written only by the thread running it and
+// so private to that thread. Any other thread may take a Snapshot at any
+// time without locking or stalling the writer.
+class ExchangeMetrics
+{
+  public:
+    struct Book
+    {
+        MetricCounter orders;
+        MetricCounter levels[2];
+    };
+
+    ExchangeMetrics(std::size_t order_bytes, std::size_t level_bytes)
+        : m_order_bytes(order_bytes), m_level_bytes(level_bytes), m_books(0)
+    {
+    }
+
+    MetricCounter   insert_results[kInsertResults];
+    MetricCounter   delete_results[kDeleteResults];
+    MetricCounter   amend_results[kAmendResults];
+    MetricCounter   risk_rejects[kRiskResults];
+    MetricCounter   cancelled;
+    MetricCounter   trades;
+    MetricCounter   level_creates;
+    MetricCounter   level_erases;
+    MetricCounter   pool_bytes;
+    MetricHistogram insert_ticks;
+    MetricHistogram delete_ticks;
+    MetricHistogram callback_ticks;
+
+    // Writer only. Books live in chunks that never move, so readers can
+    // index them while symbols are added.
+    void AddBook()
+    {
+        std::size_t books = m_books.load(std::memory_order_relaxed);
+        if (books == kMaxChunks * kChunkBooks)
+        {
+            return;
+        }
+        if (books % kChunkBooks == 0)
+        {
+            m_chunks[books / kChunkBooks].reset(new Book[kChunkBooks]);
+        }
+        m_books.store(books + 1, std::memory_order_release);
+    }
+
+    // Books past the supported count share one untracked slot
+    Book& BookAt(std::size_t symbol)
+    {
+        if (symbol >= m_books.load(std::memory_order_relaxed))
+        {
+            return m_overflow;
+        }
+        return m_chunks[symbol / kChunkBooks][symbol % kChunkBooks];
+    }
+
+    // Safe from any thread. Every value is read atomically, but the values
+    // are not taken at one single instant.
+    void Snapshot(MetricsSnapshot& snapshot) const
+    {
+        Load(insert_results, snapshot.insert_results, kInsertResults);
+        Load(delete_results, snapshot.delete_results, kDeleteResults);
+        Load(amend_results, snapshot.amend_results, kAmendResults);
+        Load(risk_rejects, snapshot.risk_rejects, kRiskResults);
+        snapshot.cancelled     = cancelled.Load();
+        snapshot.trades        = trades.Load();
+        snapshot.level_creates = level_creates.Load();
+        snapshot.level_erases  = level_erases.Load();
+        snapshot.pool_bytes    = pool_bytes.Load();
+        insert_ticks.CopyTo(snapshot.insert_ticks);
+        delete_ticks.CopyTo(snapshot.delete_ticks);
+        callback_ticks.CopyTo(snapshot.callback_ticks);
+
+        std::size_t books = m_books.load(std::memory_order_acquire);
+        snapshot.books.resize(books);
+        for (std::size_t i = 0; i < books; ++i)
+        {
+            const Book& book  = m_chunks[i / kChunkBooks][i % kChunkBooks];
+            BookGauges& gauge = snapshot.books[i];
+            gauge.orders      = book.orders.Load();
+            gauge.bid_levels  = book.levels[std::size_t(Side::Buy)].Load();
+            gauge.ask_levels  = book.levels[std::size_t(Side::Sell)].Load();
+            gauge.memory_bytes
+                = gauge.orders * m_order_bytes + (gauge.bid_levels + gauge.ask_levels) * m_level_bytes;
+        }
+    }
+
+  private:
+    static constexpr std::size_t kChunkBooks = 256;
+    static constexpr std::size_t kMaxChunks  = 256;
+
+    static void Load(const MetricCounter* counters, std::uint64_t* values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            values[i] = counters[i].Load();
+        }
+    }
+
+    std::size_t              m_order_bytes;
+    std::size_t              m_level_bytes;
+    std::unique_ptr<Book[]>  m_chunks[kMaxChunks];
+    std::atomic<std::size_t> m_books;
+    Book                     m_overflow;
+};
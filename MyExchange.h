@@ -1,66 +1,413 @@
 #pragma once
 
+#include "BookReader.h"
+#include "DepthFeed.h"
+#include "ExchangeListener.h"
 #include "IExchange.h"
+#include "Journal.h"
+#include "MarketData.h"
+#include "Metrics.h"
+#include "ObjectPool.h"
+#include "OrderIdTable.h"
+#include "Placement.h"
+#include "PriceLadder.h"
+#include "RiskGate.h"
+#include "Snapshot.h"
+#include "SymbolTable.h"
+#include "SymbolUniverse.h"
 
-#include <list>
 #include <map>
-#include <set>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
-using Symbol = std::string;
+// Small dense integer naming the client session owning an order
+using SessionId = std::uint32_t;
 
-class MyExchange : public IExchange
+// Orders entered without a session cannot be mass cancelled by session
+constexpr SessionId kNoSession = 0;
+
+// Selects the resting orders removed by MyExchange::MassCancel. Every key
+// that is set must match; an empty filter selects every order.
+struct MassCancelFilter
+{
+    // kInvalidSymbol matches every symbol
+    SymbolId symbol{kInvalidSymbol};
+    // Only orders on side unless both_sides
+    bool both_sides{true};
+    Side side{Side::Buy};
+    // kNoSession matches every session
+    SessionId session{kNoSession};
+
+    static MassCancelFilter Symbol(SymbolId symbol) { return MassCancelFilter{symbol, true, Side::Buy, kNoSession}; }
+    static MassCancelFilter SymbolSide(SymbolId symbol, Side side)
+    {
+        return MassCancelFilter{symbol, false, side, kNoSession};
+    }
+    static MassCancelFilter Session(SessionId session)
+    {
+        return MassCancelFilter{kInvalidSymbol, true, Side::Buy, session};
+    }
+};
+
+// Returned by MyExchange::MassCancel when the journal cannot take the cancel
+constexpr std::size_t kMassCancelFailed = ~std::size_t(0);
+
+// One entry of a ProcessBatch call
+struct OrderCommand
+{
+    enum class Type
+    {
+        Insert,
+        Delete,
+        Amend,
+        MassCancel
+    };
+
+    Type type;
+    // Insert fields, symbol as returned by MyExchange::FindSymbol
+    SymbolId      symbol;
+    Side          side;
+    Price         price;
+    Volume        volume;
+    UserReference userReference;
+    // Delete and Amend field, Amend also uses price and volume
+    OrderId orderId;
+    // Owner of an inserted order, the session a Delete or Amend is made on
+    // behalf of, or the MassCancel session key
+    SessionId session{kNoSession};
+    // MassCancel cancels both sides, otherwise only side
+    bool both_sides{false};
+
+    static OrderCommand Insert(SymbolId      symbol,
+                               Side          side,
+                               Price         price,
+                               Volume        volume,
+                               UserReference userReference,
+                               SessionId     session = kNoSession)
+    {
+        return OrderCommand{Type::Insert, symbol, side, price, volume, userReference, 0, session};
+    }
+    static OrderCommand Delete(OrderId orderId, SessionId session = kNoSession)
+    {
+        return OrderCommand{Type::Delete, kInvalidSymbol, Side::Buy, 0, 0, 0, orderId, session};
+    }
+    static OrderCommand Amend(OrderId orderId, Price price, Volume volume, SessionId session = kNoSession)
+    {
+        return OrderCommand{Type::Amend, kInvalidSymbol, Side::Buy, price, volume, 0, orderId, session};
+    }
+    static OrderCommand MassCancel(const MassCancelFilter& filter)
+    {
+        return OrderCommand{
+            Type::MassCancel, filter.symbol, filter.side, 0, 0, 0, 0, filter.session, filter.both_sides};
+    }
+};
+
+struct ExchangeConfig
+{
+    // Sizing and growth of the resting order arena
+    PoolConfig order_pool;
+    // Number of price slots per book side kept in a contiguous ladder around
+    // the touch, prices outside the window fall back to a tree. 0 disables
+    // ladder mode so that every level lives in the tree.
+    std::size_t ladder_levels{0};
+    // Symbols listed at construction. When empty they are read from
+    // symbol_file (see LoadSymbolUniverse), and when that is empty too AAPL,
+    // MSFT and GOOG are listed with default parameters. The constructor throws
+    // std::invalid_argument for parameters AddSymbol rejects.
+    std::vector<SymbolParams> symbols;
+    std::string               symbol_file;
+    // Match crossing orders against the opposite side in price-time priority.
+    // When disabled every order rests, as the IExchange contract expects.
+    bool matching{false};
+    // Write-ahead journal of accepted inserts and deletes, none when empty.
+    // The journal is fsynced every journal_group_commit records and at the
+    // end of every ProcessBatch call.
+    std::string journal_file;
+    std::size_t journal_group_commit{256};
+    // Capacity of the depth update buffer, 0 disables the depth feed
+    std::size_t depth_capacity{0};
+    // POSIX shared memory segment publishing best prices and depth to local
+    // processes, none when empty, see MarketDataSubscriber. Its table holds
+    // at least market_data_symbols symbols, intraday listings included, and
+    // its log the last market_data_log updates. A segment already under the
+    // name makes the constructor throw std::runtime_error, unless
+    // market_data_replace, e.g. to restart after a crash.
+    std::string market_data_name;
+    std::size_t market_data_symbols{0};
+    std::size_t market_data_log{1 << 16};
+    bool        market_data_replace{false};
+    // Core of the thread driving the exchange and the arena holding the
+    // order pool. With prefault the order id table is also allocated up to
+    // the pool capacity at construction.
+    PlacementConfig placement;
+    // Pre-trade limits checked on every insert and amend, see RiskGate
+    RiskConfig risk;
+    // Levels per side kept for GetDepth, 0 disables GetTopOfBook, GetDepth
+    // and GetOrder. At most reader_threads threads read at once, more wait
+    // for one of them to finish.
+    std::size_t reader_depth{0};
+    std::size_t reader_threads{16};
+};
+
+// Symbols an exchange built from config lists, see ExchangeConfig::symbols
+std::vector<SymbolParams> ListedSymbols(const ExchangeConfig& config);
+
+// The exchange, delivering its events to a Listener: a class with the
+// handlers of NullListener, called directly with plain event structs. The
+// default CallbackListener keeps the std::function callbacks, see MyExchange.
+// Member definitions are in MyExchangeImpl.h.
+template <typename Listener = CallbackListener>
+class BasicExchange : public IExchange
 {
   public:
-    MyExchange();
+    explicit BasicExchange(const ExchangeConfig& config = ExchangeConfig(), Listener listener = Listener());
+    ~BasicExchange();
 
     virtual void InsertOrder(
         const std::string& symbol, Side side, Price price, Volume volume, UserReference userReference) override;
     virtual void DeleteOrder(OrderId orderId) override;
+    // Delete on behalf of session: an order another session owns is
+    // answered with OrderNotFound, as if it did not exist. kNoSession may
+    // delete any order.
+    void DeleteOrder(OrderId orderId, SessionId session);
+
+    // Same as above for a symbol already resolved with FindSymbol, no string
+    // hashing or comparison is done. The order is owned by session, see
+    // MassCancel; sessions are small dense ids like SymbolIds.
+    void InsertOrder(SymbolId      symbol,
+                     Side          side,
+                     Price         price,
+                     Volume        volume,
+                     UserReference userReference,
+                     SessionId     session = kNoSession);
+
+    // Change the price and volume of a resting order, keeping its OrderId.
+    // Reducing the volume at the same price keeps the queue position; a new
+    // price or a larger volume moves the order to the back of the queue at
+    // its new price, matching first when matching is enabled. Answered by
+    // OnOrderAmended before any fill, followed by at most one
+    // OnBestPriceChanged. Made on behalf of session as for DeleteOrder.
+    // While the symbol is halted only the volume may be reduced, at the same
+    // price; anything else is answered with SymbolHalted.
+    void AmendOrder(OrderId orderId, Price price, Volume volume, SessionId session = kNoSession);
+
+    using OrderAmendedFunction = std::function<void(OrderId, AmendError)>;
+    OrderAmendedFunction OnOrderAmended;
+
+    // Remove every resting order selected by filter. Whole books or sides
+    // are torn down level by level and sessions are walked through their own
+    // order chains, so no order id is looked up. The removed ids are
+    // reported by one OnOrdersCancelled call instead of OnOrderDeleted, then
+    // each affected book reports its best price once. Returns the number of
+    // orders cancelled, or kMassCancelFailed if the cancel could not be
+    // journaled and no order was touched.
+    std::size_t MassCancel(const MassCancelFilter& filter);
+
+    using OrdersCancelledFunction = std::function<void(const OrderId* orderIds, std::size_t count)>;
+    OrdersCancelledFunction OnOrdersCancelled;
+
+    // Charge the orders session enters from now on to account, see
+    // ExchangeConfig::risk. Bind before LoadSnapshot and Replay so that the
+    // restored orders are charged too. False if the account does not exist.
+    bool BindSession(SessionId session, AccountId account);
+    bool SetAccountLimits(AccountId account, const RiskLimits& limits) { return m_risk.SetLimits(account, limits); }
+    // Limits and exposure of every account
+    const RiskGate& Risk() const { return m_risk; }
+
+    // Fired instead of OnOrderInserted when the risk gate rejects an insert.
+    // Without it the insert is answered by OnOrderInserted with SystemError.
+    using OrderRejectedFunction = std::function<void(UserReference, RiskError)>;
+    OrderRejectedFunction OnOrderRejected;
+
+    // Returns kInvalidSymbol if the symbol is not traded on this exchange
+    SymbolId FindSymbol(const std::string& symbol) const { return m_symbols.Find(symbol); }
+    const Symbol& SymbolName(SymbolId symbol) const { return m_symbols.Name(symbol); }
+
+    // List a symbol and create its book, or update the parameters of an
+    // already listed one. Other books are not touched. Returns kInvalidSymbol,
+    // changing nothing, unless tick_size > 0 and 0 < min_price <= max_price,
+    // if a new symbol has no place in the market data table (see
+    // ExchangeConfig::market_data_symbols) or if the journal cannot be
+    // written. expected_depth is not journaled.
+    SymbolId AddSymbol(const SymbolParams& params);
+
+    // A halted symbol rejects new orders with SymbolNotFound, resting orders
+    // stay on the book and can still be deleted. Return false for unknown
+    // symbols or if the journal cannot be written.
+    bool HaltSymbol(const std::string& symbol);
+    bool ResumeSymbol(const std::string& symbol);
+
+    // Process count commands in order. OnOrderInserted, OnOrderDeleted,
+    // OnOrderAmended and OnTrade fire per command in submission order, while
+    // OnBestPriceChanged fires at most once per touched symbol, with its final
+    // state, after the last command.
+    void ProcessBatch(const OrderCommand* commands, std::size_t count);
+
+    // Rebuild the books from the records found in the journal when it was
+    // opened, before any new order is entered. After LoadSnapshot only the
+    // records following the snapshot are replayed. AddSymbol, HaltSymbol and
+    // ResumeSymbol are replayed among the orders. Every callback fires as it
+    // did in the original run and order ids are issued in the same sequence.
+    // Throws std::runtime_error if the journal was written by an exchange
+    // listing other symbols or parameters. Returns the records replayed.
+    std::size_t Replay();
+
+    // Write every book, each price level queue in FIFO order and the next
+    // order id to a binary image (see Snapshot.h). The image goes to path.tmp
+    // and is renamed over path once complete. Returns false on I/O errors or
+    // symbol names longer than 31 characters.
+    bool SaveSnapshot(const std::string& path);
+
+    // SaveSnapshot from a forked copy-on-write image of the process, so order
+    // entry only stalls for the fork itself. Returns false if a snapshot is
+    // still running or the fork fails.
+    bool StartSnapshot(const std::string& path);
+    // Wait for the snapshot started last, true if it was written
+    bool WaitSnapshot();
+
+    // Restore a snapshot into an exchange holding no orders yet, without
+    // firing callbacks. The image is mapped and orders are taken from the
+    // arena, reserved once for all of them. Symbols are listed in snapshot
+    // order, so the exchange must list the same symbols first or none.
+    // Throws std::runtime_error if the image is invalid or does not fit.
+    void LoadSnapshot(const std::string& path);
+
+    // Flush journal records not yet covered by a group commit
+    void SyncJournal();
+
+    // Per-level depth updates published by InsertOrder, DeleteOrder and
+    // ProcessBatch, in the order the levels changed. Read and Clear them
+    // between calls into the exchange.
+    DepthPublisher& Depth() { return m_depth; }
+
+    // Publish a Clear for the symbol followed by an Add for each of its
+    // levels. Returns false, publishing nothing, if the symbol is unknown or
+    // the depth buffer has no room for the whole book.
+    bool RequestDepthSnapshot(SymbolId symbol);
+
+    // Copies of the books safe to take from any thread while another one
+    // drives the exchange, see BookReader. They show the books as every
+    // request, or batch, left them once it returned: its orders, depth and
+    // best prices are published together at its end. Reads made between two
+    // equal even ReaderVersions saw the same publication. False for unknown
+    // symbols and orders that do not rest, and without reader_depth.
+    bool GetTopOfBook(SymbolId symbol, TopView& top) const { return m_reader && m_reader->GetTopOfBook(symbol, top); }
+    bool GetDepth(SymbolId symbol, std::size_t levels, DepthView& depth) const
+    {
+        return m_reader && m_reader->GetDepth(symbol, levels, depth);
+    }
+    bool GetOrder(OrderId orderId, OrderView& order) const { return m_reader && m_reader->GetOrder(orderId, order); }
+    std::uint64_t ReaderVersion() const { return m_reader ? m_reader->Version() : 0; }
+
+    // Fired once per fill when matching is enabled, at the price of the resting
+    // order. Fills of one incoming order are reported after its OnOrderInserted
+    // and before its OnBestPriceChanged.
+    using TradeFunction = std::function<void(
+        const std::string& symbol, OrderId aggressorId, OrderId restingId, Price price, Volume volume)>;
+    TradeFunction OnTrade;
+
+    Listener& EventListener() { return m_listener; }
+
+    // Arena backing the order pool, nullptr without ExchangeConfig::placement
+    const MemoryArena* Arena() const { return m_arena.get(); }
+
+#if EXCHANGE_METRICS
+    // Counters, latencies and per-book gauges, see ExchangeMetrics::Snapshot
+    const ExchangeMetrics& Metrics() const { return m_metrics; }
+#endif
 
   private:
     struct OrderInfo;
     struct PriceLevel;
     struct OrderBook;
 
-    using OrderIdToInfoMap = std::map<OrderId, OrderInfo>;
-    using OrderBookMap     = std::map<Symbol, OrderBook>;
-    using OrderIterList    = std::list<OrderIdToInfoMap::iterator>;
+    // Handle of an order record in the order pool
+    using OrderHandle = PoolHandle;
 
+    // Fixed-size order record living in the order pool
     struct OrderInfo
     {
-        Symbol        symbol;
+        OrderId       order_id;
         Side          side;
         Price         price;
         Volume        vol;
         UserReference userReference;
 
-        // pos of order book for this order
-        OrderBookMap::iterator book_pos;
-        // pos of price level in order book for this order
-        std::map<Price, PriceLevel>::iterator price_pos;
-        // position of order in OrderList of price level of this order
-        OrderIterList::iterator order_pos;
+        // symbol and so order book of this order
+        SymbolId symbol;
+        // price level in order book for this order
+        PriceLevel* level;
 
-        OrderInfo(Symbol symbol, Side side, Price price, Volume vol, UserReference userReference)
-            : symbol(symbol), side(side), price(price), vol(vol), userReference(userReference)
-        {
-        }
+        // Intrusive links of the FIFO queue at the price level of this order
+        OrderHandle prev;
+        OrderHandle next;
+
+        // Owning session and the intrusive links of its order chain
+        SessionId   session;
+        OrderHandle session_prev;
+        OrderHandle session_next;
+        // Account charged for the order by the risk gate
+        AccountId account;
     };
 
     struct PriceLevel
     {
+        Price price{0};
         // Total volume at current price level
         Volume total_vol{0};
-        // List containing the iterators to order info
-        OrderIterList order_list;
+        // Oldest and newest order resting at current price level
+        OrderHandle head{kNullHandle};
+        OrderHandle tail{kNullHandle};
+    };
+
+    // Price levels of one side of a book ordered best first by Compare. Levels
+    // inside the ladder window are array slots, the rest live in the tree.
+    template <typename Compare>
+    class BookSide
+    {
+      public:
+        explicit BookSide(std::size_t ladder_levels) : m_ladder(ladder_levels) {}
+
+        // Find the level for price, creating an empty one if needed
+        PriceLevel& Acquire(Price price, ObjectPool<OrderInfo>& orders);
+        // Erase a level that has no orders left
+        void Release(PriceLevel& level, ObjectPool<OrderInfo>& orders);
+        // Best level, nullptr if the side is empty
+        PriceLevel* Best();
+        // Call function on every level, in no particular order
+        template <typename Function>
+        void ForEachLevel(Function function) const;
+        // Call function on levels best first until it returns false
+        template <typename Function>
+        void ForEachBest(Function function) const;
+        // Erase every level at once
+        void Clear();
+
+      private:
+        // Move the empty ladder window around price and pull in the tree
+        // levels that now fall inside it
+        void Recenter(Price price, ObjectPool<OrderInfo>& orders);
+
+        PriceLadder<PriceLevel>              m_ladder;
+        std::map<Price, PriceLevel, Compare> m_tree;
     };
 
     struct OrderBook
     {
+        OrderBook(const SymbolParams& params, std::size_t ladder_levels)
+            : ask_price_level(ladder_levels),
+              bid_price_level(ladder_levels),
+              tick_size(params.tick_size),
+              min_price(params.min_price),
+              max_price(params.max_price)
+        {
+        }
+
         // Ask Price levels
-        std::map<Price, PriceLevel> ask_price_level;
+        BookSide<std::less<Price>> ask_price_level;
         // Bid Price Levels
-        std::map<Price, PriceLevel, std::greater<Price>> bid_price_level;
+        BookSide<std::greater<Price>> bid_price_level;
 
         // Best bid price and total volume for that price level
         Price  best_bid_price{0};
@@ -69,18 +416,436 @@ class MyExchange : public IExchange
         // Best ask price and total volume for that price level
         Price  best_ask_price{0};
         Volume best_ask_total_vol{0};
+
+        // Symbol parameters checked on insert
+        Price tick_size;
+        Price min_price;
+        Price max_price;
+        bool  halted{false};
+
+        // Best price changed during the current batch
+        bool dirty{false};
+        // Lost orders in the current mass cancel
+        bool touched{false};
+        // Changed since it was last published to readers
+        bool reader_dirty{false};
+    };
+
+    struct AskPolicy;
+
+    // Compile-time description of one side of a book: how its levels are
+    // ordered, where they and the cached best price live, and which side it
+    // matches against. The buy and sell paths are instantiated from it
+    // instead of branching on Side.
+    struct BidPolicy
+    {
+        using Compare               = std::greater<Price>;
+        using Opposite              = AskPolicy;
+        static constexpr Side kSide = Side::Buy;
+
+        static BookSide<Compare>& Levels(OrderBook& order_book) { return order_book.bid_price_level; }
+        // Cache level as the best bid, nullptr for an empty side
+        static void SetBest(OrderBook& order_book, const PriceLevel* level)
+        {
+            order_book.best_bid_price     = level ? level->price : 0;
+            order_book.best_bid_total_vol = level ? level->total_vol : 0;
+        }
     };
 
-    // OrderId to Order Info map
-    OrderIdToInfoMap m_orderid_to_info;
+    struct AskPolicy
+    {
+        using Compare               = std::less<Price>;
+        using Opposite              = BidPolicy;
+        static constexpr Side kSide = Side::Sell;
+
+        static BookSide<Compare>& Levels(OrderBook& order_book) { return order_book.ask_price_level; }
+        // Cache level as the best ask, nullptr for an empty side
+        static void SetBest(OrderBook& order_book, const PriceLevel* level)
+        {
+            order_book.best_ask_price     = level ? level->price : 0;
+            order_book.best_ask_total_vol = level ? level->total_vol : 0;
+        }
+    };
+
+    // Journal record ahead of the change it describes, false if the journal
+    // cannot take it. While replaying the record is checked against the
+    // journal instead.
+    bool WriteAhead(JournalRecord record);
+
+    // List or update a symbol without journaling it, see AddSymbol
+    SymbolId ListSymbol(const SymbolParams& params);
+    // Journal and apply a halt or resume, false for unknown symbols
+    bool SetHalted(SymbolId symbol, bool halted);
+
+    // Serialize the books to fd, see SaveSnapshot
+    bool WriteSnapshot(int fd) const;
+    // Rebuild the books from a mapped snapshot image
+    void LoadSnapshotImage(const unsigned char* image, std::size_t size);
+
+    // Run one command, see ProcessBatch
+    void Execute(const OrderCommand& command);
+
+    // Price the risk band of an order on side is centred on: the opposite
+    // best price, or the own side's when the opposite side is empty
+    static Price Touch(const OrderBook& order_book, Side side)
+    {
+        Price opposite = side == Side::Buy ? order_book.best_ask_price : order_book.best_bid_price;
+        Price own      = side == Side::Buy ? order_book.best_bid_price : order_book.best_ask_price;
+        return opposite != 0 ? opposite : own;
+    }
+
+    static std::uint64_t Notional(const OrderInfo& order) { return std::uint64_t(order.price) * order.vol; }
+
+    // A request on behalf of session may touch the order
+    bool MayTouch(SessionId session, OrderHandle handle) const
+    {
+        return session == kNoSession || m_orders[handle].session == session;
+    }
 
-    // Symbol to OrderBook Map
-    std::map<Symbol, OrderBook> m_order_book;
+    // Risk of moving a resting order to price and volume
+    RiskError CheckAmendRisk(const OrderInfo& order, Price price, Volume volume) const
+    {
+        return m_risk.CheckAmend(order.account,
+                                 order.symbol,
+                                 Notional(order),
+                                 price,
+                                 volume,
+                                 Touch(m_order_book[order.symbol], order.side));
+    }
 
-    // Set of supported symbols ( currently filled in constructor)
-    std::set<Symbol> m_symbol_list;
+    AccountId AccountOf(SessionId session) const
+    {
+        return session < m_session_accounts.size() ? m_session_accounts[session] : 0;
+    }
+
+    // Parameters a book can be listed with, ValidPrice divides by the tick
+    // size. A new book also needs a slot in the market data table, or its
+    // readers would never see it.
+    bool CanList(const SymbolParams& params) const
+    {
+        return params.tick_size > 0 && params.min_price > 0 && params.min_price <= params.max_price
+               && (!m_market_data || m_symbols.Find(params.symbol) < m_market_data->SymbolCount()
+                   || m_symbols.Size() < m_market_data->SymbolCount());
+    }
+
+    // Check price against the tick size and band of the book
+    static bool ValidPrice(const OrderBook& order_book, Price price)
+    {
+        return price > 0 && price >= order_book.min_price && price <= order_book.max_price
+               && price % order_book.tick_size == 0;
+    }
+
+    // The order pool config with its chunks taken from arena, if any
+    static PoolConfig OrderPoolConfig(PoolConfig config, MemoryArena* arena)
+    {
+        config.arena = arena;
+        return config;
+    }
+
+    // Reload the cached best prices of the book, true if any of them changed
+    bool RefreshBestPrices(OrderBook& order_book);
+
+    // Publish a change of the volume at level to the depth feeds
+    void DepthChanged(DepthUpdate::Action action, SymbolId symbol, Side side, const PriceLevel& level)
+    {
+        EXCHANGE_METRIC(CountLevel(action, symbol, side));
+        if (m_depth.Enabled())
+        {
+            m_depth.Publish(action, symbol, side, level.price, level.total_vol);
+        }
+        if (m_market_data)
+        {
+            m_market_data->PublishDepth(symbol, side, action, level.price, level.total_vol);
+        }
+        MarkForReaders(symbol);
+    }
+
+    // The book is published to readers once the request or batch is done
+    void MarkForReaders(SymbolId symbol)
+    {
+        if (m_reader && !m_order_book[symbol].reader_dirty)
+        {
+            m_order_book[symbol].reader_dirty = true;
+            m_reader_books.push_back(symbol);
+        }
+    }
+    // Publish the books and orders marked since the last time
+    void PublishToReaders();
+    // A resting order entered, changed or gone, published with the books.
+    // Each of these changes a level too, which marks the book.
+    void PublishOrder(const OrderInfo& order)
+    {
+        if (m_reader)
+        {
+            m_reader_orders.push_back(order.order_id);
+        }
+    }
+
+    // Publishes what a request changed to readers as it returns, unless the
+    // request is part of a batch
+    struct ReaderScope
+    {
+        explicit ReaderScope(BasicExchange& exchange) : exchange(exchange) {}
+        ~ReaderScope()
+        {
+            if (!exchange.m_in_batch && !exchange.m_reader_books.empty())
+            {
+                exchange.PublishToReaders();
+            }
+        }
+
+        BasicExchange& exchange;
+    };
+
+#if EXCHANGE_METRICS
+    // Count a level created or erased by a depth change
+    void CountLevel(DepthUpdate::Action action, SymbolId symbol, Side side)
+    {
+        if (action == DepthUpdate::Action::Add)
+        {
+            m_metrics.level_creates.Add();
+            m_metrics.BookAt(symbol).levels[std::size_t(side)].Add();
+        }
+        else if (action == DepthUpdate::Action::Delete)
+        {
+            m_metrics.level_erases.Add();
+            m_metrics.BookAt(symbol).levels[std::size_t(side)].Sub();
+        }
+    }
+#endif
+
+    // Report the best price of the book, deferred to the end of a batch
+    void BestPriceChanged(SymbolId symbol);
+
+    // Deliver an event to the listener, or to the callbacks for CallbackListener.
+    // Only std::function callbacks are timed: other listeners are usually
+    // inlined, and two TSC reads per event would cost more than they do.
+    static constexpr bool kCallbacks = std::is_same<Listener, CallbackListener>::value;
+
+    void Emit(const OrderInsertedEvent& event)
+    {
+        EXCHANGE_METRIC(m_metrics.insert_results[std::size_t(event.error)].Add());
+        EXCHANGE_METRIC(if (event.risk != RiskError::OK) m_metrics.risk_rejects[std::size_t(event.risk)].Add());
+        if constexpr (kCallbacks)
+        {
+            if (event.risk != RiskError::OK && OnOrderRejected)
+            {
+                EXCHANGE_METRIC(MetricTimer timer(m_metrics.callback_ticks));
+                OnOrderRejected(event.userReference, event.risk);
+            }
+            else if (IExchange::OnOrderInserted)
+            {
+                EXCHANGE_METRIC(MetricTimer timer(m_metrics.callback_ticks));
+                IExchange::OnOrderInserted(event.userReference, event.error, event.orderId);
+            }
+        }
+        else
+        {
+            m_listener.OnOrderInserted(event);
+        }
+    }
+
+    void Emit(const OrderDeletedEvent& event)
+    {
+        EXCHANGE_METRIC(m_metrics.delete_results[std::size_t(event.error)].Add());
+        if constexpr (kCallbacks)
+        {
+            if (IExchange::OnOrderDeleted)
+            {
+                EXCHANGE_METRIC(MetricTimer timer(m_metrics.callback_ticks));
+                IExchange::OnOrderDeleted(event.orderId, event.error);
+            }
+        }
+        else
+        {
+            m_listener.OnOrderDeleted(event);
+        }
+    }
+
+    void Emit(const OrderAmendedEvent& event)
+    {
+        EXCHANGE_METRIC(m_metrics.amend_results[std::size_t(event.error)].Add());
+        if constexpr (kCallbacks)
+        {
+            if (OnOrderAmended)
+            {
+                EXCHANGE_METRIC(MetricTimer timer(m_metrics.callback_ticks));
+                OnOrderAmended(event.orderId, event.error);
+            }
+        }
+        else
+        {
+            m_listener.OnOrderAmended(event);
+        }
+    }
+
+    void Emit(const OrdersCancelledEvent& event)
+    {
+        EXCHANGE_METRIC(m_metrics.cancelled.Add(event.count));
+        if constexpr (kCallbacks)
+        {
+            if (OnOrdersCancelled)
+            {
+                EXCHANGE_METRIC(MetricTimer timer(m_metrics.callback_ticks));
+                OnOrdersCancelled(event.orderIds, event.count);
+            }
+        }
+        else
+        {
+            m_listener.OnOrdersCancelled(event);
+        }
+    }
+
+    void Emit(const BestPriceChangedEvent& event)
+    {
+        if constexpr (kCallbacks)
+        {
+            if (IExchange::OnBestPriceChanged)
+            {
+                EXCHANGE_METRIC(MetricTimer timer(m_metrics.callback_ticks));
+                IExchange::OnBestPriceChanged(m_symbols.Name(event.symbol),
+                                              event.bestBid,
+                                              event.totalBidVolume,
+                                              event.bestAsk,
+                                              event.totalAskVolume);
+            }
+        }
+        else
+        {
+            m_listener.OnBestPriceChanged(event);
+        }
+    }
+
+    void Emit(const TradeEvent& event)
+    {
+        EXCHANGE_METRIC(m_metrics.trades.Add());
+        if constexpr (kCallbacks)
+        {
+            if (OnTrade)
+            {
+                EXCHANGE_METRIC(MetricTimer timer(m_metrics.callback_ticks));
+                OnTrade(m_symbols.Name(event.symbol), event.aggressorId, event.restingId, event.price, event.volume);
+            }
+        }
+        else
+        {
+            m_listener.OnTrade(event);
+        }
+    }
+
+    // Fill up to volume of a Policy side order against the opposite side of
+    // the book while it crosses limit, returns the volume left to rest
+    template <typename Policy>
+    Volume Match(SymbolId symbol, OrderBook& order_book, Price limit, Volume volume, OrderId aggressorId);
+
+    // Match the new order filled in at handle and rest what is left of it,
+    // true if the best price of the book changed
+    template <typename Policy>
+    bool EnterOrder(OrderBook& order_book, OrderHandle handle);
+    // Move a resting order to a new price and volume, see AmendOrder
+    template <typename Policy>
+    void RepriceOrder(OrderBook& order_book, OrderHandle handle, Price price, Volume volume);
+    // Queue the order at the back of the level for its price, creating the level
+    template <typename Policy>
+    PriceLevel& QueueOrder(OrderBook& order_book, OrderHandle handle);
+    // An order left price_level: drop the level once empty and reload the
+    // cached best price if it was the best level. True if that happened.
+    template <typename Policy>
+    bool LeaveLevel(OrderBook& order_book, PriceLevel& price_level);
+    // Drop price_level once empty, leaving the cached best price alone
+    template <typename Policy>
+    void ReleaseIfEmpty(OrderBook& order_book, PriceLevel& price_level);
+
+    // Append order to the back of the FIFO queue of the price level
+    void LinkOrder(PriceLevel& price_level, OrderHandle handle);
+    // Remove order from the FIFO queue of the price level
+    void UnlinkOrder(PriceLevel& price_level, OrderInfo& order);
+
+    // Add order to, and remove it from, the chain of its session
+    void LinkSession(OrderHandle handle);
+    void UnlinkSession(OrderInfo& order);
+
+    // Drop an order that is no longer on any queue: its id, session link
+    // and arena record
+    void ForgetOrder(OrderHandle handle);
+
+    // Cancel every order of one side of a book, see MassCancel
+    template <typename Policy>
+    void CancelSide(SymbolId symbol, OrderBook& order_book);
+    // Cancel one order of a session chain, see MassCancel
+    void CancelSessionOrder(OrderHandle handle);
+    // Remember that the book lost orders in the current mass cancel
+    void TouchBook(SymbolId symbol);
+
+    Listener m_listener;
+
+#if EXCHANGE_METRICS
+    ExchangeMetrics m_metrics{sizeof(OrderInfo), sizeof(PriceLevel)};
+#endif
+
+    ExchangeConfig m_config;
+
+    // Huge page memory the order pool takes its chunks from, see Placement.h
+    std::unique_ptr<MemoryArena> m_arena;
+
+    // Arena holding every resting order
+    ObjectPool<OrderInfo> m_orders;
+
+    // OrderId to handle of the Order Info in the arena
+    OrderIdTable m_orderid_to_info;
+
+    // Order books indexed by SymbolId
+    std::vector<OrderBook> m_order_book;
+
+    // Supported symbols ( filled from the symbol universe in constructor)
+    SymbolTable m_symbols;
+
+    // Sum of the expected depth of all listed symbols
+    std::size_t m_expected_orders;
+
+    // Inside ProcessBatch, and the books whose best price changed during it.
+    // m_dirty_books is reserved for every symbol so marking never allocates.
+    bool                  m_in_batch;
+    std::vector<SymbolId> m_dirty_books;
+    // Books that lost orders in the current mass cancel, reserved likewise
+    std::vector<SymbolId> m_touched_books;
+
+    // Write-ahead journal, and the next record to check while replaying
+    std::unique_ptr<Journal> m_journal;
+    bool                     m_replaying;
+    std::size_t              m_replay_cursor;
+    // Records were journaled during the current batch
+    bool m_batch_journaled;
+
+    // Newest order of each session, indexed by SessionId
+    std::vector<OrderHandle> m_session_heads;
+    // Ids removed by the current mass cancel, reused between calls
+    std::vector<OrderId> m_cancelled;
+
+    // Pre-trade limits and exposure, and the account of each SessionId
+    RiskGate               m_risk;
+    std::vector<AccountId> m_session_accounts;
+
+    // Per-level depth feed, preallocated to depth_capacity updates
+    DepthPublisher m_depth;
+    // Shared memory feed, see ExchangeConfig::market_data_name
+    std::unique_ptr<MarketDataPublisher> m_market_data;
+    // Views for concurrent readers and the books marked for them, see
+    // ExchangeConfig::reader_depth
+    std::unique_ptr<BookReader> m_reader;
+    std::vector<SymbolId>       m_reader_books;
+    std::vector<OrderId>        m_reader_orders;
+
+    // Process writing the snapshot started by StartSnapshot, -1 if none
+    int m_snapshot_pid;
 
     // Next Order id, this keeps track of Unique incremental order ids to be given
     // to new orders
     int m_next_order_id;
 };
+
+// The exchange behind IExchange, events delivered through the std::function
+// callbacks
+using MyExchange = BasicExchange<>;
+
+extern template class BasicExchange<CallbackListener>;
@@ -0,0 +1,1617 @@
+#pragma once
+
+// Member definitions of BasicExchange. MyExchange is instantiated once in
+// MyExchange.cpp; include this header to instantiate an exchange with
+// another listener.
+
+#include "MyExchange.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+template <typename Listener>
+BasicExchange<Listener>::BasicExchange(const ExchangeConfig& config, Listener listener)
+    : m_listener(std::move(listener)),
+      m_config(config),
+      m_arena(config.placement.arena_bytes != 0 ? std::make_unique<MemoryArena>(config.placement) : nullptr),
+      m_orders(OrderPoolConfig(config.order_pool, m_arena.get())),
+      m_expected_orders(0),
+      m_in_batch(false),
+      m_replaying(false),
+      m_replay_cursor(0),
+      m_batch_journaled(false),
+      m_risk(config.risk),
+      m_depth(config.depth_capacity),
+      m_reader(config.reader_depth != 0 ? std::make_unique<BookReader>(config.reader_depth, config.reader_threads)
+                                        : nullptr),
+      m_snapshot_pid(-1),
+      m_next_order_id(1)
+{
+    std::vector<SymbolParams> universe = ListedSymbols(m_config);
+
+    // Preallocate every book up front so no insert pays for book construction
+    m_symbols.Reserve(universe.size());
+    m_order_book.reserve(universe.size());
+    for (const SymbolParams& params : universe)
+    {
+        if (ListSymbol(params) == kInvalidSymbol)
+        {
+            throw std::invalid_argument("invalid parameters for symbol " + params.symbol);
+        }
+    }
+    if (m_config.placement.prefault)
+    {
+        m_orderid_to_info.Reserve(m_orders.Capacity());
+    }
+
+    if (!m_config.journal_file.empty())
+    {
+        m_journal = std::make_unique<Journal>(m_config.journal_file, m_config.journal_group_commit);
+    }
+    if (!m_config.market_data_name.empty())
+    {
+        m_market_data = std::make_unique<MarketDataPublisher>(m_config.market_data_name,
+                                                              std::max(m_config.market_data_symbols, universe.size()),
+                                                              m_config.market_data_log,
+                                                              m_config.market_data_replace);
+    }
+}
+
+template <typename Listener>
+BasicExchange<Listener>::~BasicExchange()
+{
+    // Never leave a snapshot writer behind as a zombie
+    WaitSnapshot();
+}
+
+template <typename Listener>
+SymbolId BasicExchange<Listener>::AddSymbol(const SymbolParams& params)
+{
+    if (!CanList(params))
+    {
+        return kInvalidSymbol;
+    }
+
+    // Journal the listing before it changes anything, a new symbol takes the
+    // next id. The name goes first, in as many records as it needs.
+    SymbolId id = m_symbols.Find(params.symbol);
+    if (id == kInvalidSymbol)
+    {
+        id = SymbolId(m_symbols.Size());
+    }
+    for (std::size_t offset = 0; offset < params.symbol.size(); offset += JournalRecord::kNameBytes)
+    {
+        if (!WriteAhead(JournalRecord::SymbolName(params.symbol, offset)))
+        {
+            return kInvalidSymbol;
+        }
+    }
+    if (!WriteAhead(JournalRecord::AddSymbol(id, params.tick_size, params.min_price, params.max_price)))
+    {
+        return kInvalidSymbol;
+    }
+    return ListSymbol(params);
+}
+
+template <typename Listener>
+SymbolId BasicExchange<Listener>::ListSymbol(const SymbolParams& params)
+{
+    // Books are moved when the vector grows, which keeps their price levels in place
+    static_assert(std::is_nothrow_move_constructible<OrderBook>::value, "OrderBook must not be copied on growth");
+
+    if (!CanList(params))
+    {
+        return kInvalidSymbol;
+    }
+
+    SymbolId id = m_symbols.Intern(params.symbol);
+    if (id == m_order_book.size())
+    {
+        m_order_book.emplace_back(params, m_config.ladder_levels);
+        m_dirty_books.reserve(m_order_book.size());
+        m_touched_books.reserve(m_order_book.size());
+        m_risk.ReserveSymbols(m_order_book.size());
+        if (m_reader)
+        {
+            m_reader->AddBook(id);
+            m_reader_books.reserve(m_order_book.size());
+        }
+        m_expected_orders += params.expected_depth;
+        m_orders.Reserve(m_expected_orders);
+        EXCHANGE_METRIC(m_metrics.AddBook());
+        EXCHANGE_METRIC(m_metrics.pool_bytes.Set(m_orders.Capacity() * sizeof(OrderInfo)));
+    }
+    else
+    {
+        OrderBook& order_book = m_order_book[id];
+        order_book.tick_size  = params.tick_size;
+        order_book.min_price  = params.min_price;
+        order_book.max_price  = params.max_price;
+    }
+    return id;
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::HaltSymbol(const std::string& symbol)
+{
+    return SetHalted(m_symbols.Find(symbol), true);
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::ResumeSymbol(const std::string& symbol)
+{
+    return SetHalted(m_symbols.Find(symbol), false);
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::SetHalted(SymbolId symbol, bool halted)
+{
+    // Journal the halt before it changes which orders are accepted
+    if (symbol >= m_order_book.size() || !WriteAhead(JournalRecord::Halt(symbol, halted)))
+    {
+        return false;
+    }
+    m_order_book[symbol].halted = halted;
+    return true;
+}
+
+template <typename Listener>
+template <typename Compare>
+typename BasicExchange<Listener>::PriceLevel& BasicExchange<Listener>::BookSide<Compare>::Acquire(
+    Price price, ObjectPool<OrderInfo>& orders)
+{
+    if (m_ladder.Enabled())
+    {
+        if (m_ladder.Empty())
+        {
+            Recenter(price, orders);
+        }
+        if (m_ladder.Contains(price))
+        {
+            PriceLevel& level = m_ladder.At(price);
+            if (!m_ladder.IsOccupied(price))
+            {
+                m_ladder.SetOccupied(price);
+                level.price = price;
+            }
+            return level;
+        }
+    }
+
+    // Price is outside the ladder window, fall back to the tree
+    PriceLevel& level = m_tree[price];
+    level.price       = price;
+    return level;
+}
+
+template <typename Listener>
+template <typename Compare>
+void BasicExchange<Listener>::BookSide<Compare>::Release(PriceLevel& level, ObjectPool<OrderInfo>& orders)
+{
+    if (m_ladder.Owns(level))
+    {
+        m_ladder.ClearOccupied(level.price);
+        // Slide the window to the best tree level once the ladder runs dry
+        if (m_ladder.Empty() && !m_tree.empty())
+        {
+            Recenter(m_tree.begin()->first, orders);
+        }
+    }
+    else
+    {
+        m_tree.erase(level.price);
+    }
+}
+
+template <typename Listener>
+template <typename Compare>
+typename BasicExchange<Listener>::PriceLevel* BasicExchange<Listener>::BookSide<Compare>::Best()
+{
+    PriceLevel* best = m_tree.empty() ? nullptr : &m_tree.begin()->second;
+    if (m_ladder.Enabled() && !m_ladder.Empty())
+    {
+        // Asks are best at the lowest price, bids at the highest
+        Price price = std::is_same<Compare, std::less<Price>>::value ? m_ladder.Lowest() : m_ladder.Highest();
+        if (!best || Compare()(price, best->price))
+        {
+            best = &m_ladder.At(price);
+        }
+    }
+    return best;
+}
+
+template <typename Listener>
+template <typename Compare>
+template <typename Function>
+void BasicExchange<Listener>::BookSide<Compare>::ForEachLevel(Function function) const
+{
+    m_ladder.ForEachOccupied(function);
+    for (const auto& entry : m_tree)
+    {
+        function(entry.second);
+    }
+}
+
+template <typename Listener>
+template <typename Compare>
+template <typename Function>
+void BasicExchange<Listener>::BookSide<Compare>::ForEachBest(Function function) const
+{
+    // Tree levels lie outside the ladder window, so the two are merged
+    constexpr bool kDescending = !std::is_same<Compare, std::less<Price>>::value;
+    auto           tree        = m_tree.begin();
+    bool           more        = m_ladder.template ForEachInOrder<kDescending>([&](const PriceLevel& level) {
+        for (; tree != m_tree.end() && Compare()(tree->first, level.price); ++tree)
+        {
+            if (!function(tree->second))
+            {
+                return false;
+            }
+        }
+        return function(level);
+    });
+    for (; more && tree != m_tree.end(); ++tree)
+    {
+        more = function(tree->second);
+    }
+}
+
+template <typename Listener>
+template <typename Compare>
+void BasicExchange<Listener>::BookSide<Compare>::Clear()
+{
+    m_ladder.Clear();
+    m_tree.clear();
+}
+
+template <typename Listener>
+template <typename Compare>
+void BasicExchange<Listener>::BookSide<Compare>::Recenter(Price price, ObjectPool<OrderInfo>& orders)
+{
+    m_ladder.Recenter(price);
+
+    // Tree levels inside the new window are contiguous in Compare order
+    Price low   = m_ladder.Base();
+    Price high  = low + Price(m_ladder.Size() - 1);
+    auto  first = m_tree.lower_bound(Compare()(low, high) ? low : high);
+    while (first != m_tree.end() && m_ladder.Contains(first->first))
+    {
+        PriceLevel& level = m_ladder.At(first->first);
+        level             = first->second;
+        m_ladder.SetOccupied(first->first);
+        // Orders point at their level, so repoint the whole queue
+        for (OrderHandle handle = level.head; handle != kNullHandle; handle = orders[handle].next)
+        {
+            orders[handle].level = &level;
+        }
+        first = m_tree.erase(first);
+    }
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::LinkOrder(PriceLevel& price_level, OrderHandle handle)
+{
+    OrderInfo& order = m_orders[handle];
+    order.prev       = price_level.tail;
+    order.next       = kNullHandle;
+    if (price_level.tail != kNullHandle)
+    {
+        m_orders[price_level.tail].next = handle;
+    }
+    else
+    {
+        price_level.head = handle;
+    }
+    price_level.tail = handle;
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::LinkSession(OrderHandle handle)
+{
+    OrderInfo& order = m_orders[handle];
+    if (order.session == kNoSession)
+    {
+        return;
+    }
+    if (order.session >= m_session_heads.size())
+    {
+        m_session_heads.resize(order.session + 1, kNullHandle);
+    }
+    // Newest first, sessions are only ever walked whole
+    OrderHandle& head  = m_session_heads[order.session];
+    order.session_prev = kNullHandle;
+    order.session_next = head;
+    if (head != kNullHandle)
+    {
+        m_orders[head].session_prev = handle;
+    }
+    head = handle;
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::UnlinkSession(OrderInfo& order)
+{
+    if (order.session == kNoSession)
+    {
+        return;
+    }
+    if (order.session_prev != kNullHandle)
+    {
+        m_orders[order.session_prev].session_next = order.session_next;
+    }
+    else
+    {
+        m_session_heads[order.session] = order.session_next;
+    }
+    if (order.session_next != kNullHandle)
+    {
+        m_orders[order.session_next].session_prev = order.session_prev;
+    }
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::ForgetOrder(OrderHandle handle)
+{
+    OrderInfo& order = m_orders[handle];
+    UnlinkSession(order);
+    m_orderid_to_info.Erase(order.order_id);
+    PublishOrder(order);
+    if (m_risk.Enabled())
+    {
+        m_risk.Close(order.account, order.symbol, Notional(order));
+    }
+    EXCHANGE_METRIC(m_metrics.BookAt(order.symbol).orders.Sub());
+    m_orders.Release(handle);
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::UnlinkOrder(PriceLevel& price_level, OrderInfo& order)
+{
+    if (order.prev != kNullHandle)
+    {
+        m_orders[order.prev].next = order.next;
+    }
+    else
+    {
+        price_level.head = order.next;
+    }
+    if (order.next != kNullHandle)
+    {
+        m_orders[order.next].prev = order.prev;
+    }
+    else
+    {
+        price_level.tail = order.prev;
+    }
+}
+
+template <typename Listener>
+template <typename Policy>
+Volume BasicExchange<Listener>::Match(
+    SymbolId symbol, OrderBook& order_book, Price limit, Volume volume, OrderId aggressorId)
+{
+    using Opposite = typename Policy::Opposite;
+    using Compare  = typename Opposite::Compare;
+
+    // Opposite levels are visited best first while they cross the limit price,
+    // and each level is consumed from the head of its FIFO queue
+    BookSide<Compare>& opposite = Opposite::Levels(order_book);
+    PriceLevel*        level    = opposite.Best();
+    while (volume > 0 && level != nullptr && !Compare()(limit, level->price))
+    {
+        OrderHandle handle  = level->head;
+        OrderInfo&  resting = m_orders[handle];
+        Volume      fill    = resting.vol < volume ? resting.vol : volume;
+
+        if (m_risk.Enabled())
+        {
+            // The filled part stops resting
+            m_risk.Change(resting.account, symbol, std::uint64_t(resting.price) * fill, 0);
+        }
+        resting.vol -= fill;
+        level->total_vol -= fill;
+        volume -= fill;
+
+        Emit(TradeEvent{symbol, aggressorId, resting.order_id, level->price, fill});
+
+        if (resting.vol == 0)
+        {
+            UnlinkOrder(*level, resting);
+            ForgetOrder(handle);
+            if (level->head == kNullHandle)
+            {
+                DepthChanged(DepthUpdate::Action::Delete, symbol, Opposite::kSide, *level);
+                opposite.Release(*level, m_orders);
+                level = opposite.Best();
+            }
+            else
+            {
+                DepthChanged(DepthUpdate::Action::Modify, symbol, Opposite::kSide, *level);
+            }
+        }
+        else
+        {
+            PublishOrder(resting);
+            DepthChanged(DepthUpdate::Action::Modify, symbol, Opposite::kSide, *level);
+        }
+    }
+    return volume;
+}
+
+template <typename Listener>
+template <typename Policy>
+bool BasicExchange<Listener>::EnterOrder(OrderBook& order_book, OrderHandle handle)
+{
+    using Opposite = typename Policy::Opposite;
+
+    OrderInfo& order              = m_orders[handle];
+    bool       isBestPriceChanged = false;
+
+    // sweep the opposite side up to the limit price, any fill changes its best price
+    if (m_config.matching)
+    {
+        Volume remaining = Match<Policy>(order.symbol, order_book, order.price, order.vol, order.order_id);
+        if (remaining != order.vol)
+        {
+            isBestPriceChanged = true;
+            Opposite::SetBest(order_book, Opposite::Levels(order_book).Best());
+            order.vol = remaining;
+        }
+    }
+
+    if (order.vol == 0)
+    {
+        // fully filled, nothing rests on the book
+        m_orders.Release(handle);
+        return isBestPriceChanged;
+    }
+
+    m_orderid_to_info.Insert(order.order_id, handle);
+    LinkSession(handle);
+    if (m_risk.Enabled())
+    {
+        m_risk.Open(order.account, order.symbol, Notional(order));
+    }
+    EXCHANGE_METRIC(m_metrics.BookAt(order.symbol).orders.Add());
+    PriceLevel& price_level = QueueOrder<Policy>(order_book, handle);
+
+    // if price level is top level in order book then update best price
+    if (&price_level == Policy::Levels(order_book).Best())
+    {
+        isBestPriceChanged = true;
+        Policy::SetBest(order_book, &price_level);
+    }
+    return isBestPriceChanged;
+}
+
+template <typename Listener>
+template <typename Policy>
+typename BasicExchange<Listener>::PriceLevel& BasicExchange<Listener>::QueueOrder(
+    OrderBook& order_book, OrderHandle handle)
+{
+    OrderInfo& order = m_orders[handle];
+
+    // create price level for this order if not already present
+    PriceLevel&         price_level = Policy::Levels(order_book).Acquire(order.price, m_orders);
+    DepthUpdate::Action action
+        = price_level.total_vol == 0 ? DepthUpdate::Action::Add : DepthUpdate::Action::Modify;
+    price_level.total_vol += order.vol;
+    DepthChanged(action, order.symbol, Policy::kSide, price_level);
+
+    // queue order at its price level and remember the level for delete
+    LinkOrder(price_level, handle);
+    order.level = &price_level;
+    PublishOrder(order);
+    return price_level;
+}
+
+template <typename Listener>
+template <typename Policy>
+bool BasicExchange<Listener>::LeaveLevel(OrderBook& order_book, PriceLevel& price_level)
+{
+    BookSide<typename Policy::Compare>& levels = Policy::Levels(order_book);
+
+    // only a change at the top of the order book changes the best price
+    bool isBestPriceChanged = &price_level == levels.Best();
+    // If current price level is empty then delete this level, and make the next level as current level
+    if (price_level.total_vol == 0)
+    {
+        levels.Release(price_level, m_orders);
+    }
+    if (isBestPriceChanged)
+    {
+        // if all price levels are empty then the best price is reset
+        Policy::SetBest(order_book, levels.Best());
+    }
+    return isBestPriceChanged;
+}
+
+template <typename Listener>
+template <typename Policy>
+void BasicExchange<Listener>::ReleaseIfEmpty(OrderBook& order_book, PriceLevel& price_level)
+{
+    if (price_level.total_vol == 0)
+    {
+        Policy::Levels(order_book).Release(price_level, m_orders);
+    }
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::InsertOrder(
+    const std::string& symbol, Side side, Price price, Volume volume, UserReference userReference)
+{
+    InsertOrder(m_symbols.Find(symbol), side, price, volume, userReference);
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::InsertOrder(
+    SymbolId symbol, Side side, Price price, Volume volume, UserReference userReference, SessionId session)
+{
+    EXCHANGE_METRIC(MetricTimer timer(m_metrics.insert_ticks));
+    ReaderScope readers(*this);
+
+    if (symbol >= m_order_book.size() || m_order_book[symbol].halted)
+    {
+        Emit(OrderInsertedEvent{userReference, InsertError::SymbolNotFound, 0});
+        return;
+    }
+
+    // Order books are created with the symbol
+    OrderBook& order_book = m_order_book[symbol];
+
+    if (!ValidPrice(order_book, price))
+    {
+        Emit(OrderInsertedEvent{userReference, InsertError::InvalidPrice, 0});
+        return;
+    }
+
+    if (volume <= 0)
+    {
+        Emit(OrderInsertedEvent{userReference, InsertError::InvalidVolume, 0});
+        return;
+    }
+
+    // Replayed orders were accepted once, so they only rebuild the exposure
+    AccountId account = AccountOf(session);
+    if (m_risk.Enabled() && !m_replaying)
+    {
+        RiskError risk = m_risk.CheckInsert(account, symbol, price, volume, Touch(order_book, side));
+        if (risk != RiskError::OK)
+        {
+            Emit(OrderInsertedEvent{userReference, InsertError::SystemError, 0, risk});
+            return;
+        }
+    }
+
+    // Take a record from the order arena, fails only if the arena may not grow
+    OrderHandle handle = m_orders.Allocate();
+    EXCHANGE_METRIC(m_metrics.pool_bytes.Set(m_orders.Capacity() * sizeof(OrderInfo)));
+
+    // Journal the order before it touches the book
+    if (handle != kNullHandle
+        && !WriteAhead(JournalRecord::Insert(symbol, side, price, volume, userReference, m_next_order_id, session)))
+    {
+        m_orders.Release(handle);
+        handle = kNullHandle;
+    }
+
+    if (handle == kNullHandle)
+    {
+        Emit(OrderInsertedEvent{userReference, InsertError::SystemError, 0});
+        return;
+    }
+
+    OrderId order_id = m_next_order_id++;
+
+    // Acknowledge before any fill so the order id is known to OnTrade handlers
+    Emit(OrderInsertedEvent{userReference, InsertError::OK, order_id});
+
+    // Fill OrderInfo with new order_id, it is only kept if something rests
+    OrderInfo& order    = m_orders[handle];
+    order.order_id      = order_id;
+    order.side          = side;
+    order.price         = price;
+    order.vol           = volume;
+    order.userReference = userReference;
+    order.symbol        = symbol;
+    order.session       = session;
+    order.account       = account;
+
+    // The only branch on side, each path is specialized from here on
+    bool isBestPriceChanged
+        = side == Side::Sell ? EnterOrder<AskPolicy>(order_book, handle) : EnterOrder<BidPolicy>(order_book, handle);
+
+    if (isBestPriceChanged)
+    {
+        BestPriceChanged(symbol);
+    }
+
+    return;
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::DeleteOrder(OrderId orderId)
+{
+    DeleteOrder(orderId, kNoSession);
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::DeleteOrder(OrderId orderId, SessionId session)
+{
+    EXCHANGE_METRIC(MetricTimer timer(m_metrics.delete_ticks));
+    ReaderScope readers(*this);
+
+    // Find oder in order_id to order_info table
+    OrderHandle handle = m_orderid_to_info.Find(orderId);
+    if (handle == kNullHandle || !MayTouch(session, handle))
+    {
+        // If order not found then return with error
+        Emit(OrderDeletedEvent{orderId, DeleteError::OrderNotFound});
+        return;
+    }
+
+    // Journal the delete before it touches the book
+    if (!WriteAhead(JournalRecord::Delete(orderId)))
+    {
+        Emit(OrderDeletedEvent{orderId, DeleteError::SystemError});
+        return;
+    }
+
+    // get all iterators from order_info for order_book, price_level and order
+    OrderInfo&  order       = m_orders[handle];
+    SymbolId    symbol      = order.symbol;
+    PriceLevel& price_level = *order.level;
+    OrderBook&  order_book  = m_order_book[symbol];
+
+    // Erase order from list at the same price level
+    UnlinkOrder(price_level, order);
+    // decrease total volume for that price level
+    price_level.total_vol -= order.vol;
+    DepthChanged(price_level.total_vol == 0 ? DepthUpdate::Action::Delete : DepthUpdate::Action::Modify,
+                 symbol,
+                 order.side,
+                 price_level);
+
+    bool isBestPriceChanged = order.side == Side::Sell ? LeaveLevel<AskPolicy>(order_book, price_level)
+                                                       : LeaveLevel<BidPolicy>(order_book, price_level);
+
+    // erasing order from OrderInfo map and returning its record to the arena
+    ForgetOrder(handle);
+
+    Emit(OrderDeletedEvent{orderId, DeleteError::OK});
+
+    if (isBestPriceChanged)
+    {
+        BestPriceChanged(symbol);
+    }
+
+    return;
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::AmendOrder(OrderId orderId, Price price, Volume volume, SessionId session)
+{
+    ReaderScope readers(*this);
+    OrderHandle handle = m_orderid_to_info.Find(orderId);
+    AmendError  error  = AmendError::OK;
+    if (handle == kNullHandle || !MayTouch(session, handle))
+    {
+        error = AmendError::OrderNotFound;
+    }
+    // A halted book must not trade, so nothing may move or grow on it
+    else if (m_order_book[m_orders[handle].symbol].halted
+             && (price != m_orders[handle].price || volume > m_orders[handle].vol))
+    {
+        error = AmendError::SymbolHalted;
+    }
+    else if (!ValidPrice(m_order_book[m_orders[handle].symbol], price))
+    {
+        error = AmendError::InvalidPrice;
+    }
+    else if (volume <= 0)
+    {
+        error = AmendError::InvalidVolume;
+    }
+    else if (m_risk.Enabled() && !m_replaying && CheckAmendRisk(m_orders[handle], price, volume) != RiskError::OK)
+    {
+        error = AmendError::RiskRejected;
+    }
+    // Journal the amend before it touches the book
+    else if (!WriteAhead(JournalRecord::Amend(orderId, price, volume)))
+    {
+        error = AmendError::SystemError;
+    }
+    if (error != AmendError::OK)
+    {
+        Emit(OrderAmendedEvent{orderId, error});
+        return;
+    }
+
+    OrderInfo&  order       = m_orders[handle];
+    SymbolId    symbol      = order.symbol;
+    PriceLevel& price_level = *order.level;
+    OrderBook&  order_book  = m_order_book[symbol];
+
+    if (price == order.price)
+    {
+        // A smaller order keeps its place in the queue, a larger one goes to
+        // the back of it. Either way only volumes change.
+        if (volume > order.vol)
+        {
+            UnlinkOrder(price_level, order);
+            LinkOrder(price_level, handle);
+        }
+        if (volume != order.vol)
+        {
+            if (m_risk.Enabled())
+            {
+                m_risk.Change(order.account, symbol, Notional(order), std::uint64_t(price) * volume);
+            }
+            price_level.total_vol = price_level.total_vol - order.vol + volume;
+            order.vol             = volume;
+            PublishOrder(order);
+            DepthChanged(DepthUpdate::Action::Modify, symbol, order.side, price_level);
+        }
+        Emit(OrderAmendedEvent{orderId, AmendError::OK});
+        if (RefreshBestPrices(order_book))
+        {
+            BestPriceChanged(symbol);
+        }
+        return;
+    }
+
+    if (order.side == Side::Sell)
+    {
+        RepriceOrder<AskPolicy>(order_book, handle, price, volume);
+    }
+    else
+    {
+        RepriceOrder<BidPolicy>(order_book, handle, price, volume);
+    }
+
+    // Both sides may have moved, but they are reported once
+    if (RefreshBestPrices(order_book))
+    {
+        BestPriceChanged(symbol);
+    }
+}
+
+template <typename Listener>
+template <typename Policy>
+void BasicExchange<Listener>::RepriceOrder(OrderBook& order_book, OrderHandle handle, Price price, Volume volume)
+{
+    OrderInfo&  order       = m_orders[handle];
+    SymbolId    symbol      = order.symbol;
+    OrderId     orderId     = order.order_id;
+    PriceLevel& price_level = *order.level;
+
+    // Take the order off its level, the level goes if it was the last one
+    UnlinkOrder(price_level, order);
+    price_level.total_vol -= order.vol;
+    DepthChanged(price_level.total_vol == 0 ? DepthUpdate::Action::Delete : DepthUpdate::Action::Modify,
+                 symbol,
+                 Policy::kSide,
+                 price_level);
+    ReleaseIfEmpty<Policy>(order_book, price_level);
+
+    // Acknowledge before any fill, as for a new order
+    Emit(OrderAmendedEvent{orderId, AmendError::OK});
+
+    if (m_config.matching)
+    {
+        volume = Match<Policy>(symbol, order_book, price, volume, orderId);
+    }
+
+    if (volume == 0)
+    {
+        // filled in full at the new price
+        ForgetOrder(handle);
+    }
+    else
+    {
+        // Requeue at the back of the level for the new price
+        if (m_risk.Enabled())
+        {
+            m_risk.Change(order.account, symbol, Notional(order), std::uint64_t(price) * volume);
+        }
+        order.price = price;
+        order.vol   = volume;
+        QueueOrder<Policy>(order_book, handle);
+    }
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::RefreshBestPrices(OrderBook& order_book)
+{
+    PriceLevel* best_bid = order_book.bid_price_level.Best();
+    PriceLevel* best_ask = order_book.ask_price_level.Best();
+    Price       bid      = best_bid ? best_bid->price : 0;
+    Volume      bid_vol  = best_bid ? best_bid->total_vol : 0;
+    Price       ask      = best_ask ? best_ask->price : 0;
+    Volume      ask_vol  = best_ask ? best_ask->total_vol : 0;
+
+    bool changed = bid != order_book.best_bid_price || bid_vol != order_book.best_bid_total_vol
+                   || ask != order_book.best_ask_price || ask_vol != order_book.best_ask_total_vol;
+    order_book.best_bid_price     = bid;
+    order_book.best_bid_total_vol = bid_vol;
+    order_book.best_ask_price     = ask;
+    order_book.best_ask_total_vol = ask_vol;
+    return changed;
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::Execute(const OrderCommand& command)
+{
+    switch (command.type)
+    {
+    case OrderCommand::Type::Insert:
+        InsertOrder(
+            command.symbol, command.side, command.price, command.volume, command.userReference, command.session);
+        break;
+    case OrderCommand::Type::Delete:
+        DeleteOrder(command.orderId, command.session);
+        break;
+    case OrderCommand::Type::Amend:
+        AmendOrder(command.orderId, command.price, command.volume, command.session);
+        break;
+    case OrderCommand::Type::MassCancel:
+        MassCancel(MassCancelFilter{command.symbol, command.both_sides, command.side, command.session});
+        break;
+    }
+}
+
+template <typename Listener>
+std::size_t BasicExchange<Listener>::MassCancel(const MassCancelFilter& filter)
+{
+    ReaderScope readers(*this);
+    if (filter.symbol != kInvalidSymbol && filter.symbol >= m_order_book.size())
+    {
+        return 0;
+    }
+    std::uint8_t side = filter.both_sides ? JournalRecord::kBothSides : std::uint8_t(filter.side);
+    if (!WriteAhead(JournalRecord::MassCancel(filter.symbol, side, filter.session)))
+    {
+        return kMassCancelFailed;
+    }
+
+    m_cancelled.clear();
+    if (filter.session != kNoSession)
+    {
+        // Walk the session chain, the next link is read before the order goes
+        OrderHandle handle = filter.session < m_session_heads.size() ? m_session_heads[filter.session] : kNullHandle;
+        while (handle != kNullHandle)
+        {
+            const OrderInfo& order = m_orders[handle];
+            OrderHandle      next  = order.session_next;
+            if ((filter.symbol == kInvalidSymbol || order.symbol == filter.symbol)
+                && (filter.both_sides || order.side == filter.side))
+            {
+                CancelSessionOrder(handle);
+            }
+            handle = next;
+        }
+    }
+    else
+    {
+        // Tear down whole sides, one book or all of them
+        SymbolId first = filter.symbol == kInvalidSymbol ? 0 : filter.symbol;
+        SymbolId last  = filter.symbol == kInvalidSymbol ? SymbolId(m_order_book.size()) : filter.symbol + 1;
+        for (SymbolId symbol = first; symbol < last; ++symbol)
+        {
+            OrderBook& order_book = m_order_book[symbol];
+            if (filter.both_sides || filter.side == Side::Buy)
+            {
+                CancelSide<BidPolicy>(symbol, order_book);
+            }
+            if (filter.both_sides || filter.side == Side::Sell)
+            {
+                CancelSide<AskPolicy>(symbol, order_book);
+            }
+        }
+    }
+
+    if (!m_cancelled.empty())
+    {
+        Emit(OrdersCancelledEvent{m_cancelled.data(), m_cancelled.size()});
+    }
+    // One best price per book, however many of its orders went
+    for (SymbolId symbol : m_touched_books)
+    {
+        OrderBook& order_book = m_order_book[symbol];
+        order_book.touched    = false;
+        if (RefreshBestPrices(order_book))
+        {
+            BestPriceChanged(symbol);
+        }
+    }
+    m_touched_books.clear();
+    return m_cancelled.size();
+}
+
+template <typename Listener>
+template <typename Policy>
+void BasicExchange<Listener>::CancelSide(SymbolId symbol, OrderBook& order_book)
+{
+    BookSide<typename Policy::Compare>& book_side = Policy::Levels(order_book);
+    bool                                cancelled = false;
+    book_side.ForEachLevel([&](const PriceLevel& level) {
+        for (OrderHandle handle = level.head; handle != kNullHandle;)
+        {
+            OrderHandle next = m_orders[handle].next;
+            m_cancelled.push_back(m_orders[handle].order_id);
+            ForgetOrder(handle);
+            handle = next;
+        }
+        if (m_depth.Enabled())
+        {
+            m_depth.Publish(DepthUpdate::Action::Delete, symbol, Policy::kSide, level.price, 0);
+        }
+        if (m_market_data)
+        {
+            m_market_data->PublishDepth(symbol, Policy::kSide, DepthUpdate::Action::Delete, level.price, 0);
+        }
+        EXCHANGE_METRIC(CountLevel(DepthUpdate::Action::Delete, symbol, Policy::kSide));
+        cancelled = true;
+    });
+    if (cancelled)
+    {
+        // Queues were dropped whole, so the levels go without unlinking
+        book_side.Clear();
+        TouchBook(symbol);
+        MarkForReaders(symbol);
+    }
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::CancelSessionOrder(OrderHandle handle)
+{
+    OrderInfo&  order       = m_orders[handle];
+    SymbolId    symbol      = order.symbol;
+    PriceLevel& price_level = *order.level;
+    OrderBook&  order_book  = m_order_book[symbol];
+
+    UnlinkOrder(price_level, order);
+    price_level.total_vol -= order.vol;
+    DepthChanged(price_level.total_vol == 0 ? DepthUpdate::Action::Delete : DepthUpdate::Action::Modify,
+                 symbol,
+                 order.side,
+                 price_level);
+    if (order.side == Side::Sell)
+    {
+        ReleaseIfEmpty<AskPolicy>(order_book, price_level);
+    }
+    else
+    {
+        ReleaseIfEmpty<BidPolicy>(order_book, price_level);
+    }
+    m_cancelled.push_back(order.order_id);
+    ForgetOrder(handle);
+    TouchBook(symbol);
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::TouchBook(SymbolId symbol)
+{
+    OrderBook& order_book = m_order_book[symbol];
+    if (!order_book.touched)
+    {
+        order_book.touched = true;
+        m_touched_books.push_back(symbol);
+    }
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::ProcessBatch(const OrderCommand* commands, std::size_t count)
+{
+    m_in_batch = true;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Execute(commands[i]);
+    }
+    m_in_batch = false;
+
+    // The whole batch is durable before any of its best prices is published
+    if (m_batch_journaled)
+    {
+        m_batch_journaled = false;
+        WriteAhead(JournalRecord::BatchEnd());
+        SyncJournal();
+    }
+
+    // One update per touched book carrying its final state
+    for (SymbolId symbol : m_dirty_books)
+    {
+        m_order_book[symbol].dirty = false;
+        BestPriceChanged(symbol);
+    }
+    m_dirty_books.clear();
+
+    if (!m_reader_books.empty())
+    {
+        PublishToReaders();
+    }
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::WriteAhead(JournalRecord record)
+{
+    if (!m_journal)
+    {
+        return true;
+    }
+    if (m_in_batch)
+    {
+        record.flags |= JournalRecord::kBatched;
+        m_batch_journaled = true;
+    }
+
+    if (m_replaying)
+    {
+        // Replay collects the name records itself
+        if (record.type == JournalRecord::Type::SymbolName)
+        {
+            return true;
+        }
+        // A batch cut short by a crash has no BatchEnd record
+        if (record.type == JournalRecord::Type::BatchEnd)
+        {
+            if (m_replay_cursor < m_journal->Size()
+                && (*m_journal)[m_replay_cursor].type == JournalRecord::Type::BatchEnd)
+            {
+                ++m_replay_cursor;
+            }
+            return true;
+        }
+        record.sequence = m_replay_cursor + 1;
+        if (m_replay_cursor == m_journal->Size()
+            || std::memcmp(&record, &(*m_journal)[m_replay_cursor], sizeof(record)) != 0)
+        {
+            throw std::runtime_error("journal does not match the exchange at record "
+                                     + std::to_string(m_replay_cursor + 1));
+        }
+        ++m_replay_cursor;
+        return true;
+    }
+
+    return m_journal->Append(record);
+}
+
+template <typename Listener>
+std::size_t BasicExchange<Listener>::Replay()
+{
+    if (!m_journal)
+    {
+        return 0;
+    }
+
+    // Records before the cursor are already in a loaded snapshot
+    std::size_t               first = m_replay_cursor;
+    std::size_t               count = m_journal->Size();
+    std::vector<OrderCommand> batch;
+    Symbol                    name;
+    m_replaying = true;
+    try
+    {
+        for (std::size_t i = first; i < count; ++i)
+        {
+            const JournalRecord& record = (*m_journal)[i];
+            // Batched commands are collected and run the way they were run live
+            if (!batch.empty() && !(record.flags & JournalRecord::kBatched))
+            {
+                ProcessBatch(batch.data(), batch.size());
+                batch.clear();
+            }
+            if (record.type == JournalRecord::Type::BatchEnd)
+            {
+                continue;
+            }
+            if (record.type == JournalRecord::Type::SymbolName)
+            {
+                name.append(record.Name(), record.side);
+                ++m_replay_cursor;
+                continue;
+            }
+
+            if (record.type == JournalRecord::Type::AddSymbol)
+            {
+                SymbolParams params;
+                params.symbol    = name;
+                params.tick_size = record.price;
+                params.min_price = record.volume;
+                params.max_price = record.session;
+                AddSymbol(params);
+            }
+            else if (record.type == JournalRecord::Type::Halt || record.type == JournalRecord::Type::Resume)
+            {
+                SetHalted(record.symbol, record.type == JournalRecord::Type::Halt);
+            }
+            else
+            {
+                OrderCommand command = OrderCommand::Delete(record.orderId);
+                if (record.type == JournalRecord::Type::Insert)
+                {
+                    command = OrderCommand::Insert(record.symbol,
+                                                   Side(record.side),
+                                                   record.price,
+                                                   record.volume,
+                                                   record.userReference,
+                                                   record.session);
+                }
+                else if (record.type == JournalRecord::Type::Amend)
+                {
+                    command = OrderCommand::Amend(record.orderId, record.price, record.volume);
+                }
+                else if (record.type == JournalRecord::Type::MassCancel)
+                {
+                    bool both_sides = record.side == JournalRecord::kBothSides;
+                    command         = OrderCommand::MassCancel(MassCancelFilter{
+                        record.symbol, both_sides, both_sides ? Side::Buy : Side(record.side), record.session});
+                }
+
+                if (record.flags & JournalRecord::kBatched)
+                {
+                    batch.push_back(command);
+                }
+                else
+                {
+                    Execute(command);
+                }
+            }
+            // A name run not followed by its AddSymbol was never listed
+            name.clear();
+
+            // A record that was rejected instead of accepted never reaches WriteAhead
+            if (batch.empty() && m_replay_cursor != i + 1)
+            {
+                throw std::runtime_error("journal does not match the exchange at record " + std::to_string(i + 1));
+            }
+        }
+        if (!batch.empty())
+        {
+            ProcessBatch(batch.data(), batch.size());
+        }
+        if (m_replay_cursor != count)
+        {
+            throw std::runtime_error("journal does not match the exchange at record "
+                                     + std::to_string(m_replay_cursor + 1));
+        }
+    }
+    catch (...)
+    {
+        m_replaying = false;
+        m_in_batch  = false;
+        throw;
+    }
+    m_replaying = false;
+    return count - first;
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::RequestDepthSnapshot(SymbolId symbol)
+{
+    if (symbol >= m_order_book.size() || !m_depth.Enabled())
+    {
+        return false;
+    }
+    const OrderBook& order_book = m_order_book[symbol];
+
+    std::size_t levels = 0;
+    auto        count  = [&](const PriceLevel&) { ++levels; };
+    order_book.bid_price_level.ForEachLevel(count);
+    order_book.ask_price_level.ForEachLevel(count);
+    if (m_depth.Free() < levels + 1)
+    {
+        return false;
+    }
+
+    m_depth.Publish(DepthUpdate::Action::Clear, symbol, Side::Buy, 0, 0);
+    // Only this reader asked, so neither the shared feed nor the level counts see it
+    order_book.bid_price_level.ForEachLevel([&](const PriceLevel& level) {
+        m_depth.Publish(DepthUpdate::Action::Add, symbol, Side::Buy, level.price, level.total_vol);
+    });
+    order_book.ask_price_level.ForEachLevel([&](const PriceLevel& level) {
+        m_depth.Publish(DepthUpdate::Action::Add, symbol, Side::Sell, level.price, level.total_vol);
+    });
+    return true;
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::SaveSnapshot(const std::string& path)
+{
+    // Journal records covered by the snapshot must not be lost in a crash
+    SyncJournal();
+
+    std::string temporary = path + ".tmp";
+    int         fd        = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool written = WriteSnapshot(fd);
+    ::close(fd);
+    if (!written || ::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        ::unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::StartSnapshot(const std::string& path)
+{
+    if (m_snapshot_pid > 0)
+    {
+        return false;
+    }
+    SyncJournal();
+
+    std::string temporary = path + ".tmp";
+    int         fd        = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    pid_t pid = ::fork();
+    if (pid == 0)
+    {
+        // The child sees the books frozen at the fork while the parent goes
+        // on trading, pages are only copied when the parent writes to them.
+        // WriteSnapshot does not allocate, so other threads of the parent
+        // holding allocator locks at the fork cannot deadlock the child.
+        bool written = WriteSnapshot(fd) && ::rename(temporary.c_str(), path.c_str()) == 0;
+        ::_exit(written ? 0 : 1);
+    }
+    ::close(fd);
+    if (pid < 0)
+    {
+        ::unlink(temporary.c_str());
+        return false;
+    }
+    m_snapshot_pid = pid;
+    return true;
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::WaitSnapshot()
+{
+    if (m_snapshot_pid <= 0)
+    {
+        return false;
+    }
+    int status = 0;
+    while (::waitpid(m_snapshot_pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            m_snapshot_pid = -1;
+            return false;
+        }
+    }
+    m_snapshot_pid = -1;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::WriteSnapshot(int fd) const
+{
+    SnapshotWriter writer(fd);
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version         = kSnapshotVersion;
+    header.symbol_count    = std::uint32_t(m_order_book.size());
+    header.order_count     = m_orders.InUse();
+    header.journal_records = m_journal ? m_journal->Size() : 0;
+    header.next_order_id   = m_next_order_id;
+    writer.Write(&header, sizeof(header));
+
+    for (SymbolId symbol = 0; symbol < m_order_book.size(); ++symbol)
+    {
+        const OrderBook& order_book = m_order_book[symbol];
+        const Symbol&    name       = m_symbols.Name(symbol);
+
+        SnapshotSymbol entry{};
+        if (name.size() >= sizeof(entry.name))
+        {
+            return false;
+        }
+        std::memcpy(entry.name, name.data(), name.size());
+        entry.tick_size = order_book.tick_size;
+        entry.min_price = order_book.min_price;
+        entry.max_price = order_book.max_price;
+        entry.halted    = order_book.halted;
+
+        auto count = [&](const PriceLevel& level) {
+            for (OrderHandle handle = level.head; handle != kNullHandle; handle = m_orders[handle].next)
+            {
+                ++entry.order_count;
+            }
+        };
+        order_book.bid_price_level.ForEachLevel(count);
+        order_book.ask_price_level.ForEachLevel(count);
+        writer.Write(&entry, sizeof(entry));
+
+        // Each queue head first, so loading appends orders back in FIFO order
+        auto write = [&](const PriceLevel& level) {
+            for (OrderHandle handle = level.head; handle != kNullHandle; handle = m_orders[handle].next)
+            {
+                const OrderInfo& order = m_orders[handle];
+                SnapshotOrder    record{order.order_id,
+                                     order.userReference,
+                                     order.price,
+                                     order.vol,
+                                     order.session,
+                                     std::uint8_t(order.side),
+                                     {}};
+                writer.Write(&record, sizeof(record));
+            }
+        };
+        order_book.bid_price_level.ForEachLevel(write);
+        order_book.ask_price_level.ForEachLevel(write);
+    }
+    return writer.Finish();
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::LoadSnapshot(const std::string& path)
+{
+    if (m_orders.InUse() != 0)
+    {
+        throw std::runtime_error("snapshot loaded into an exchange holding orders");
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("cannot open snapshot " + path);
+    }
+    struct stat status;
+    if (::fstat(fd, &status) != 0 || std::size_t(status.st_size) < sizeof(SnapshotHeader))
+    {
+        ::close(fd);
+        throw std::runtime_error("not a snapshot " + path);
+    }
+    std::size_t size  = std::size_t(status.st_size);
+    void*       image = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (image == MAP_FAILED)
+    {
+        throw std::runtime_error("cannot map snapshot " + path);
+    }
+
+    try
+    {
+        LoadSnapshotImage(static_cast<const unsigned char*>(image), size);
+    }
+    catch (...)
+    {
+        ::munmap(image, size);
+        throw;
+    }
+    ::munmap(image, size);
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::LoadSnapshotImage(const unsigned char* image, std::size_t size)
+{
+    const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(image);
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 || header.version != kSnapshotVersion)
+    {
+        throw std::runtime_error("not a snapshot");
+    }
+
+    // Check the whole layout before any book is touched
+    std::size_t   offset = sizeof(header);
+    std::uint64_t orders = 0;
+    for (std::uint32_t symbol = 0; symbol < header.symbol_count; ++symbol)
+    {
+        SnapshotSymbol entry;
+        if (size - offset < sizeof(entry))
+        {
+            throw std::runtime_error("truncated snapshot");
+        }
+        std::memcpy(&entry, image + offset, sizeof(entry));
+        offset += sizeof(entry);
+        if (entry.order_count > (size - offset) / sizeof(SnapshotOrder))
+        {
+            throw std::runtime_error("truncated snapshot");
+        }
+        offset += entry.order_count * sizeof(SnapshotOrder);
+        orders += entry.order_count;
+    }
+    if (offset != size || orders != header.order_count)
+    {
+        throw std::runtime_error("corrupt snapshot");
+    }
+    if (m_journal && header.journal_records > m_journal->Size())
+    {
+        throw std::runtime_error("snapshot is ahead of the journal");
+    }
+
+    m_orders.Reserve(header.order_count);
+    EXCHANGE_METRIC(m_metrics.pool_bytes.Set(m_orders.Capacity() * sizeof(OrderInfo)));
+    offset = sizeof(header);
+    for (SymbolId symbol = 0; symbol < header.symbol_count; ++symbol)
+    {
+        SnapshotSymbol entry;
+        std::memcpy(&entry, image + offset, sizeof(entry));
+        offset += sizeof(entry);
+
+        SymbolParams params;
+        params.symbol    = std::string(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        params.tick_size = entry.tick_size;
+        params.min_price = entry.min_price;
+        params.max_price = entry.max_price;
+        if (ListSymbol(params) != symbol)
+        {
+            throw std::runtime_error("snapshot symbol " + params.symbol + " does not fit the listed symbols");
+        }
+        OrderBook& order_book = m_order_book[symbol];
+        order_book.halted     = entry.halted != 0;
+
+        const SnapshotOrder* records = reinterpret_cast<const SnapshotOrder*>(image + offset);
+        offset += entry.order_count * sizeof(SnapshotOrder);
+        for (std::uint64_t i = 0; i < entry.order_count; ++i)
+        {
+            const SnapshotOrder& record = records[i];
+            if (record.order_id <= 0 || record.volume == 0 || record.side > std::uint8_t(Side::Sell)
+                || m_orderid_to_info.Find(record.order_id) != kNullHandle)
+            {
+                throw std::runtime_error("corrupt snapshot order " + std::to_string(record.order_id));
+            }
+            // Cannot fail, the arena was reserved for every order above
+            OrderHandle handle  = m_orders.Allocate();
+            OrderInfo&  order   = m_orders[handle];
+            order.order_id      = record.order_id;
+            order.side          = Side(record.side);
+            order.price         = record.price;
+            order.vol           = record.volume;
+            order.userReference = record.userReference;
+            order.symbol        = symbol;
+            order.session       = record.session;
+            order.account       = AccountOf(record.session);
+            m_orderid_to_info.Insert(order.order_id, handle);
+            LinkSession(handle);
+            if (m_risk.Enabled())
+            {
+                m_risk.Open(order.account, symbol, Notional(order));
+            }
+            EXCHANGE_METRIC(m_metrics.BookAt(symbol).orders.Add());
+
+            PriceLevel& price_level = order.side == Side::Sell
+                                          ? order_book.ask_price_level.Acquire(order.price, m_orders)
+                                          : order_book.bid_price_level.Acquire(order.price, m_orders);
+            if (price_level.total_vol == 0)
+            {
+                EXCHANGE_METRIC(CountLevel(DepthUpdate::Action::Add, symbol, order.side));
+            }
+            price_level.total_vol += order.vol;
+            LinkOrder(price_level, handle);
+            order.level = &price_level;
+            PublishOrder(order);
+        }
+
+        RefreshBestPrices(order_book);
+        MarkForReaders(symbol);
+    }
+
+    if (!m_reader_books.empty())
+    {
+        PublishToReaders();
+    }
+
+    m_next_order_id = header.next_order_id;
+    // Replay picks up with the first record the snapshot does not cover
+    if (m_journal)
+    {
+        m_replay_cursor = header.journal_records;
+    }
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::SyncJournal()
+{
+    if (m_journal)
+    {
+        m_journal->Commit();
+    }
+}
+
+template <typename Listener>
+bool BasicExchange<Listener>::BindSession(SessionId session, AccountId account)
+{
+    if (account >= m_risk.Accounts())
+    {
+        return false;
+    }
+    if (session >= m_session_accounts.size())
+    {
+        m_session_accounts.resize(session + 1, 0);
+    }
+    m_session_accounts[session] = account;
+    return true;
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::PublishToReaders()
+{
+    m_reader->BeginPublish();
+    // Orders gone by now are no longer in the id table
+    for (OrderId order_id : m_reader_orders)
+    {
+        OrderHandle handle = m_orderid_to_info.Find(order_id);
+        if (handle == kNullHandle)
+        {
+            m_reader->EraseOrder(order_id);
+            continue;
+        }
+        const OrderInfo& order = m_orders[handle];
+        m_reader->PublishOrder(order_id, order.symbol, order.side, order.price, order.vol);
+    }
+    m_reader_orders.clear();
+
+    for (SymbolId symbol : m_reader_books)
+    {
+        OrderBook& order_book   = m_order_book[symbol];
+        order_book.reader_dirty = false;
+        m_reader->PublishTop(symbol,
+                             order_book.best_bid_price,
+                             order_book.best_bid_total_vol,
+                             order_book.best_ask_price,
+                             order_book.best_ask_total_vol);
+
+        // A fresh image each time, readers may still be copying the last one.
+        // It is a spare one AddBook made unless readers pin retired images.
+        BookReader::DepthImage& image = m_reader->NewDepth();
+        order_book.bid_price_level.ForEachBest(
+            [&](const PriceLevel& level) { return image.AddBid(level.price, level.total_vol); });
+        order_book.ask_price_level.ForEachBest(
+            [&](const PriceLevel& level) { return image.AddAsk(level.price, level.total_vol); });
+        m_reader->PublishDepth(symbol, image);
+    }
+    m_reader_books.clear();
+    m_reader->EndPublish();
+    m_reader->Reclaim();
+}
+
+template <typename Listener>
+void BasicExchange<Listener>::BestPriceChanged(SymbolId symbol)
+{
+    OrderBook& order_book = m_order_book[symbol];
+    if (m_in_batch)
+    {
+        if (!order_book.dirty)
+        {
+            order_book.dirty = true;
+            m_dirty_books.push_back(symbol);
+        }
+        return;
+    }
+
+    if (m_market_data)
+    {
+        m_market_data->PublishBest(symbol,
+                                   order_book.best_bid_price,
+                                   order_book.best_bid_total_vol,
+                                   order_book.best_ask_price,
+                                   order_book.best_ask_total_vol);
+    }
+    Emit(BestPriceChangedEvent{symbol,
+                               order_book.best_bid_price,
+                               order_book.best_bid_total_vol,
+                               order_book.best_ask_price,
+                               order_book.best_ask_total_vol});
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "Placement.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Handle to a record inside an ObjectPool. Handles are 1-based so that 0 can be
+// used as the null link of intrusive lists built on top of pool records.
+using PoolHandle = std::uint32_t;
+
+constexpr PoolHandle kNullHandle = 0;
+
+// What the pool does once every preallocated record is in use
+enum class PoolGrowth
+{
+    Fixed,   // refuse new records
+    Linear,  // add one chunk at a time
+    Double   // double the number of chunks
+};
+
+struct PoolConfig
+{
+    // Number of records preallocated up front (rounded up to whole chunks)
+    std::size_t capacity{1 << 16};
+    // Number of records per chunk, must be a power of two
+    std::size_t chunk_size{1 << 12};
+    // Upper bound on the number of records when growing, 0 means no bound
+    std::size_t max_capacity{0};
+    // Growth policy once the preallocated records are exhausted
+    PoolGrowth growth{PoolGrowth::Double};
+    // Chunks are carved from this arena while it has room, see Placement.h
+    MemoryArena* arena{nullptr};
+};
+
+// Slab of fixed-size records allocated in chunks that never move, so a handle
+// stays valid until it is released. Allocate and Release only touch the free
+// stack; the global allocator is used only when the pool grows.
+template <typename T>
+class ObjectPool
+{
+  public:
+    explicit ObjectPool(const PoolConfig& config = PoolConfig())
+        : m_config(config), m_chunk_shift(0), m_chunk_mask(0)
+    {
+        if (m_config.chunk_size == 0 || (m_config.chunk_size & (m_config.chunk_size - 1)) != 0)
+        {
+            m_config.chunk_size = PoolConfig().chunk_size;
+        }
+        while ((std::size_t(1) << m_chunk_shift) < m_config.chunk_size)
+        {
+            ++m_chunk_shift;
+        }
+        m_chunk_mask = m_config.chunk_size - 1;
+
+        std::size_t chunks = (m_config.capacity + m_config.chunk_size - 1) / m_config.chunk_size;
+        AddChunks(chunks == 0 ? 1 : chunks);
+    }
+
+    ~ObjectPool()
+    {
+        // The arena owns the memory of its chunks, only their records go here
+        if (!std::is_trivially_destructible<T>::value)
+        {
+            for (T* chunk : m_arena_chunks)
+            {
+                for (std::size_t i = 0; i < m_config.chunk_size; ++i)
+                {
+                    chunk[i].~T();
+                }
+            }
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Returns kNullHandle if the pool is exhausted and may not grow any more
+    PoolHandle Allocate()
+    {
+        if (m_free.empty() && !Grow())
+        {
+            return kNullHandle;
+        }
+        PoolHandle handle = m_free.back();
+        m_free.pop_back();
+        return handle;
+    }
+
+    void Release(PoolHandle handle) { m_free.push_back(handle); }
+
+    T& operator[](PoolHandle handle)
+    {
+        std::size_t index = handle - 1;
+        return m_chunks[index >> m_chunk_shift][index & m_chunk_mask];
+    }
+
+    const T& operator[](PoolHandle handle) const
+    {
+        std::size_t index = handle - 1;
+        return m_chunks[index >> m_chunk_shift][index & m_chunk_mask];
+    }
+
+    // Grow, regardless of the growth policy, until capacity records exist
+    void Reserve(std::size_t capacity)
+    {
+        if (capacity > Capacity())
+        {
+            AddChunks((capacity - Capacity() + m_config.chunk_size - 1) >> m_chunk_shift);
+        }
+    }
+
+    std::size_t Capacity() const { return m_chunks.size() << m_chunk_shift; }
+    std::size_t InUse() const { return Capacity() - m_free.size(); }
+
+  private:
+    bool Grow()
+    {
+        std::size_t chunks = 0;
+        switch (m_config.growth)
+        {
+        case PoolGrowth::Fixed:
+            return false;
+        case PoolGrowth::Linear:
+            chunks = 1;
+            break;
+        case PoolGrowth::Double:
+            chunks = m_chunks.size();
+            break;
+        }
+
+        std::size_t limit = m_config.max_capacity;
+        // Handles are 32 bit, never hand out more than that
+        if (limit == 0 || limit > UINT32_MAX)
+        {
+            limit = UINT32_MAX;
+        }
+        std::size_t capacity = Capacity();
+        if (capacity + m_config.chunk_size > limit)
+        {
+            return false;
+        }
+        if (capacity + (chunks << m_chunk_shift) > limit)
+        {
+            chunks = (limit - capacity) >> m_chunk_shift;
+        }
+        AddChunks(chunks);
+        return true;
+    }
+
+    void AddChunks(std::size_t chunks)
+    {
+        std::size_t first = Capacity();
+        for (std::size_t i = 0; i < chunks; ++i)
+        {
+            void* memory = m_config.arena ? m_config.arena->Allocate(m_config.chunk_size * sizeof(T), alignof(T))
+                                          : nullptr;
+            if (memory != nullptr)
+            {
+                T* chunk = static_cast<T*>(memory);
+                for (std::size_t j = 0; j < m_config.chunk_size; ++j)
+                {
+                    new (chunk + j) T();
+                }
+                m_arena_chunks.push_back(chunk);
+                m_chunks.push_back(chunk);
+            }
+            else
+            {
+                m_heap_chunks.push_back(std::make_unique<T[]>(m_config.chunk_size));
+                m_chunks.push_back(m_heap_chunks.back().get());
+            }
+        }
+        std::size_t last = Capacity();
+        m_free.reserve(last);
+        // Push in reverse so that records are handed out in address order
+        for (std::size_t index = last; index > first; --index)
+        {
+            m_free.push_back(static_cast<PoolHandle>(index));
+        }
+    }
+
+    PoolConfig                        m_config;
+    std::size_t                       m_chunk_shift;
+    std::size_t                       m_chunk_mask;
+    std::vector<T*>                   m_chunks;
+    // Owners of the chunks, by where they were allocated
+    std::vector<std::unique_ptr<T[]>> m_heap_chunks;
+    std::vector<T*>                   m_arena_chunks;
+    // Stack of released handles, reserved to the pool capacity
+    std::vector<PoolHandle> m_free;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "IExchange.h"
+#include "ObjectPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Direct-indexed map from OrderId to pool handle. Order ids are issued in
+// increasing order, so the table is split into fixed-size pages indexed by
+// the high bits of the id and a lookup is a single indexed load.
+//
+// A deleted id leaves a tombstone (kNullHandle) in its page. Once every id of
+// a page has been issued and deleted the page is recycled, leaving a null page
+// pointer behind, so stale ids keep resolving to kNullHandle.
+class OrderIdTable
+{
+  public:
+    static constexpr std::size_t kPageShift = 12;
+    static constexpr std::size_t kPageSize  = std::size_t(1) << kPageShift;
+    static constexpr std::size_t kPageMask  = kPageSize - 1;
+
+    // Returns kNullHandle for ids that were never inserted or already erased
+    PoolHandle Find(OrderId orderId) const
+    {
+        if (orderId <= 0)
+        {
+            return kNullHandle;
+        }
+        std::size_t page = std::size_t(orderId) >> kPageShift;
+        if (page >= m_pages.size() || !m_pages[page])
+        {
+            return kNullHandle;
+        }
+        return m_pages[page]->handles[std::size_t(orderId) & kPageMask];
+    }
+
+    // orderId must be positive and not currently present in the table
+    void Insert(OrderId orderId, PoolHandle handle)
+    {
+        std::size_t page = std::size_t(orderId) >> kPageShift;
+        if (page >= m_pages.size())
+        {
+            m_pages.resize(page + 1);
+        }
+        if (!m_pages[page])
+        {
+            m_pages[page] = NewPage();
+        }
+        if (page > m_last_page)
+        {
+            // The previous head page will not receive new ids any more
+            std::size_t last = m_last_page;
+            m_last_page      = page;
+            RecycleIfEmpty(last);
+        }
+        Page& entries = *m_pages[page];
+        entries.handles[std::size_t(orderId) & kPageMask] = handle;
+        ++entries.live;
+    }
+
+    void Erase(OrderId orderId)
+    {
+        std::size_t page    = std::size_t(orderId) >> kPageShift;
+        Page&       entries = *m_pages[page];
+        entries.handles[std::size_t(orderId) & kPageMask] = kNullHandle;
+        --entries.live;
+        RecycleIfEmpty(page);
+    }
+
+    // Allocate and zero the pages ids live ids spread over up front, so that
+    // issuing ids never takes a first-touch page fault
+    void Reserve(std::size_t ids)
+    {
+        std::size_t pages = (ids + kPageSize - 1) >> kPageShift;
+        m_pages.reserve(pages + 1);
+        while (m_spare.size() < pages)
+        {
+            m_spare.push_back(std::make_unique<Page>());
+        }
+    }
+
+  private:
+    struct Page
+    {
+        PoolHandle  handles[kPageSize];
+        std::size_t live;
+    };
+
+    std::unique_ptr<Page> NewPage()
+    {
+        if (m_spare.empty())
+        {
+            return std::make_unique<Page>();
+        }
+        std::unique_ptr<Page> page = std::move(m_spare.back());
+        m_spare.pop_back();
+        return page;
+    }
+
+    void RecycleIfEmpty(std::size_t page)
+    {
+        if (page >= m_last_page || !m_pages[page] || m_pages[page]->live != 0)
+        {
+            return;
+        }
+        // All entries are tombstones, so the page is already zeroed for reuse
+        m_spare.push_back(std::move(m_pages[page]));
+    }
+
+    // Pages indexed by OrderId >> kPageShift, null once recycled
+    std::vector<std::unique_ptr<Page>> m_pages;
+    // Zeroed pages waiting to be reused for new ids
+    std::vector<std::unique_ptr<Page>> m_spare;
+    // Page holding the most recently issued id
+    std::size_t m_last_page{0};
+};
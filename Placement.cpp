@@ -0,0 +1,180 @@
+#include "Placement.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <linux/mman.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kSmallPage = 4096;
+constexpr std::size_t kHugePage  = std::size_t(2) << 20;
+constexpr std::size_t kGigaPage  = std::size_t(1) << 30;
+
+std::size_t RoundUp(std::size_t size, std::size_t unit)
+{
+    return (size + unit - 1) & ~(unit - 1);
+}
+
+void* MapHuge(std::size_t size, int size_flag)
+{
+    void* base = ::mmap(
+        nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+    return base == MAP_FAILED ? nullptr : base;
+}
+
+// Ordinary pages, aligned to a huge page so that transparent ones can back it
+void* MapAligned(std::size_t size)
+{
+    std::size_t padded = size + kHugePage;
+    void*       mapped = ::mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    std::uintptr_t start   = std::uintptr_t(mapped);
+    std::uintptr_t aligned = RoundUp(start, kHugePage);
+    if (aligned > start)
+    {
+        ::munmap(mapped, aligned - start);
+    }
+    std::size_t tail = padded - (aligned - start) - size;
+    if (tail > 0)
+    {
+        ::munmap(reinterpret_cast<void*>(aligned + size), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+}  // namespace
+
+bool PinCurrentThread(int cpu)
+{
+    if (cpu < 0)
+    {
+        return true;
+    }
+    if (cpu >= CPU_SETSIZE)
+    {
+        return false;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+int CpuNumaNode(int cpu)
+{
+    if (cpu < 0)
+    {
+        return -1;
+    }
+    // The cpu directory links to its node as nodeN
+    char path[64];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* directory = ::opendir(path);
+    if (directory == nullptr)
+    {
+        return -1;
+    }
+    int node = -1;
+    while (dirent* entry = ::readdir(directory))
+    {
+        int found;
+        if (std::sscanf(entry->d_name, "node%d", &found) == 1)
+        {
+            node = found;
+            break;
+        }
+    }
+    ::closedir(directory);
+    return node;
+}
+
+MemoryArena::MemoryArena(const PlacementConfig& config)
+    : m_base(nullptr), m_size(0), m_used(0), m_backing(Backing::None), m_node(-1)
+{
+    if (config.arena_bytes == 0)
+    {
+        return;
+    }
+
+    // Each kind of huge page falls back to the next smaller one
+    void* base = nullptr;
+    if (config.huge_pages == HugePages::Huge1GB)
+    {
+        m_size    = RoundUp(config.arena_bytes, kGigaPage);
+        base      = MapHuge(m_size, MAP_HUGE_1GB);
+        m_backing = Backing::Huge1GB;
+    }
+    if (base == nullptr && (config.huge_pages == HugePages::Huge1GB || config.huge_pages == HugePages::Huge2MB))
+    {
+        m_size    = RoundUp(config.arena_bytes, kHugePage);
+        base      = MapHuge(m_size, MAP_HUGE_2MB);
+        m_backing = Backing::Huge2MB;
+    }
+    if (base == nullptr)
+    {
+        m_size    = RoundUp(config.arena_bytes, config.huge_pages == HugePages::None ? kSmallPage : kHugePage);
+        base      = MapAligned(m_size);
+        m_backing = Backing::Pages;
+        if (base != nullptr && config.huge_pages != HugePages::None && ::madvise(base, m_size, MADV_HUGEPAGE) == 0)
+        {
+            m_backing = Backing::Transparent;
+        }
+    }
+    if (base == nullptr)
+    {
+        m_size    = 0;
+        m_backing = Backing::None;
+        return;
+    }
+    m_base = static_cast<unsigned char*>(base);
+
+    // Bind before anything is touched, so every page is allocated on the node
+    // whichever thread faults it in
+    int node = config.numa_node >= 0 ? config.numa_node : CpuNumaNode(config.cpu);
+    if (node >= 0 && node < int(sizeof(unsigned long) * 8))
+    {
+        unsigned long nodes = 1UL << node;
+        if (::syscall(SYS_mbind, m_base, m_size, MPOL_BIND, &nodes, sizeof(nodes) * 8, 0) == 0)
+        {
+            m_node = node;
+        }
+    }
+
+    if (config.prefault)
+    {
+        for (std::size_t offset = 0; offset < m_size; offset += kSmallPage)
+        {
+            *static_cast<volatile unsigned char*>(m_base + offset) = 0;
+        }
+    }
+}
+
+MemoryArena::~MemoryArena()
+{
+    if (m_base != nullptr)
+    {
+        ::munmap(m_base, m_size);
+    }
+}
+
+void* MemoryArena::Allocate(std::size_t size, std::size_t align)
+{
+    std::size_t offset = RoundUp(m_used, align);
+    if (m_base == nullptr || offset > m_size || size > m_size - offset)
+    {
+        return nullptr;
+    }
+    m_used = offset + size;
+    return m_base + offset;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Where the exchange runs and where its memory lives. The thread driving the
+// exchange (see BookThread and Gateway) is pinned to cpu, and order storage
+// comes from one arena mapped on cpu's NUMA node, backed by huge pages when
+// the system has them and touched up front so that trading never takes a
+// first-touch page fault.
+
+enum class HugePages
+{
+    // Ordinary pages
+    None,
+    // Transparent huge pages, advised with madvise
+    Transparent,
+    // Reserved hugetlbfs pages, falling back to transparent ones and then to
+    // ordinary pages when none are free
+    Huge2MB,
+    Huge1GB
+};
+
+struct PlacementConfig
+{
+    // Core to pin the exchange thread to, -1 to leave it unpinned
+    int cpu{-1};
+    // NUMA node of the arena, -1 for the node of cpu (if pinned)
+    int numa_node{-1};
+    // Size of the arena holding the order pool, 0 for none (heap chunks)
+    std::size_t arena_bytes{0};
+    HugePages   huge_pages{HugePages::Huge2MB};
+    // Touch every page of the arena at startup
+    bool prefault{true};
+};
+
+// Pin the calling thread to cpu, false if that is not allowed. -1 is a no-op.
+bool PinCurrentThread(int cpu);
+
+// NUMA node of cpu, -1 if unknown
+int CpuNumaNode(int cpu);
+
+// One anonymous mapping carved up by a bump allocator. Nothing is returned
+// to it: it holds storage that lives as long as the exchange, such as the
+// chunks of the order pool. Never throws; an arena that could not be mapped
+// has no room and callers fall back to the heap.
+class MemoryArena
+{
+  public:
+    enum class Backing
+    {
+        None,
+        Pages,
+        Transparent,
+        Huge2MB,
+        Huge1GB
+    };
+
+    explicit MemoryArena(const PlacementConfig& config);
+    ~MemoryArena();
+
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+
+    // size bytes aligned to align (a power of two), nullptr once full
+    void* Allocate(std::size_t size, std::size_t align);
+
+    // What the mapping actually got
+    Backing     GetBacking() const { return m_backing; }
+    std::size_t Size() const { return m_size; }
+    std::size_t Used() const { return m_used; }
+    // Node the arena was bound to, -1 if none
+    int NumaNode() const { return m_node; }
+
+  private:
+    unsigned char* m_base;
+    std::size_t    m_size;
+    std::size_t    m_used;
+    Backing        m_backing;
+    int            m_node;
+};
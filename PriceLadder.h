@@ -0,0 +1,160 @@
+#pragma once
+
+#include "IExchange.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Contiguous array of price level slots covering the window
+// [base, base + size) at one slot per price unit. Occupied slots are tracked in
+// a two-level bitmap: bit i of m_words marks slot i, bit j of m_summary marks a
+// non-zero m_words[j]. The best level of either side is then found with one
+// ctz/clz per level instead of walking the slots.
+template <typename Level>
+class PriceLadder
+{
+  public:
+    explicit PriceLadder(std::size_t size = 0) { Resize(size); }
+
+    // Size is rounded up to a multiple of 64; 0 disables the ladder
+    void Resize(std::size_t size)
+    {
+        size = (size + 63) & ~std::size_t(63);
+        m_base = 0;
+        m_count = 0;
+        m_slots.assign(size, Level());
+        m_words.assign(size / 64, 0);
+        m_summary.assign((m_words.size() + 63) / 64, 0);
+    }
+
+    bool        Enabled() const { return !m_slots.empty(); }
+    bool        Empty() const { return m_count == 0; }
+    std::size_t Size() const { return m_slots.size(); }
+    Price       Base() const { return m_base; }
+
+    bool Contains(Price price) const { return price >= m_base && price - m_base < m_slots.size(); }
+    bool Owns(const Level& level) const
+    {
+        return !m_slots.empty() && &level >= &m_slots.front() && &level <= &m_slots.back();
+    }
+
+    Level& At(Price price) { return m_slots[price - m_base]; }
+    Price  PriceOf(const Level& level) const { return m_base + Price(&level - m_slots.data()); }
+
+    bool IsOccupied(Price price) const
+    {
+        std::size_t slot = price - m_base;
+        return (m_words[slot >> 6] >> (slot & 63)) & 1;
+    }
+
+    void SetOccupied(Price price)
+    {
+        std::size_t slot = price - m_base;
+        m_words[slot >> 6] |= std::uint64_t(1) << (slot & 63);
+        m_summary[slot >> 12] |= std::uint64_t(1) << ((slot >> 6) & 63);
+        ++m_count;
+    }
+
+    void ClearOccupied(Price price)
+    {
+        std::size_t slot = price - m_base;
+        m_words[slot >> 6] &= ~(std::uint64_t(1) << (slot & 63));
+        if (m_words[slot >> 6] == 0)
+        {
+            m_summary[slot >> 12] &= ~(std::uint64_t(1) << ((slot >> 6) & 63));
+        }
+        m_slots[slot] = Level();
+        --m_count;
+    }
+
+    // Lowest occupied price, ladder must not be empty
+    Price Lowest() const
+    {
+        std::size_t s = 0;
+        while (m_summary[s] == 0)
+        {
+            ++s;
+        }
+        std::size_t word = (s << 6) + __builtin_ctzll(m_summary[s]);
+        return m_base + Price((word << 6) + __builtin_ctzll(m_words[word]));
+    }
+
+    // Highest occupied price, ladder must not be empty
+    Price Highest() const
+    {
+        std::size_t s = m_summary.size() - 1;
+        while (m_summary[s] == 0)
+        {
+            --s;
+        }
+        std::size_t word = (s << 6) + 63 - __builtin_clzll(m_summary[s]);
+        return m_base + Price((word << 6) + 63 - __builtin_clzll(m_words[word]));
+    }
+
+    // Call function on every occupied slot, lowest price first
+    template <typename Function>
+    void ForEachOccupied(Function function) const
+    {
+        for (std::size_t word = 0; word < m_words.size(); ++word)
+        {
+            for (std::uint64_t bits = m_words[word]; bits != 0; bits &= bits - 1)
+            {
+                function(m_slots[(word << 6) + __builtin_ctzll(bits)]);
+            }
+        }
+    }
+
+    // Call function on occupied slots in price order, lowest first unless
+    // Descending, until it returns false. False if it was stopped.
+    template <bool Descending, typename Function>
+    bool ForEachInOrder(Function function) const
+    {
+        for (std::size_t i = 0; i < m_words.size(); ++i)
+        {
+            std::size_t word = Descending ? m_words.size() - 1 - i : i;
+            for (std::uint64_t bits = m_words[word]; bits != 0;)
+            {
+                std::size_t bit = Descending ? 63 - __builtin_clzll(bits) : __builtin_ctzll(bits);
+                bits &= ~(std::uint64_t(1) << bit);
+                if (!function(m_slots[(word << 6) + bit]))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Empty every slot, the window stays where it is
+    void Clear()
+    {
+        for (std::size_t word = 0; word < m_words.size(); ++word)
+        {
+            for (std::uint64_t bits = m_words[word]; bits != 0; bits &= bits - 1)
+            {
+                m_slots[(word << 6) + __builtin_ctzll(bits)] = Level();
+            }
+            m_words[word] = 0;
+        }
+        for (std::uint64_t& summary : m_summary)
+        {
+            summary = 0;
+        }
+        m_count = 0;
+    }
+
+    // Slide the window so that it is centred on price, ladder must be empty
+    void Recenter(Price price)
+    {
+        Price half = Price(m_slots.size() / 2);
+        m_base     = price > half ? price - half : 0;
+    }
+
+  private:
+    Price                      m_base;
+    std::size_t                m_count;
+    std::vector<Level>         m_slots;
+    std::vector<std::uint64_t> m_words;
+    std::vector<std::uint64_t> m_summary;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+constexpr std::size_t kCacheLineSize = 64;
+
+inline std::size_t RoundUpToPowerOfTwo(std::size_t value)
+{
+    std::size_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Bounded single-producer single-consumer ring. Head and tail live on their
+// own cache lines and each side caches the other side's index, so the shared
+// lines are only touched when the cached view says the ring looks full or empty.
+template <typename T>
+class SpscRing
+{
+  public:
+    explicit SpscRing(std::size_t capacity)
+        : m_mask(RoundUpToPowerOfTwo(capacity) - 1), m_slots(new T[m_mask + 1])
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side, false if the ring is full
+    bool TryPush(const T& value)
+    {
+        std::size_t tail = m_tail.value.load(std::memory_order_relaxed);
+        if (tail - m_cached_head.value > m_mask)
+        {
+            m_cached_head.value = m_head.value.load(std::memory_order_acquire);
+            if (tail - m_cached_head.value > m_mask)
+            {
+                return false;
+            }
+        }
+        m_slots[tail & m_mask] = value;
+        m_tail.value.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, false if the ring is empty
+    bool TryPop(T& value)
+    {
+        std::size_t head = m_head.value.load(std::memory_order_relaxed);
+        if (head == m_cached_tail.value)
+        {
+            m_cached_tail.value = m_tail.value.load(std::memory_order_acquire);
+            if (head == m_cached_tail.value)
+            {
+                return false;
+            }
+        }
+        value = m_slots[head & m_mask];
+        m_head.value.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t Capacity() const { return m_mask + 1; }
+
+  private:
+    template <typename V>
+    struct alignas(kCacheLineSize) Padded
+    {
+        V value{};
+    };
+
+    const std::size_t    m_mask;
+    std::unique_ptr<T[]> m_slots;
+    // Written by the consumer
+    Padded<std::atomic<std::size_t>> m_head;
+    Padded<std::size_t>              m_cached_tail;
+    // Written by the producer
+    Padded<std::atomic<std::size_t>> m_tail;
+    Padded<std::size_t>              m_cached_head;
+};
+
+// Bounded multi-producer single-consumer ring. Every slot carries a sequence
+// number telling whether it is free for the lap a producer claims, so
+// producers only contend on the tail counter and never on the slots.
+template <typename T>
+class MpscRing
+{
+  public:
+    explicit MpscRing(std::size_t capacity)
+        : m_mask(RoundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1), m_cells(new Cell[m_mask + 1])
+    {
+        for (std::size_t i = 0; i <= m_mask; ++i)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // Any producer thread, false if the ring is full
+    bool TryPush(const T& value)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell&          cell     = m_cells[tail & m_mask];
+            std::size_t    sequence = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff     = std::ptrdiff_t(sequence) - std::ptrdiff_t(tail);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                tail = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer thread only, false if the ring is empty
+    bool TryPop(T& value)
+    {
+        Cell&       cell     = m_cells[m_head & m_mask];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != m_head + 1)
+        {
+            return false;
+        }
+        value = cell.value;
+        cell.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+    std::size_t Capacity() const { return m_mask + 1; }
+
+  private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T                        value;
+    };
+
+    const std::size_t       m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(kCacheLineSize) std::atomic<std::size_t> m_tail{0};
+    alignas(kCacheLineSize) std::size_t m_head{0};
+};
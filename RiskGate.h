@@ -0,0 +1,163 @@
+#pragma once
+
+#include "ExchangeListener.h"
+#include "IExchange.h"
+#include "SymbolTable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Owner of orders for pre-trade risk. Sessions are bound to accounts, see
+// MyExchange::BindSession; orders of unbound sessions belong to account 0.
+using AccountId = std::uint32_t;
+
+// Limits of one account, 0 disables a limit
+struct RiskLimits
+{
+    // Largest volume of one order
+    Volume max_order_volume{0};
+    // Most orders resting at once
+    std::uint32_t max_open_orders{0};
+    // Largest sum of price * volume resting on one symbol
+    std::uint64_t max_symbol_notional{0};
+    // Furthest a price may be from the touch, in basis points of the touch:
+    // the opposite best price, or the own side's when the opposite is empty
+    std::uint32_t price_band_bps{0};
+};
+
+struct RiskConfig
+{
+    bool enabled{false};
+    // Accounts preallocated, ids 0 .. accounts - 1, each with limits
+    std::size_t accounts{1};
+    RiskLimits  limits;
+};
+
+// Pre-trade limits and the exposure they are checked against: open orders
+// per account and resting notional per account and symbol, in tables sized
+// up front and indexed directly. The exchange updates the exposure as orders
+// rest, fill, change and leave, so a check is a few loads and compares.
+class RiskGate
+{
+  public:
+    explicit RiskGate(const RiskConfig& config = RiskConfig())
+        : m_enabled(config.enabled),
+          m_accounts(config.enabled ? (config.accounts == 0 ? 1 : config.accounts) : 0, Account{config.limits, 0}),
+          m_stride(0)
+    {
+    }
+
+    bool        Enabled() const { return m_enabled; }
+    std::size_t Accounts() const { return m_accounts.size(); }
+
+    // Grow the notional table to symbol_count symbols, when listing them
+    void ReserveSymbols(std::size_t symbol_count)
+    {
+        if (symbol_count <= m_stride || m_accounts.empty())
+        {
+            return;
+        }
+        std::size_t stride = m_stride == 0 ? 16 : m_stride;
+        while (stride < symbol_count)
+        {
+            stride *= 2;
+        }
+        std::vector<std::uint64_t> notional(m_accounts.size() * stride, 0);
+        for (std::size_t account = 0; account < m_accounts.size(); ++account)
+        {
+            for (std::size_t symbol = 0; symbol < m_stride; ++symbol)
+            {
+                notional[account * stride + symbol] = m_notional[account * m_stride + symbol];
+            }
+        }
+        m_notional.swap(notional);
+        m_stride = stride;
+    }
+
+    // False if the account does not exist
+    bool SetLimits(AccountId account, const RiskLimits& limits)
+    {
+        if (account >= m_accounts.size())
+        {
+            return false;
+        }
+        m_accounts[account].limits = limits;
+        return true;
+    }
+
+    RiskError CheckInsert(AccountId account, SymbolId symbol, Price price, Volume volume, Price touch) const
+    {
+        const Account& owner = m_accounts[account];
+        if (owner.limits.max_open_orders != 0 && owner.open_orders >= owner.limits.max_open_orders)
+        {
+            return RiskError::OpenOrders;
+        }
+        return Check(owner, Notional(account, symbol), price, volume, touch);
+    }
+
+    // Same for a resting order of notional moving to price and volume
+    RiskError CheckAmend(
+        AccountId account, SymbolId symbol, std::uint64_t notional, Price price, Volume volume, Price touch) const
+    {
+        return Check(m_accounts[account], Notional(account, symbol) - notional, price, volume, touch);
+    }
+
+    // An order of notional starts or stops resting
+    void Open(AccountId account, SymbolId symbol, std::uint64_t notional)
+    {
+        ++m_accounts[account].open_orders;
+        m_notional[account * m_stride + symbol] += notional;
+    }
+    void Close(AccountId account, SymbolId symbol, std::uint64_t notional)
+    {
+        --m_accounts[account].open_orders;
+        m_notional[account * m_stride + symbol] -= notional;
+    }
+    // A resting order changed price or volume, or was partly filled
+    void Change(AccountId account, SymbolId symbol, std::uint64_t from, std::uint64_t to)
+    {
+        m_notional[account * m_stride + symbol] += to - from;
+    }
+
+    std::uint32_t OpenOrders(AccountId account) const { return m_accounts[account].open_orders; }
+    std::uint64_t Notional(AccountId account, SymbolId symbol) const
+    {
+        return m_notional[account * m_stride + symbol];
+    }
+
+  private:
+    struct Account
+    {
+        RiskLimits    limits;
+        std::uint32_t open_orders;
+    };
+
+    static RiskError Check(const Account& owner, std::uint64_t resting, Price price, Volume volume, Price touch)
+    {
+        const RiskLimits& limits = owner.limits;
+        if (limits.max_order_volume != 0 && volume > limits.max_order_volume)
+        {
+            return RiskError::OrderVolume;
+        }
+        if (limits.max_symbol_notional != 0 && resting + std::uint64_t(price) * volume > limits.max_symbol_notional)
+        {
+            return RiskError::SymbolNotional;
+        }
+        if (limits.price_band_bps != 0 && touch != 0)
+        {
+            std::uint64_t distance = price > touch ? price - touch : touch - price;
+            if (distance * 10000 > std::uint64_t(touch) * limits.price_band_bps)
+            {
+                return RiskError::PriceBand;
+            }
+        }
+        return RiskError::OK;
+    }
+
+    bool                 m_enabled;
+    std::vector<Account> m_accounts;
+    // Resting notional, indexed by account * m_stride + symbol
+    std::vector<std::uint64_t> m_notional;
+    std::size_t                m_stride;
+};
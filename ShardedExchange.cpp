@@ -0,0 +1,199 @@
+#include "ShardedExchange.h"
+
+namespace {
+
+// Upper bound on commands handed to ProcessBatch at once
+constexpr std::size_t kMaxBatch = 256;
+
+}  // namespace
+
+ShardedExchange::ShardedExchange(const ExchangeConfig& config, std::size_t shards, std::size_t ring_capacity)
+    : m_running(true)
+{
+    std::vector<SymbolParams> universe = ListedSymbols(config);
+    if (shards > universe.size())
+    {
+        shards = universe.size();
+    }
+    if (shards == 0)
+    {
+        shards = 1;
+    }
+
+    // Deal symbols round-robin, each shard lists only its own
+    std::vector<ExchangeConfig> shard_configs(shards, config);
+    for (std::size_t s = 0; s < shards; ++s)
+    {
+        shard_configs[s].symbols.clear();
+        shard_configs[s].symbol_file.clear();
+        // Every shard journals its own books
+        if (!config.journal_file.empty())
+        {
+            shard_configs[s].journal_file = config.journal_file + "." + std::to_string(s);
+        }
+    }
+    for (std::size_t i = 0; i < universe.size(); ++i)
+    {
+        shard_configs[i % shards].symbols.push_back(universe[i]);
+    }
+
+    for (std::size_t s = 0; s < shards; ++s)
+    {
+        m_shards.push_back(std::make_unique<Shard>(shard_configs[s], ring_capacity));
+        MyExchange& exchange = m_shards[s]->exchange;
+
+        exchange.OnOrderInserted = [this, s](UserReference userReference, InsertError error, OrderId orderId) {
+            if (IExchange::OnOrderInserted)
+            {
+                IExchange::OnOrderInserted(userReference, error, error == InsertError::OK ? GlobalId(s, orderId) : 0);
+            }
+        };
+        exchange.OnOrderDeleted = [this, s](OrderId orderId, DeleteError error) {
+            if (IExchange::OnOrderDeleted)
+            {
+                IExchange::OnOrderDeleted(GlobalId(s, orderId), error);
+            }
+        };
+        exchange.OnOrderAmended = [this, s](OrderId orderId, AmendError error) {
+            if (OnOrderAmended)
+            {
+                OnOrderAmended(GlobalId(s, orderId), error);
+            }
+        };
+        exchange.OnBestPriceChanged = [this](const std::string& symbol, Price bestBid, Volume totalBidVolume,
+                                             Price bestAsk, Volume totalAskVolume) {
+            if (IExchange::OnBestPriceChanged)
+            {
+                IExchange::OnBestPriceChanged(symbol, bestBid, totalBidVolume, bestAsk, totalAskVolume);
+            }
+        };
+        exchange.OnTrade = [this, s](const std::string& symbol, OrderId aggressorId, OrderId restingId, Price price,
+                                     Volume volume) {
+            if (OnTrade)
+            {
+                OnTrade(symbol, GlobalId(s, aggressorId), GlobalId(s, restingId), price, volume);
+            }
+        };
+    }
+
+    m_symbols.Reserve(universe.size());
+    for (std::size_t i = 0; i < universe.size(); ++i)
+    {
+        m_symbols.Intern(universe[i].symbol);
+        std::uint32_t shard = std::uint32_t(i % shards);
+        m_routes.push_back(Route{shard, m_shards[shard]->exchange.FindSymbol(universe[i].symbol)});
+    }
+
+    // Workers start last, once every shard and route is in place
+    for (std::unique_ptr<Shard>& shard : m_shards)
+    {
+        Shard* owned  = shard.get();
+        shard->worker = std::thread([this, owned] { Run(*owned); });
+    }
+}
+
+ShardedExchange::~ShardedExchange()
+{
+    m_running.store(false, std::memory_order_release);
+    for (std::unique_ptr<Shard>& shard : m_shards)
+    {
+        shard->worker.join();
+    }
+}
+
+void ShardedExchange::InsertOrder(
+    const std::string& symbol, Side side, Price price, Volume volume, UserReference userReference)
+{
+    SymbolId id = m_symbols.Find(symbol);
+    if (id == kInvalidSymbol)
+    {
+        if (IExchange::OnOrderInserted)
+        {
+            IExchange::OnOrderInserted(userReference, InsertError::SymbolNotFound, 0);
+        }
+        return;
+    }
+
+    const Route& route = m_routes[id];
+    Submit(*m_shards[route.shard], OrderCommand::Insert(route.symbol, side, price, volume, userReference));
+}
+
+void ShardedExchange::DeleteOrder(OrderId orderId)
+{
+    // Local ids start at 1, so smaller global ids were never issued
+    OrderId shards = OrderId(m_shards.size());
+    if (orderId < shards)
+    {
+        if (IExchange::OnOrderDeleted)
+        {
+            IExchange::OnOrderDeleted(orderId, DeleteError::OrderNotFound);
+        }
+        return;
+    }
+
+    Submit(*m_shards[orderId % shards], OrderCommand::Delete(orderId / shards));
+}
+
+void ShardedExchange::AmendOrder(OrderId orderId, Price price, Volume volume)
+{
+    OrderId shards = OrderId(m_shards.size());
+    if (orderId < shards)
+    {
+        if (OnOrderAmended)
+        {
+            OnOrderAmended(orderId, AmendError::OrderNotFound);
+        }
+        return;
+    }
+
+    Submit(*m_shards[orderId % shards], OrderCommand::Amend(orderId / shards, price, volume));
+}
+
+void ShardedExchange::Drain()
+{
+    for (std::unique_ptr<Shard>& shard : m_shards)
+    {
+        std::uint64_t submitted = shard->submitted.load(std::memory_order_acquire);
+        while (shard->processed.load(std::memory_order_acquire) < submitted)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ShardedExchange::Submit(Shard& shard, const OrderCommand& command)
+{
+    shard.submitted.fetch_add(1, std::memory_order_relaxed);
+    // Back pressure, wait for the worker to make room
+    while (!shard.commands.TryPush(command))
+    {
+        std::this_thread::yield();
+    }
+}
+
+void ShardedExchange::Run(Shard& shard)
+{
+    OrderCommand batch[kMaxBatch];
+    for (;;)
+    {
+        std::size_t count = 0;
+        while (count < kMaxBatch && shard.commands.TryPop(batch[count]))
+        {
+            ++count;
+        }
+
+        if (count == 0)
+        {
+            // Stop only once the ring has been drained
+            if (!m_running.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        shard.exchange.ProcessBatch(batch, count);
+        shard.processed.fetch_add(count, std::memory_order_release);
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "IExchange.h"
+#include "MyExchange.h"
+#include "RingBuffer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Exchange that partitions the listed symbols round-robin across worker
+// threads. Each worker owns a MyExchange holding only its symbols' books, so
+// nothing is shared between books of different shards. Ingress threads hand
+// commands to the owning worker through its lock-free MPSC ring, and workers
+// run them in batches through MyExchange::ProcessBatch.
+//
+// Order ids encode their shard as localId * ShardCount() + shard, so
+// DeleteOrder is routed without any global lookup.
+//
+// InsertOrder and DeleteOrder may be called from any number of threads and
+// return once the command is queued. Callbacks run on the worker owning the
+// symbol, so they are ordered per symbol but handlers must be thread safe.
+// Unknown symbols and order ids that cannot have been issued are rejected on
+// the calling thread.
+class ShardedExchange : public IExchange
+{
+  public:
+    ShardedExchange(const ExchangeConfig& config, std::size_t shards, std::size_t ring_capacity = 1 << 16);
+    ~ShardedExchange();
+
+    virtual void InsertOrder(
+        const std::string& symbol, Side side, Price price, Volume volume, UserReference userReference) override;
+    virtual void DeleteOrder(OrderId orderId) override;
+
+    // Routed like DeleteOrder, see MyExchange::AmendOrder
+    void AmendOrder(OrderId orderId, Price price, Volume volume);
+
+    // Block until every command queued so far has been processed
+    void Drain();
+
+    std::size_t ShardCount() const { return m_shards.size(); }
+
+    // Same as MyExchange::OnTrade and OnOrderAmended, with global order ids
+    MyExchange::TradeFunction        OnTrade;
+    MyExchange::OrderAmendedFunction OnOrderAmended;
+
+  private:
+    struct Shard
+    {
+        Shard(const ExchangeConfig& config, std::size_t ring_capacity) : exchange(config), commands(ring_capacity) {}
+
+        MyExchange             exchange;
+        MpscRing<OrderCommand> commands;
+        // Commands queued and processed, compared by Drain
+        alignas(kCacheLineSize) std::atomic<std::uint64_t> submitted{0};
+        alignas(kCacheLineSize) std::atomic<std::uint64_t> processed{0};
+        std::thread worker;
+    };
+
+    // Where the books of a symbol live
+    struct Route
+    {
+        std::uint32_t shard;
+        SymbolId      symbol;
+    };
+
+    OrderId GlobalId(std::size_t shard, OrderId localId) const
+    {
+        return OrderId(localId * OrderId(m_shards.size()) + OrderId(shard));
+    }
+
+    void Submit(Shard& shard, const OrderCommand& command);
+    void Run(Shard& shard);
+
+    // Global symbol names, read concurrently by ingress threads
+    SymbolTable        m_symbols;
+    std::vector<Route> m_routes;
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<bool>                   m_running;
+};
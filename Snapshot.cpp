@@ -0,0 +1,55 @@
+#include "Snapshot.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+void SnapshotWriter::Write(const void* data, std::size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    while (size > 0)
+    {
+        if (m_used == sizeof(m_buffer))
+        {
+            Drain();
+        }
+        std::size_t chunk = sizeof(m_buffer) - m_used;
+        if (chunk > size)
+        {
+            chunk = size;
+        }
+        std::memcpy(m_buffer + m_used, bytes, chunk);
+        m_used += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+bool SnapshotWriter::Finish()
+{
+    Drain();
+    if (m_ok && ::fsync(m_fd) != 0)
+    {
+        m_ok = false;
+    }
+    return m_ok;
+}
+
+void SnapshotWriter::Drain()
+{
+    std::size_t written = 0;
+    while (m_ok && written < m_used)
+    {
+        ssize_t result = ::write(m_fd, m_buffer + written, m_used - written);
+        if (result < 0 && errno != EINTR)
+        {
+            m_ok = false;
+        }
+        else if (result > 0)
+        {
+            written += std::size_t(result);
+        }
+    }
+    m_used = 0;
+}
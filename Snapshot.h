@@ -0,0 +1,76 @@
+#pragma once
+
+#include "IExchange.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout of a book snapshot, see MyExchange::SaveSnapshot. The image
+// is a SnapshotHeader followed, for every symbol in SymbolId order, by one
+// SnapshotSymbol and its resting orders. Orders of one price level are stored
+// in FIFO order, so appending them in file order rebuilds every queue.
+
+constexpr char          kSnapshotMagic[8] = {'T', 'X', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr std::uint32_t kSnapshotVersion  = 2;
+
+struct SnapshotHeader
+{
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t symbol_count;
+    std::uint64_t order_count;
+    // Journal records already reflected in the books, replay resumes there
+    std::uint64_t journal_records;
+    OrderId       next_order_id;
+    std::uint32_t reserved;
+};
+
+struct SnapshotSymbol
+{
+    // Nul terminated
+    char          name[32];
+    Price         tick_size;
+    Price         min_price;
+    Price         max_price;
+    std::uint32_t halted;
+    std::uint64_t order_count;
+    std::uint64_t reserved;
+};
+
+struct SnapshotOrder
+{
+    OrderId       order_id;
+    UserReference userReference;
+    Price         price;
+    Volume        volume;
+    std::uint32_t session;
+    std::uint8_t  side;
+    std::uint8_t  reserved[3];
+};
+
+static_assert(sizeof(SnapshotHeader) == 40, "snapshot header layout");
+static_assert(sizeof(SnapshotSymbol) == 64, "snapshot symbol layout");
+static_assert(sizeof(SnapshotOrder) == 24, "snapshot order layout");
+
+// Buffered writes straight to a file descriptor. Nothing is allocated, so it
+// is safe to use in a forked child of a multithreaded process.
+class SnapshotWriter
+{
+  public:
+    explicit SnapshotWriter(int fd) : m_fd(fd), m_used(0), m_ok(true) {}
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    void Write(const void* data, std::size_t size);
+    // Write out the buffer and fsync, false if any write failed
+    bool Finish();
+
+  private:
+    void Drain();
+
+    int           m_fd;
+    std::size_t   m_used;
+    bool          m_ok;
+    unsigned char m_buffer[1 << 16];
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using Symbol = std::string;
+
+// Small dense integer naming a symbol, also the index of its order book
+using SymbolId = std::uint32_t;
+
+constexpr SymbolId kInvalidSymbol = UINT32_MAX;
+
+// Interns symbol names into dense SymbolIds. Lookup by name is an
+// open-addressing hash table with linear probing that stores ids only; the
+// cached hash of each id is compared before the string itself.
+class SymbolTable
+{
+  public:
+    SymbolTable() : m_slots(16, kInvalidSymbol) {}
+
+    // Returns kInvalidSymbol if name was never interned
+    SymbolId Find(const std::string& name) const
+    {
+        std::uint64_t hash = Hash(name);
+        std::size_t   mask = m_slots.size() - 1;
+        for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask)
+        {
+            SymbolId id = m_slots[slot];
+            if (id == kInvalidSymbol)
+            {
+                return kInvalidSymbol;
+            }
+            if (m_hashes[id] == hash && m_names[id] == name)
+            {
+                return id;
+            }
+        }
+    }
+
+    // Returns the id of name, assigning the next free id the first time
+    SymbolId Intern(const std::string& name)
+    {
+        SymbolId id = Find(name);
+        if (id != kInvalidSymbol)
+        {
+            return id;
+        }
+        // Keep the load factor at or below one half
+        if ((m_names.size() + 1) * 2 > m_slots.size())
+        {
+            Rehash(m_slots.size() * 2);
+        }
+        id = SymbolId(m_names.size());
+        m_names.push_back(name);
+        m_hashes.push_back(Hash(name));
+        Place(id);
+        return id;
+    }
+
+    const Symbol& Name(SymbolId id) const { return m_names[id]; }
+    std::size_t   Size() const { return m_names.size(); }
+
+    void Reserve(std::size_t symbols)
+    {
+        std::size_t slots = m_slots.size();
+        while (symbols * 2 > slots)
+        {
+            slots *= 2;
+        }
+        if (slots != m_slots.size())
+        {
+            Rehash(slots);
+        }
+        m_names.reserve(symbols);
+        m_hashes.reserve(symbols);
+    }
+
+  private:
+    // FNV-1a, symbols are short so this beats anything fancier
+    static std::uint64_t Hash(const std::string& name)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : name)
+        {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    void Place(SymbolId id)
+    {
+        std::size_t mask = m_slots.size() - 1;
+        std::size_t slot = m_hashes[id] & mask;
+        while (m_slots[slot] != kInvalidSymbol)
+        {
+            slot = (slot + 1) & mask;
+        }
+        m_slots[slot] = id;
+    }
+
+    void Rehash(std::size_t slots)
+    {
+        m_slots.assign(slots, kInvalidSymbol);
+        for (SymbolId id = 0; id < m_names.size(); ++id)
+        {
+            Place(id);
+        }
+    }
+
+    std::vector<Symbol>        m_names;
+    std::vector<std::uint64_t> m_hashes;
+    // Power of two sized, kInvalidSymbol marks an empty slot
+    std::vector<SymbolId> m_slots;
+};
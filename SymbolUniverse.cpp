@@ -0,0 +1,80 @@
+#include "SymbolUniverse.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+unsigned long ParseField(const std::string& field, unsigned long limit)
+{
+    std::size_t   used  = 0;
+    unsigned long value = std::stoul(field, &used);
+    if (used != field.size() || field[0] == '-')
+    {
+        throw std::invalid_argument(field);
+    }
+    if (value > limit)
+    {
+        throw std::out_of_range(field);
+    }
+    return value;
+}
+
+}  // namespace
+
+std::vector<SymbolParams> LoadSymbolUniverse(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open symbol universe " + path);
+    }
+
+    std::vector<SymbolParams> universe;
+    std::string               line;
+    for (int line_no = 1; std::getline(file, line); ++line_no)
+    {
+        std::istringstream       stream(line);
+        std::vector<std::string> fields;
+        for (std::string field; stream >> field;)
+        {
+            fields.push_back(field);
+        }
+        if (fields.empty() || fields[0][0] == '#')
+        {
+            continue;
+        }
+
+        SymbolParams params;
+        params.symbol = fields[0];
+        bool ok       = fields.size() != 3 && fields.size() <= 5;
+        try
+        {
+            if (ok && fields.size() > 1)
+            {
+                params.tick_size = Price(ParseField(fields[1], std::numeric_limits<Price>::max()));
+            }
+            if (ok && fields.size() > 3)
+            {
+                params.min_price = Price(ParseField(fields[2], std::numeric_limits<Price>::max()));
+                params.max_price = Price(ParseField(fields[3], std::numeric_limits<Price>::max()));
+            }
+            if (ok && fields.size() > 4)
+            {
+                params.expected_depth = ParseField(fields[4], std::numeric_limits<std::size_t>::max());
+            }
+        }
+        catch (const std::logic_error&)
+        {
+            ok = false;
+        }
+
+        if (!ok || params.tick_size == 0 || params.min_price == 0 || params.min_price > params.max_price)
+        {
+            throw std::runtime_error("Malformed symbol universe " + path + ":" + std::to_string(line_no));
+        }
+        universe.push_back(params);
+    }
+    return universe;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "IExchange.h"
+#include "SymbolTable.h"
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Trading parameters of one listed symbol
+struct SymbolParams
+{
+    Symbol symbol;
+    // Prices must be a multiple of the tick size
+    Price tick_size{1};
+    // Inclusive price band, orders outside it are rejected with InvalidPrice
+    Price min_price{1};
+    Price max_price{std::numeric_limits<Price>::max()};
+    // Number of resting orders expected on the book, presizes the order arena
+    std::size_t expected_depth{0};
+};
+
+// Reads a symbol universe file. Each non-empty line not starting with '#' is
+//
+//     SYMBOL [TICK_SIZE [MIN_PRICE MAX_PRICE [EXPECTED_DEPTH]]]
+//
+// with whitespace separated fields, omitted fields keep their defaults.
+// Throws std::runtime_error if the file cannot be read or a line is malformed.
+std::vector<SymbolParams> LoadSymbolUniverse(const std::string& path);
@@ -1,12 +1,36 @@
 #include "IExchange.h"
+#include "BookThread.h"
+#include "Conflation.h"
+#include "DifferentialFuzz.h"
+#include "Gateway.h"
+#include "LatencyHistogram.h"
 #define BOOST_TEST_MODULE YourExchange test
 #include <boost/test/included/unit_test.hpp>
 // Please use a meaningful name here, ie.
 #include "MyExchange.h"
+#include "MyExchangeImpl.h"
+#include "ShardedExchange.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
 #include <tuple>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 namespace Tibra {
 namespace Exchange {
 namespace Test {
+using std::placeholders::_1;
+using std::placeholders::_2;
+using std::placeholders::_3;
+using std::placeholders::_4;
+using std::placeholders::_5;
+
 /// This class sets up the necessary prerequisites for a unit test
 class ExchangeFixtures
 {
@@ -45,11 +69,6 @@ class ExchangeFixtures
 };
 ExchangeFixtures::ExchangeFixtures()
 {
-    using std::placeholders::_1;
-    using std::placeholders::_2;
-    using std::placeholders::_3;
-    using std::placeholders::_4;
-    using std::placeholders::_5;
     // OrderInserted events are logged to a std::vector for later checking
     mExchange.OnOrderInserted = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
 
@@ -473,6 +492,1722 @@ BOOST_AUTO_TEST_CASE(TestComplexMultipleOrdersSamePriceLevel)
     BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[9]), DeleteError::OrderNotFound);
 }
 
+BOOST_AUTO_TEST_CASE(TestFixedOrderPoolExhausted)
+{
+    ExchangeConfig config;
+    config.order_pool.capacity   = 2;
+    config.order_pool.chunk_size = 2;
+    config.order_pool.growth     = PoolGrowth::Fixed;
+    MyExchange exchange(config);
+    exchange.OnOrderInserted = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    exchange.OnOrderDeleted  = std::bind(&ExchangeFixtures::OrderDeletedHandler, this, _1, _2);
+
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 2);
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 3);
+
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 3);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[0]), InsertError::OK);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[1]), InsertError::OK);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[2]), InsertError::SystemError);
+
+    // Deleting an order gives its record back to the arena
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[0]));
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 4);
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 4);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[3]), InsertError::OK);
+}
+
+BOOST_AUTO_TEST_CASE(TestGrowingOrderPoolKeepsFifo)
+{
+    ExchangeConfig config;
+    config.order_pool.capacity   = 2;
+    config.order_pool.chunk_size = 2;
+    config.order_pool.growth     = PoolGrowth::Linear;
+    MyExchange exchange(config);
+    exchange.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    exchange.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+
+    for (UserReference ref = 1; ref <= 5; ++ref)
+    {
+        exchange.InsertOrder("MSFT", Side::Sell, 100, ref, ref);
+    }
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 5);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[4]), InsertError::OK);
+    BOOST_CHECK_EQUAL(std::get<4>(mBestPriceChangedEvents.back()), 15);
+
+    // Remove the middle of the queue, then both ends
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[2]));
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[0]));
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[4]));
+    BOOST_CHECK_EQUAL(std::get<4>(mBestPriceChangedEvents.back()), 6);
+}
+BOOST_AUTO_TEST_CASE(TestDeleteStaleAndUnissuedOrderIds)
+{
+    // Fill more than two pages of the order id table
+    const int orders = 2 * int(OrderIdTable::kPageSize) + 10;
+    for (int ref = 0; ref < orders; ++ref)
+    {
+        mExchange.InsertOrder("GOOG", Side::Buy, 100 + ref % 7, 1, ref);
+    }
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), size_t(orders));
+
+    // Delete every order of the first page so that it is recycled
+    for (int i = 0; i < int(OrderIdTable::kPageSize); ++i)
+    {
+        mExchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[i]));
+    }
+    mOrderDeletedEvents.clear();
+
+    const OrderId lastId = std::get<2>(mOrderInsertedEvents.back());
+    mExchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[0]));
+    mExchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[100]));
+    mExchange.DeleteOrder(0);
+    mExchange.DeleteOrder(-5);
+    mExchange.DeleteOrder(lastId + 1);
+    mExchange.DeleteOrder(lastId + 100000);
+    mExchange.DeleteOrder(lastId);
+
+    BOOST_REQUIRE_EQUAL(mOrderDeletedEvents.size(), 7);
+    for (size_t i = 0; i < 6; ++i)
+    {
+        BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[i]), DeleteError::OrderNotFound);
+    }
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[6]), DeleteError::OK);
+}
+BOOST_AUTO_TEST_CASE(TestLadderFallsBackToTreeAndRecenters)
+{
+    ExchangeConfig config;
+    config.ladder_levels = 64;
+    MyExchange exchange(config);
+    exchange.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    exchange.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+
+    // First order centres the ladder window on 100, 200 and 20 are outside it
+    exchange.InsertOrder("AAPL", Side::Sell, 100, 1, 1);
+    exchange.InsertOrder("AAPL", Side::Sell, 200, 2, 2);
+    exchange.InsertOrder("AAPL", Side::Sell, 120, 3, 3);
+    exchange.InsertOrder("AAPL", Side::Sell, 200, 4, 4);
+    exchange.InsertOrder("AAPL", Side::Sell, 20, 5, 5);
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 5);
+    BOOST_CHECK_EQUAL(std::get<3>(mBestPriceChangedEvents.back()), 20);
+    BOOST_CHECK_EQUAL(std::get<4>(mBestPriceChangedEvents.back()), 5);
+
+    const auto expectBestAsk = [this](Price price, Volume volume) {
+        BOOST_CHECK_EQUAL(std::get<3>(mBestPriceChangedEvents.back()), price);
+        BOOST_CHECK_EQUAL(std::get<4>(mBestPriceChangedEvents.back()), volume);
+    };
+
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[4]));
+    expectBestAsk(100, 1);
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[0]));
+    expectBestAsk(120, 3);
+    // Ladder runs dry and recentres on the tree level at 200
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[2]));
+    expectBestAsk(200, 6);
+    exchange.InsertOrder("AAPL", Side::Sell, 190, 7, 6);
+    expectBestAsk(190, 7);
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[5]));
+    expectBestAsk(200, 6);
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[1]));
+    expectBestAsk(200, 4);
+    exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[3]));
+    expectBestAsk(0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestLadderBidsBestIsHighest)
+{
+    ExchangeConfig config;
+    config.ladder_levels = 256;
+    MyExchange exchange(config);
+    exchange.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    exchange.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+
+    const Price prices[] = {500, 510, 401, 630, 505, 1000};
+    for (Price price : prices)
+    {
+        exchange.InsertOrder("MSFT", Side::Buy, price, 10, 1);
+    }
+    BOOST_CHECK_EQUAL(std::get<1>(mBestPriceChangedEvents.back()), 1000);
+
+    // Delete from the top down, the best bid walks down the ladder
+    const Price expected[] = {630, 510, 505, 500, 401, 0};
+    const size_t order[]   = {5, 3, 1, 4, 0, 2};
+    for (size_t i = 0; i < 6; ++i)
+    {
+        exchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[order[i]]));
+        BOOST_CHECK_EQUAL(std::get<1>(mBestPriceChangedEvents.back()), expected[i]);
+    }
+}
+BOOST_AUTO_TEST_CASE(TestInsertOrderBySymbolId)
+{
+    const SymbolId msft = mExchange.FindSymbol("MSFT");
+    BOOST_REQUIRE(msft != kInvalidSymbol);
+    BOOST_CHECK(mExchange.FindSymbol("INVALID") == kInvalidSymbol);
+
+    mExchange.InsertOrder(msft, Side::Buy, 100, 10, 1);
+    mExchange.InsertOrder(kInvalidSymbol, Side::Buy, 100, 10, 2);
+    mExchange.InsertOrder("MSFT", Side::Buy, 101, 10, 3);
+
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 3);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[0]), InsertError::OK);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[1]), InsertError::SymbolNotFound);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[2]), InsertError::OK);
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 2);
+    BOOST_CHECK_EQUAL(std::get<0>(mBestPriceChangedEvents[0]), "MSFT");
+    BOOST_CHECK_EQUAL(std::get<1>(mBestPriceChangedEvents[1]), 101);
+
+    mExchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[2]));
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 3);
+    BOOST_CHECK_EQUAL(std::get<0>(mBestPriceChangedEvents[2]), "MSFT");
+    BOOST_CHECK_EQUAL(std::get<1>(mBestPriceChangedEvents[2]), 100);
+}
+BOOST_AUTO_TEST_CASE(TestSymbolUniverseFromFile)
+{
+    const char* path = "test_universe.txt";
+    {
+        std::ofstream file(path);
+        file << "# symbol tick min max depth\n"
+             << "ES 25 1000 9000 100\n"
+             << "\n"
+             << "NQ 5\n"
+             << "VX\n";
+    }
+    ExchangeConfig config;
+    config.symbol_file = path;
+    MyExchange exchange(config);
+    std::remove(path);
+    exchange.OnOrderInserted = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+
+    BOOST_CHECK(exchange.FindSymbol("AAPL") == kInvalidSymbol);
+    BOOST_CHECK(exchange.FindSymbol("VX") != kInvalidSymbol);
+
+    exchange.InsertOrder("ES", Side::Buy, 1025, 1, 1);  // on tick, inside band
+    exchange.InsertOrder("ES", Side::Buy, 1030, 1, 2);  // off tick
+    exchange.InsertOrder("ES", Side::Buy, 975, 1, 3);   // below band
+    exchange.InsertOrder("ES", Side::Buy, 9025, 1, 4);  // above band
+    exchange.InsertOrder("NQ", Side::Sell, 12345, 1, 5);
+    exchange.InsertOrder("NQ", Side::Sell, 12346, 1, 6);
+    exchange.InsertOrder("AAPL", Side::Sell, 100, 1, 7);
+
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 7);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[0]), InsertError::OK);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[1]), InsertError::InvalidPrice);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[2]), InsertError::InvalidPrice);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[3]), InsertError::InvalidPrice);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[4]), InsertError::OK);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[5]), InsertError::InvalidPrice);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[6]), InsertError::SymbolNotFound);
+}
+
+BOOST_AUTO_TEST_CASE(TestMalformedSymbolUniverseThrows)
+{
+    const char* path = "test_universe.txt";
+    {
+        std::ofstream file(path);
+        file << "ES 25 1000\n";
+    }
+    BOOST_CHECK_THROW(LoadSymbolUniverse(path), std::runtime_error);
+    std::remove(path);
+    BOOST_CHECK_THROW(LoadSymbolUniverse(path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestAddAndHaltSymbolIntraday)
+{
+    mExchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+
+    SymbolParams params;
+    params.symbol       = "TSLA";
+    const SymbolId tsla = mExchange.AddSymbol(params);
+    BOOST_CHECK(tsla == mExchange.FindSymbol("TSLA"));
+    mExchange.InsertOrder("TSLA", Side::Buy, 200, 10, 2);
+
+    BOOST_CHECK(mExchange.HaltSymbol("AAPL"));
+    BOOST_CHECK(!mExchange.HaltSymbol("INVALID"));
+    mExchange.InsertOrder("AAPL", Side::Buy, 100, 10, 3);
+    mExchange.InsertOrder("TSLA", Side::Buy, 201, 10, 4);
+
+    // A halted order may only shrink in place
+    std::vector<AmendError> amends;
+    mExchange.OnOrderAmended = [&](OrderId, AmendError error) { amends.push_back(error); };
+    const OrderId resting    = std::get<2>(mOrderInsertedEvents[0]);
+    mExchange.AmendOrder(resting, 101, 10);
+    mExchange.AmendOrder(resting, 100, 11);
+    mExchange.AmendOrder(resting, 100, 6);
+    BOOST_REQUIRE_EQUAL(amends.size(), 3);
+    BOOST_CHECK(amends[0] == AmendError::SymbolHalted);
+    BOOST_CHECK(amends[1] == AmendError::SymbolHalted);
+    BOOST_CHECK(amends[2] == AmendError::OK);
+
+    // Resting orders of a halted symbol can still be deleted
+    mExchange.DeleteOrder(std::get<2>(mOrderInsertedEvents[0]));
+    BOOST_CHECK(mExchange.ResumeSymbol("AAPL"));
+    mExchange.InsertOrder("AAPL", Side::Buy, 100, 10, 5);
+
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 5);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[1]), InsertError::OK);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[2]), InsertError::SymbolNotFound);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[3]), InsertError::OK);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[4]), InsertError::OK);
+    BOOST_REQUIRE_EQUAL(mOrderDeletedEvents.size(), 1);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[0]), DeleteError::OK);
+}
+
+BOOST_AUTO_TEST_CASE(TestAddSymbolRejectsInvalidParameters)
+{
+    SymbolParams params;
+    params.symbol    = "TSLA";
+    params.tick_size = 0;
+    BOOST_CHECK(mExchange.AddSymbol(params) == kInvalidSymbol);
+    params.tick_size = 5;
+    params.min_price = 0;
+    BOOST_CHECK(mExchange.AddSymbol(params) == kInvalidSymbol);
+    params.min_price = 200;
+    params.max_price = 100;
+    BOOST_CHECK(mExchange.AddSymbol(params) == kInvalidSymbol);
+    BOOST_CHECK(mExchange.FindSymbol("TSLA") == kInvalidSymbol);
+
+    // Nor is a listed symbol updated with them
+    params.symbol    = "AAPL";
+    params.tick_size = 0;
+    params.min_price = 1;
+    params.max_price = 1000;
+    BOOST_CHECK(mExchange.AddSymbol(params) == kInvalidSymbol);
+    mExchange.InsertOrder("AAPL", Side::Buy, 101, 10, 1);
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 1);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[0]), InsertError::OK);
+
+    ExchangeConfig config;
+    config.symbols.push_back(params);
+    BOOST_CHECK_THROW(MyExchange exchange(config), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(TestMatchingSweepsInPriceTimePriority)
+{
+    ExchangeConfig config;
+    config.matching = true;
+    MyExchange exchange(config);
+    exchange.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    exchange.OnOrderDeleted     = std::bind(&ExchangeFixtures::OrderDeletedHandler, this, _1, _2);
+    exchange.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+
+    using Trade = std::tuple<std::string, OrderId, OrderId, Price, Volume>;
+    std::vector<Trade> trades;
+    exchange.OnTrade = [&trades](const std::string& symbol, OrderId aggressor, OrderId resting, Price price,
+                                 Volume volume) { trades.emplace_back(symbol, aggressor, resting, price, volume); };
+
+    exchange.InsertOrder("AAPL", Side::Sell, 100, 5, 1);
+    exchange.InsertOrder("AAPL", Side::Sell, 101, 4, 2);
+    exchange.InsertOrder("AAPL", Side::Sell, 100, 3, 3);
+    const OrderId ask100a = std::get<2>(mOrderInsertedEvents[0]);
+    const OrderId ask101  = std::get<2>(mOrderInsertedEvents[1]);
+    const OrderId ask100b = std::get<2>(mOrderInsertedEvents[2]);
+    mBestPriceChangedEvents.clear();
+
+    // Fully filled buy sweeps both orders at 100 in time order, then part of 101
+    exchange.InsertOrder("AAPL", Side::Buy, 102, 10, 4);
+    const OrderId buy = std::get<2>(mOrderInsertedEvents[3]);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[3]), InsertError::OK);
+    BOOST_REQUIRE_EQUAL(trades.size(), 3);
+    BOOST_CHECK(trades[0] == Trade("AAPL", buy, ask100a, 100, 5));
+    BOOST_CHECK(trades[1] == Trade("AAPL", buy, ask100b, 100, 3));
+    BOOST_CHECK(trades[2] == Trade("AAPL", buy, ask101, 101, 2));
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 1);
+    BOOST_CHECK(mBestPriceChangedEvents[0] == BestPriceChangedEvent("AAPL", 0, 0, 101, 2));
+
+    // Remainder of a partially filled order rests, still a single update
+    mBestPriceChangedEvents.clear();
+    exchange.InsertOrder("AAPL", Side::Buy, 101, 5, 5);
+    const OrderId rest = std::get<2>(mOrderInsertedEvents[4]);
+    BOOST_REQUIRE_EQUAL(trades.size(), 4);
+    BOOST_CHECK(trades[3] == Trade("AAPL", rest, ask101, 101, 2));
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 1);
+    BOOST_CHECK(mBestPriceChangedEvents[0] == BestPriceChangedEvent("AAPL", 101, 3, 0, 0));
+
+    // Non crossing sell rests
+    exchange.InsertOrder("AAPL", Side::Sell, 102, 1, 6);
+    BOOST_CHECK_EQUAL(trades.size(), 4);
+
+    // Filled orders are gone, the resting remainder can be deleted
+    exchange.DeleteOrder(buy);
+    exchange.DeleteOrder(ask100a);
+    exchange.DeleteOrder(ask101);
+    exchange.DeleteOrder(rest);
+    BOOST_REQUIRE_EQUAL(mOrderDeletedEvents.size(), 4);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[0]), DeleteError::OrderNotFound);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[1]), DeleteError::OrderNotFound);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[2]), DeleteError::OrderNotFound);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[3]), DeleteError::OK);
+}
+BOOST_AUTO_TEST_CASE(TestBatchCoalescesBestPriceChanges)
+{
+    const SymbolId aapl = mExchange.FindSymbol("AAPL");
+    const SymbolId msft = mExchange.FindSymbol("MSFT");
+
+    std::vector<OrderCommand> batch;
+    for (UserReference ref = 0; ref < 500; ++ref)
+    {
+        batch.push_back(OrderCommand::Insert(aapl, Side::Buy, 100 + Price(ref), 1, ref));
+    }
+    batch.push_back(OrderCommand::Insert(msft, Side::Sell, 50, 7, 500));
+    batch.push_back(OrderCommand::Insert(kInvalidSymbol, Side::Sell, 50, 7, 501));
+    // Order ids are handed out from 1, so this removes the best AAPL bid
+    batch.push_back(OrderCommand::Delete(500));
+    batch.push_back(OrderCommand::Delete(9999));
+    mExchange.ProcessBatch(batch.data(), batch.size());
+
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 502);
+    for (UserReference ref = 0; ref < 502; ++ref)
+    {
+        BOOST_CHECK_EQUAL(std::get<0>(mOrderInsertedEvents[ref]), ref);
+    }
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents[501]), InsertError::SymbolNotFound);
+    BOOST_REQUIRE_EQUAL(mOrderDeletedEvents.size(), 2);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[0]), DeleteError::OK);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents[1]), DeleteError::OrderNotFound);
+
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 2);
+    BOOST_CHECK(mBestPriceChangedEvents[0] == BestPriceChangedEvent("AAPL", 598, 1, 0, 0));
+    BOOST_CHECK(mBestPriceChangedEvents[1] == BestPriceChangedEvent("MSFT", 0, 0, 50, 7));
+
+    // Outside a batch every change is reported immediately again
+    mExchange.InsertOrder("AAPL", Side::Buy, 700, 1, 600);
+    BOOST_CHECK_EQUAL(mBestPriceChangedEvents.size(), 3);
+}
+BOOST_AUTO_TEST_CASE(TestShardedExchangeRoutesAcrossWorkers)
+{
+    ExchangeConfig config;
+    for (const char* symbol : {"S0", "S1", "S2", "S3", "S4", "S5", "S6", "S7"})
+    {
+        config.symbols.emplace_back();
+        config.symbols.back().symbol = symbol;
+    }
+    ShardedExchange exchange(config, 3, 64);
+    BOOST_REQUIRE_EQUAL(exchange.ShardCount(), 3);
+
+    std::mutex                                 mutex;
+    std::map<std::string, std::vector<Price>> bestBids;
+    exchange.OnOrderInserted = [&](UserReference userReference, InsertError insertError, OrderId orderId) {
+        std::lock_guard<std::mutex> lock(mutex);
+        OrderInsertedHandler(userReference, insertError, orderId);
+    };
+    exchange.OnOrderDeleted = [&](OrderId orderId, DeleteError deleteError) {
+        std::lock_guard<std::mutex> lock(mutex);
+        OrderDeletedHandler(orderId, deleteError);
+    };
+    exchange.OnBestPriceChanged = [&](const std::string& symbol, Price bestBid, Volume, Price, Volume) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bestBids[symbol].push_back(bestBid);
+    };
+
+    // Each thread raises the bid on its own pair of symbols
+    const int                perThread = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&exchange, t] {
+            for (int i = 1; i <= perThread; ++i)
+            {
+                exchange.InsertOrder("S" + std::to_string(2 * t + i % 2), Side::Buy, Price(i), 1, t);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    exchange.InsertOrder("INVALID", Side::Buy, 1, 1, -1);
+    exchange.Drain();
+
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), size_t(4 * perThread + 1));
+    std::set<OrderId> ids;
+    for (const OrderInsertedEvent& event : mOrderInsertedEvents)
+    {
+        if (std::get<1>(event) == InsertError::OK)
+        {
+            ids.insert(std::get<2>(event));
+        }
+    }
+    BOOST_CHECK_EQUAL(ids.size(), size_t(4 * perThread));
+
+    // Updates of one symbol arrive in the order its orders were queued
+    BOOST_REQUIRE_EQUAL(bestBids.size(), 8);
+    for (const auto& entry : bestBids)
+    {
+        for (size_t i = 1; i < entry.second.size(); ++i)
+        {
+            BOOST_CHECK_LT(entry.second[i - 1], entry.second[i]);
+        }
+    }
+
+    for (OrderId id : ids)
+    {
+        exchange.DeleteOrder(id);
+    }
+    exchange.DeleteOrder(*ids.begin());
+    exchange.DeleteOrder(1);
+    exchange.DeleteOrder(-7);
+    exchange.Drain();
+    BOOST_REQUIRE_EQUAL(mOrderDeletedEvents.size(), ids.size() + 3);
+    size_t deleted = 0;
+    for (const OrderDeletedEvent& event : mOrderDeletedEvents)
+    {
+        deleted += std::get<1>(event) == DeleteError::OK;
+    }
+    BOOST_CHECK_EQUAL(deleted, ids.size());
+}
+BOOST_AUTO_TEST_CASE(TestBookThreadPublishesEventsInOrder)
+{
+    for (WaitStrategy strategy : {WaitStrategy::BusySpin, WaitStrategy::Yield, WaitStrategy::Futex})
+    {
+        BookThreadConfig config;
+        config.command_capacity = 64;
+        config.event_capacity   = 64;
+        config.book_wait        = strategy;
+        config.consumer_wait    = strategy;
+        BookThread book(ExchangeConfig(), config);
+
+        const SymbolId aapl   = book.FindSymbol("AAPL");
+        const int      orders = 2000;
+
+        // Consumer thread collects every event while the gateway submits
+        std::vector<ExchangeEvent> events;
+        std::thread                consumer([&] {
+            // Best price updates are coalesced per batch, so count acks only
+            for (int acks = 0; acks < 2 * orders;)
+            {
+                ExchangeEvent event;
+                book.Poll(event);
+                events.push_back(event);
+                acks += event.type != ExchangeEvent::Type::BestPriceChanged;
+            }
+        });
+        for (int i = 0; i < orders; ++i)
+        {
+            book.Submit(OrderCommand::Insert(aapl, Side::Buy, Price(i + 1), 1, i));
+        }
+        for (int i = orders; i > 0; --i)
+        {
+            book.Submit(OrderCommand::Delete(i));
+        }
+        consumer.join();
+
+        int inserted = 0;
+        int deleted  = 0;
+        for (const ExchangeEvent& event : events)
+        {
+            if (event.type == ExchangeEvent::Type::OrderInserted)
+            {
+                BOOST_CHECK_EQUAL(event.userReference, inserted);
+                BOOST_CHECK_EQUAL(event.orderId, inserted + 1);
+                ++inserted;
+            }
+            else if (event.type == ExchangeEvent::Type::OrderDeleted)
+            {
+                BOOST_CHECK_EQUAL(event.orderId, orders - deleted);
+                BOOST_CHECK_EQUAL(event.deleteError, DeleteError::OK);
+                ++deleted;
+            }
+            else
+            {
+                BOOST_CHECK(event.type == ExchangeEvent::Type::BestPriceChanged);
+                BOOST_CHECK_EQUAL(book.SymbolName(event.symbol), "AAPL");
+            }
+        }
+        BOOST_CHECK_EQUAL(inserted, orders);
+        BOOST_CHECK_EQUAL(deleted, orders);
+        // The final update of the last batch trails the last ack
+        ExchangeEvent last;
+        book.Poll(last);
+        BOOST_CHECK(last.type == ExchangeEvent::Type::BestPriceChanged);
+        BOOST_CHECK_EQUAL(last.bestBid, 0);
+        BOOST_CHECK(!book.TryPoll(last));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestLatencyHistogramPercentiles)
+{
+    LatencyHistogram histogram;
+    for (std::uint64_t value = 1; value <= 10000; ++value)
+    {
+        histogram.Record(value);
+    }
+    BOOST_CHECK_EQUAL(histogram.Count(), 10000u);
+    BOOST_CHECK_EQUAL(histogram.Max(), 10000u);
+    // Buckets are within ~3% of the recorded values
+    BOOST_CHECK_CLOSE(double(histogram.Percentile(0.50)), 5000.0, 3.5);
+    BOOST_CHECK_CLOSE(double(histogram.Percentile(0.99)), 9900.0, 3.5);
+    BOOST_CHECK_EQUAL(histogram.Percentile(1.0), 10000u);
+
+    // Small values are exact and every value maps to the bucket bounding it
+    BOOST_CHECK_EQUAL(LatencyHistogram::UpperBoundOf(LatencyHistogram::BucketOf(17)), 17u);
+    for (std::uint64_t value : {63ull, 64ull, 1000ull, 123456789ull, ~0ull})
+    {
+        BOOST_CHECK_GE(LatencyHistogram::UpperBoundOf(LatencyHistogram::BucketOf(value)), value);
+        BOOST_CHECK_LT(LatencyHistogram::BucketOf(value), LatencyHistogram::kBuckets);
+    }
+
+    LatencyHistogram other;
+    other.Record(20000);
+    histogram.Merge(other);
+    BOOST_CHECK_EQUAL(histogram.Count(), 10001u);
+    BOOST_CHECK_EQUAL(histogram.Max(), 20000u);
+}
+
+BOOST_AUTO_TEST_CASE(TestJournalReplayReproducesBooksAndCallbacks)
+{
+    const char* path = "test_journal.bin";
+    std::remove(path);
+    ExchangeConfig config;
+    config.matching     = true;
+    config.journal_file = path;
+
+    OrderInsertedEvents    live_inserted;
+    OrderDeletedEvents     live_deleted;
+    BestPriceChangedEvents live_best;
+    {
+        MyExchange exchange(config);
+        exchange.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+        exchange.OnOrderDeleted     = std::bind(&ExchangeFixtures::OrderDeletedHandler, this, _1, _2);
+        exchange.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+
+        exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+        exchange.InsertOrder("AAPL", Side::Buy, 101, 5, 2);
+        exchange.InsertOrder("MSFT", Side::Sell, 200, 7, 3);
+        exchange.DeleteOrder(1);
+        exchange.AmendOrder(2, 101, 4);
+        const SymbolId aapl = exchange.FindSymbol("AAPL");
+        std::vector<OrderCommand> batch{OrderCommand::Insert(aapl, Side::Sell, 101, 3, 4),
+                                        OrderCommand::Insert(aapl, Side::Sell, 105, 2, 5),
+                                        OrderCommand::Delete(3)};
+        exchange.ProcessBatch(batch.data(), batch.size());
+        exchange.InsertOrder("AAPL", Side::Sell, 99, 4, 6);
+        exchange.InsertOrder(aapl, Side::Buy, 90, 2, 7, 3);
+        exchange.MassCancel(MassCancelFilter::Session(3));
+
+        live_inserted.swap(mOrderInsertedEvents);
+        live_deleted.swap(mOrderDeletedEvents);
+        live_best.swap(mBestPriceChangedEvents);
+    }
+
+    // A fresh process rebuilds the same books from the journal
+    MyExchange replayed(config);
+    replayed.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    replayed.OnOrderDeleted     = std::bind(&ExchangeFixtures::OrderDeletedHandler, this, _1, _2);
+    replayed.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+    // 7 inserts, 2 deletes, an amend, the end of the batch and a mass cancel
+    BOOST_CHECK_EQUAL(replayed.Replay(), 12u);
+    BOOST_CHECK(mOrderInsertedEvents == live_inserted);
+    BOOST_CHECK(mOrderDeletedEvents == live_deleted);
+    BOOST_CHECK(mBestPriceChangedEvents == live_best);
+
+    // New orders continue the id sequence and the resting order 2 was filled
+    replayed.InsertOrder("AAPL", Side::Buy, 50, 1, 8);
+    BOOST_CHECK_EQUAL(std::get<2>(mOrderInsertedEvents.back()), 8);
+    replayed.DeleteOrder(2);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents.back()), DeleteError::OrderNotFound);
+    replayed.DeleteOrder(7);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents.back()), DeleteError::OrderNotFound);
+    replayed.DeleteOrder(8);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderDeletedEvents.back()), DeleteError::OK);
+
+    // A journal of another universe is refused
+    ExchangeConfig other = config;
+    other.symbols.emplace_back();
+    other.symbols.back().symbol = "ES";
+    MyExchange mismatched(other);
+    BOOST_CHECK_THROW(mismatched.Replay(), std::runtime_error);
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestJournalReplaysHaltsAndListings)
+{
+    const char* path = "test_journal.bin";
+    std::remove(path);
+    ExchangeConfig config;
+    config.journal_file = path;
+
+    SymbolParams listed;
+    listed.symbol    = "A_SYMBOL_NAME_LONGER_THAN_ONE_RECORD";
+    listed.tick_size = 5;
+    SymbolParams coarser;
+    coarser.symbol    = "MSFT";
+    coarser.tick_size = 10;
+
+    OrderInsertedEvents live_inserted;
+    {
+        MyExchange exchange(config);
+        exchange.OnOrderInserted = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+
+        exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+        BOOST_REQUIRE(exchange.HaltSymbol("AAPL"));
+        exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 2);
+        BOOST_REQUIRE(exchange.ResumeSymbol("AAPL"));
+        exchange.InsertOrder("AAPL", Side::Buy, 101, 10, 3);
+        BOOST_REQUIRE_EQUAL(exchange.AddSymbol(listed), 3u);
+        exchange.InsertOrder(listed.symbol, Side::Sell, 105, 1, 4);
+        BOOST_REQUIRE_EQUAL(exchange.AddSymbol(coarser), exchange.FindSymbol("MSFT"));
+        exchange.InsertOrder("MSFT", Side::Sell, 105, 1, 5);
+        BOOST_REQUIRE(exchange.HaltSymbol("GOOG"));
+
+        live_inserted.swap(mOrderInsertedEvents);
+    }
+    BOOST_REQUIRE_EQUAL(live_inserted.size(), 5);
+    BOOST_CHECK_EQUAL(std::get<1>(live_inserted[1]), InsertError::SymbolNotFound);
+    BOOST_CHECK_EQUAL(std::get<1>(live_inserted[4]), InsertError::InvalidPrice);
+
+    MyExchange replayed(config);
+    replayed.OnOrderInserted = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    // 3 inserts, 2 halts and a resume, and the listings with their 3 name records
+    BOOST_CHECK_EQUAL(replayed.Replay(), 11u);
+    // Rejected inserts were never journaled, the accepted ones get their ids back
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 3);
+    BOOST_CHECK(mOrderInsertedEvents[0] == live_inserted[0]);
+    BOOST_CHECK(mOrderInsertedEvents[1] == live_inserted[2]);
+    BOOST_CHECK(mOrderInsertedEvents[2] == live_inserted[3]);
+
+    // The books carry on with the symbols and parameters of the live run
+    BOOST_CHECK_EQUAL(replayed.FindSymbol(listed.symbol), 3u);
+    replayed.InsertOrder("GOOG", Side::Buy, 10, 1, 6);
+    BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents.back()), InsertError::SymbolNotFound);
+    replayed.InsertOrder("MSFT", Side::Sell, 110, 1, 7);
+    BOOST_CHECK(mOrderInsertedEvents.back() == OrderInsertedEvent(7, InsertError::OK, 4));
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestSnapshotRestoresQueuesAndIds)
+{
+    const char* path = "test_snapshot.bin";
+    ExchangeConfig config;
+    config.matching = true;
+    {
+        MyExchange exchange(config);
+        exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+        exchange.InsertOrder("AAPL", Side::Buy, 100, 20, 2);
+        exchange.InsertOrder("AAPL", Side::Buy, 99, 5, 3);
+        exchange.InsertOrder("AAPL", Side::Sell, 105, 7, 4);
+        exchange.InsertOrder("MSFT", Side::Sell, 50, 1, 5);
+        exchange.DeleteOrder(5);
+        exchange.HaltSymbol("GOOG");
+        BOOST_REQUIRE(exchange.SaveSnapshot(path));
+
+        // Orders entered after the fork are not part of the background snapshot
+        BOOST_REQUIRE(exchange.StartSnapshot(std::string(path) + ".async"));
+        exchange.InsertOrder("AAPL", Side::Buy, 101, 1, 6);
+        BOOST_CHECK(exchange.WaitSnapshot());
+    }
+
+    for (std::string image : {std::string(path), std::string(path) + ".async"})
+    {
+        MyExchange restored(config);
+        restored.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+        restored.OnOrderDeleted     = std::bind(&ExchangeFixtures::OrderDeletedHandler, this, _1, _2);
+        restored.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+        restored.LoadSnapshot(image);
+        std::remove(image.c_str());
+        BOOST_CHECK(mBestPriceChangedEvents.empty());
+        mOrderInsertedEvents.clear();
+        mOrderDeletedEvents.clear();
+
+        // The sweep fills order 1 ahead of order 2, then reaches 99
+        restored.InsertOrder("AAPL", Side::Sell, 99, 32, 10);
+        BOOST_CHECK_EQUAL(std::get<2>(mOrderInsertedEvents.back()), 6);
+        BOOST_CHECK(mBestPriceChangedEvents.back() == BestPriceChangedEvent("AAPL", 99, 3, 105, 7));
+        restored.DeleteOrder(4);
+        restored.DeleteOrder(5);
+        BOOST_CHECK(mOrderDeletedEvents[0] == OrderDeletedEvent(4, DeleteError::OK));
+        BOOST_CHECK(mOrderDeletedEvents[1] == OrderDeletedEvent(5, DeleteError::OrderNotFound));
+        restored.InsertOrder("GOOG", Side::Buy, 10, 1, 11);
+        BOOST_CHECK_EQUAL(std::get<1>(mOrderInsertedEvents.back()), InsertError::SymbolNotFound);
+        mBestPriceChangedEvents.clear();
+    }
+
+    // A snapshot needs an empty exchange and a valid image
+    MyExchange busy(config);
+    busy.InsertOrder("AAPL", Side::Buy, 100, 1, 1);
+    BOOST_CHECK_THROW(busy.LoadSnapshot(path), std::runtime_error);
+    MyExchange empty(config);
+    BOOST_CHECK_THROW(empty.LoadSnapshot(path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestSnapshotResumesJournalReplay)
+{
+    const char* journal  = "test_journal.bin";
+    const char* snapshot = "test_snapshot.bin";
+    std::remove(journal);
+    ExchangeConfig config;
+    config.journal_file = journal;
+    {
+        MyExchange exchange(config);
+        exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+        exchange.InsertOrder("AAPL", Side::Sell, 110, 10, 2);
+        BOOST_REQUIRE(exchange.SaveSnapshot(snapshot));
+        exchange.DeleteOrder(1);
+        exchange.InsertOrder("AAPL", Side::Buy, 95, 3, 3);
+    }
+
+    MyExchange restored(config);
+    restored.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    restored.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+    restored.LoadSnapshot(snapshot);
+    std::remove(snapshot);
+    // Only the delete and the insert after the snapshot are replayed
+    BOOST_CHECK_EQUAL(restored.Replay(), 2u);
+    BOOST_REQUIRE_EQUAL(mOrderInsertedEvents.size(), 1);
+    BOOST_CHECK(mOrderInsertedEvents[0] == OrderInsertedEvent(3, InsertError::OK, 3));
+    BOOST_CHECK(mBestPriceChangedEvents.back() == BestPriceChangedEvent("AAPL", 95, 3, 110, 10));
+    std::remove(journal);
+}
+
+BOOST_AUTO_TEST_CASE(TestDepthFeedPublishesLevelChanges)
+{
+    ExchangeConfig config;
+    config.matching       = true;
+    config.depth_capacity = 16;
+    MyExchange     exchange(config);
+    const SymbolId aapl = exchange.FindSymbol("AAPL");
+    using Action        = DepthUpdate::Action;
+    using Level         = std::tuple<std::uint64_t, Action, std::uint8_t, Price, Volume>;
+    auto drain          = [&]() {
+        std::vector<Level> levels;
+        for (std::size_t i = 0; i < exchange.Depth().Size(); ++i)
+        {
+            const DepthUpdate& update = exchange.Depth().Updates()[i];
+            BOOST_CHECK_EQUAL(update.symbol, aapl);
+            levels.emplace_back(update.sequence, update.action, update.side, update.price, update.volume);
+        }
+        exchange.Depth().Clear();
+        return levels;
+    };
+    const std::uint8_t buy  = std::uint8_t(Side::Buy);
+    const std::uint8_t sell = std::uint8_t(Side::Sell);
+
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 5, 2);
+    exchange.InsertOrder("AAPL", Side::Buy, 99, 7, 3);
+    exchange.InsertOrder("AAPL", Side::Sell, 100, 12, 4);  // fills order 1 and part of order 2
+    exchange.DeleteOrder(3);
+    exchange.InsertOrder("AAPL", Side::Buy, 0, 7, 5);  // rejected, nothing changes
+    BOOST_CHECK(drain()
+                == std::vector<Level>({Level(1, Action::Add, buy, 100, 10),
+                                       Level(2, Action::Modify, buy, 100, 15),
+                                       Level(3, Action::Add, buy, 99, 7),
+                                       Level(4, Action::Modify, buy, 100, 5),
+                                       Level(5, Action::Modify, buy, 100, 3),
+                                       Level(6, Action::Delete, buy, 99, 0)}));
+
+    exchange.InsertOrder("AAPL", Side::Sell, 101, 4, 6);
+    BOOST_CHECK(exchange.RequestDepthSnapshot(aapl));
+    BOOST_CHECK(!exchange.RequestDepthSnapshot(kInvalidSymbol));
+    BOOST_CHECK(drain()
+                == std::vector<Level>({Level(7, Action::Add, sell, 101, 4),
+                                       Level(8, Action::Clear, buy, 0, 0),
+                                       Level(9, Action::Add, buy, 100, 3),
+                                       Level(10, Action::Add, sell, 101, 4)}));
+
+    // Updates past the capacity are dropped, leaving a sequence gap
+    for (Price price = 1; price <= 20; ++price)
+    {
+        exchange.InsertOrder("AAPL", Side::Buy, price, 1, 7);
+    }
+    BOOST_CHECK_EQUAL(exchange.Depth().Size(), 16u);
+    BOOST_CHECK_EQUAL(exchange.Depth().Sequence(), 30u);
+    BOOST_CHECK(!exchange.RequestDepthSnapshot(aapl));
+    exchange.Depth().Clear();
+    exchange.InsertOrder("AAPL", Side::Buy, 21, 1, 8);
+    BOOST_CHECK_EQUAL(exchange.Depth().Updates()[0].sequence, 31u);
+}
+
+BOOST_AUTO_TEST_CASE(TestAmendKeepsPriorityOnDecreaseAndMovesOnReprice)
+{
+    ExchangeConfig config;
+    config.matching = true;
+    MyExchange exchange(config);
+    exchange.OnOrderInserted    = std::bind(&ExchangeFixtures::OrderInsertedHandler, this, _1, _2, _3);
+    exchange.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+    std::vector<std::tuple<OrderId, AmendError>> amended;
+    exchange.OnOrderAmended = [&](OrderId orderId, AmendError error) { amended.emplace_back(orderId, error); };
+    std::vector<std::tuple<OrderId, OrderId, Volume>> trades;
+    exchange.OnTrade = [&](const std::string&, OrderId aggressorId, OrderId restingId, Price, Volume volume) {
+        trades.emplace_back(aggressorId, restingId, volume);
+    };
+
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 2);
+    exchange.InsertOrder("AAPL", Side::Sell, 110, 5, 3);
+    mBestPriceChangedEvents.clear();
+
+    // Smaller volume at the same price keeps order 1 ahead of order 2
+    exchange.AmendOrder(1, 100, 4);
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 1);
+    BOOST_CHECK(mBestPriceChangedEvents[0] == BestPriceChangedEvent("AAPL", 100, 14, 110, 5));
+    exchange.InsertOrder("AAPL", Side::Sell, 100, 5, 4);
+    BOOST_REQUIRE_EQUAL(trades.size(), 2);
+    BOOST_CHECK(trades[0] == std::make_tuple(4, 1, Volume(4)));
+    BOOST_CHECK(trades[1] == std::make_tuple(4, 2, Volume(1)));
+
+    // Repricing keeps the id, moves the order and reports the book once
+    mBestPriceChangedEvents.clear();
+    exchange.AmendOrder(2, 105, 9);
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 1);
+    BOOST_CHECK(mBestPriceChangedEvents[0] == BestPriceChangedEvent("AAPL", 105, 9, 110, 5));
+
+    // A crossing reprice matches first, then rests the remainder
+    mBestPriceChangedEvents.clear();
+    exchange.AmendOrder(2, 110, 12);
+    BOOST_CHECK(trades.back() == std::make_tuple(2, 3, Volume(5)));
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 1);
+    BOOST_CHECK(mBestPriceChangedEvents[0] == BestPriceChangedEvent("AAPL", 110, 7, 0, 0));
+
+    exchange.AmendOrder(2, 111, 0);
+    exchange.AmendOrder(2, 0, 1);
+    exchange.AmendOrder(3, 110, 1);
+    BOOST_REQUIRE_EQUAL(amended.size(), 6);
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        BOOST_CHECK(std::get<1>(amended[i]) == AmendError::OK);
+    }
+    BOOST_CHECK(std::get<1>(amended[3]) == AmendError::InvalidVolume);
+    BOOST_CHECK(std::get<1>(amended[4]) == AmendError::InvalidPrice);
+    BOOST_CHECK(std::get<1>(amended[5]) == AmendError::OrderNotFound);
+    // Amends do not use up order ids
+    exchange.InsertOrder("AAPL", Side::Buy, 90, 1, 5);
+    BOOST_CHECK_EQUAL(std::get<2>(mOrderInsertedEvents.back()), 5);
+}
+
+BOOST_AUTO_TEST_CASE(TestSessionsOnlyDeleteAndAmendTheirOwnOrders)
+{
+    MyExchange           exchange;
+    std::vector<OrderId> ids;
+    exchange.OnOrderInserted = [&](UserReference, InsertError, OrderId orderId) { ids.push_back(orderId); };
+    std::vector<DeleteError> deletes;
+    std::vector<AmendError>  amends;
+    exchange.OnOrderDeleted = [&](OrderId, DeleteError error) { deletes.push_back(error); };
+    exchange.OnOrderAmended = [&](OrderId, AmendError error) { amends.push_back(error); };
+
+    SymbolId aapl = exchange.FindSymbol("AAPL");
+    exchange.InsertOrder(aapl, Side::Buy, 100, 10, 1, 1);
+    exchange.InsertOrder(aapl, Side::Buy, 100, 10, 2, 2);
+
+    exchange.DeleteOrder(ids[0], 2);
+    exchange.AmendOrder(ids[0], 101, 5, 2);
+    OrderCommand batch[] = {OrderCommand::Delete(ids[1], 1), OrderCommand::Amend(ids[1], 99, 5, 1)};
+    exchange.ProcessBatch(batch, 2);
+    BOOST_CHECK((deletes == std::vector<DeleteError>{DeleteError::OrderNotFound, DeleteError::OrderNotFound}));
+    BOOST_CHECK((amends == std::vector<AmendError>{AmendError::OrderNotFound, AmendError::OrderNotFound}));
+
+    // The owner, and callers without a session, may
+    exchange.AmendOrder(ids[0], 101, 5, 1);
+    exchange.DeleteOrder(ids[0], 1);
+    exchange.DeleteOrder(ids[1]);
+    BOOST_CHECK(amends.back() == AmendError::OK);
+    BOOST_CHECK((deletes == std::vector<DeleteError>{
+                     DeleteError::OrderNotFound, DeleteError::OrderNotFound, DeleteError::OK, DeleteError::OK}));
+}
+
+BOOST_AUTO_TEST_CASE(TestMassCancelBySessionSymbolAndSide)
+{
+    std::vector<std::vector<OrderId>> cancelled;
+    mExchange.OnOrdersCancelled = [&](const OrderId* orderIds, std::size_t count) {
+        cancelled.emplace_back(orderIds, orderIds + count);
+    };
+    SymbolId aapl = mExchange.FindSymbol("AAPL");
+    SymbolId goog = mExchange.FindSymbol("GOOG");
+    SymbolId msft = mExchange.FindSymbol("MSFT");
+
+    mExchange.InsertOrder(aapl, Side::Buy, 100, 10, 1, 1);
+    mExchange.InsertOrder(aapl, Side::Sell, 110, 5, 2, 2);
+    mExchange.InsertOrder(goog, Side::Buy, 200, 10, 3, 1);
+    mExchange.InsertOrder(aapl, Side::Buy, 100, 3, 4, 2);
+    mExchange.InsertOrder(goog, Side::Sell, 210, 4, 5, 2);
+    mExchange.InsertOrder(msft, Side::Buy, 50, 1, 6, 2);
+    mBestPriceChangedEvents.clear();
+
+    // A session spans symbols, each book is reported once
+    BOOST_CHECK_EQUAL(mExchange.MassCancel(MassCancelFilter::Session(1)), 2);
+    BOOST_REQUIRE_EQUAL(cancelled.size(), 1);
+    std::sort(cancelled[0].begin(), cancelled[0].end());
+    BOOST_CHECK(cancelled[0] == std::vector<OrderId>({1, 3}));
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 2);
+    std::sort(mBestPriceChangedEvents.begin(), mBestPriceChangedEvents.end());
+    BOOST_CHECK(mBestPriceChangedEvents[0] == BestPriceChangedEvent("AAPL", 100, 3, 110, 5));
+    BOOST_CHECK(mBestPriceChangedEvents[1] == BestPriceChangedEvent("GOOG", 0, 0, 210, 4));
+
+    mBestPriceChangedEvents.clear();
+    BOOST_CHECK_EQUAL(mExchange.MassCancel(MassCancelFilter::SymbolSide(aapl, Side::Sell)), 1);
+    BOOST_CHECK(cancelled.back() == std::vector<OrderId>({2}));
+    BOOST_CHECK_EQUAL(mExchange.MassCancel(MassCancelFilter::Symbol(goog)), 1);
+    BOOST_CHECK(cancelled.back() == std::vector<OrderId>({5}));
+    BOOST_REQUIRE_EQUAL(mBestPriceChangedEvents.size(), 2);
+    BOOST_CHECK(mBestPriceChangedEvents[0] == BestPriceChangedEvent("AAPL", 100, 3, 0, 0));
+    BOOST_CHECK(mBestPriceChangedEvents[1] == BestPriceChangedEvent("GOOG", 0, 0, 0, 0));
+
+    // Nothing left to cancel means no batch
+    BOOST_CHECK_EQUAL(mExchange.MassCancel(MassCancelFilter::Session(1)), 0);
+    BOOST_CHECK_EQUAL(cancelled.size(), 3);
+    mExchange.DeleteOrder(1);
+    BOOST_CHECK(mOrderDeletedEvents.back() == OrderDeletedEvent(1, DeleteError::OrderNotFound));
+
+    // Orders cancelled in bulk leave the session chain intact for the rest
+    BOOST_CHECK_EQUAL(mExchange.MassCancel(MassCancelFilter::Session(2)), 2);
+    std::sort(cancelled.back().begin(), cancelled.back().end());
+    BOOST_CHECK(cancelled.back() == std::vector<OrderId>({4, 6}));
+    mExchange.InsertOrder(aapl, Side::Buy, 101, 2, 7, 1);
+    BOOST_CHECK_EQUAL(mExchange.MassCancel(MassCancelFilter::Symbol(aapl)), 1);
+    BOOST_CHECK(cancelled.back() == std::vector<OrderId>({7}));
+    BOOST_CHECK_EQUAL(mExchange.MassCancel(MassCancelFilter::Session(1)), 0);
+}
+
+// Records the events it cares about, the rest fall through to NullListener
+struct RecordingListener : NullListener
+{
+    void OnOrderInserted(const OrderInsertedEvent& event) { inserted.push_back(event.orderId); }
+    void OnBestPriceChanged(const BestPriceChangedEvent& event) { best.push_back(event); }
+    void OnTrade(const TradeEvent& event) { trades.push_back(event); }
+
+    std::vector<OrderId>                 inserted;
+    std::vector<::BestPriceChangedEvent> best;
+    std::vector<TradeEvent>              trades;
+};
+
+BOOST_AUTO_TEST_CASE(TestStaticListenerReceivesPlainEvents)
+{
+    ExchangeConfig config;
+    config.matching = true;
+    BasicExchange<RecordingListener> exchange(config);
+    RecordingListener&               listener = exchange.EventListener();
+    SymbolId                         msft     = exchange.FindSymbol("MSFT");
+
+    exchange.InsertOrder("MSFT", Side::Buy, 100, 10, 1);
+    exchange.InsertOrder("MSFT", Side::Sell, 100, 4, 2);
+    exchange.DeleteOrder(1);
+
+    BOOST_CHECK(listener.inserted == std::vector<OrderId>({1, 2}));
+    BOOST_REQUIRE_EQUAL(listener.trades.size(), 1);
+    BOOST_CHECK_EQUAL(listener.trades[0].symbol, msft);
+    BOOST_CHECK_EQUAL(listener.trades[0].aggressorId, 2);
+    BOOST_CHECK_EQUAL(listener.trades[0].restingId, 1);
+    BOOST_CHECK_EQUAL(listener.trades[0].volume, 4);
+    BOOST_REQUIRE_EQUAL(listener.best.size(), 3);
+    BOOST_CHECK_EQUAL(listener.best[1].totalBidVolume, 6);
+    BOOST_CHECK_EQUAL(listener.best[2].bestBid, 0);
+
+    // The std::function members are not used with a listener
+    bool called             = false;
+    exchange.OnOrderDeleted = [&](OrderId, DeleteError) { called = true; };
+    exchange.DeleteOrder(1);
+    BOOST_CHECK(!called);
+}
+
+#if EXCHANGE_METRICS
+BOOST_AUTO_TEST_CASE(TestMetricsCountOperationsAndBookGauges)
+{
+    ExchangeConfig config;
+    config.matching = true;
+    MyExchange exchange(config);
+    SymbolId   aapl = exchange.FindSymbol("AAPL");
+
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+    exchange.InsertOrder("AAPL", Side::Buy, 101, 10, 2);
+    exchange.InsertOrder("AAPL", Side::Sell, 110, 5, 3);
+    exchange.InsertOrder("AAPL", Side::Buy, 0, 5, 4);
+    exchange.InsertOrder("NONE", Side::Buy, 100, 5, 5);
+    exchange.InsertOrder("AAPL", Side::Sell, 101, 10, 6);
+    exchange.DeleteOrder(3);
+    exchange.DeleteOrder(3);
+
+    MetricsSnapshot snapshot;
+    exchange.Metrics().Snapshot(snapshot);
+    BOOST_CHECK_EQUAL(snapshot.insert_results[std::size_t(InsertError::OK)], 4);
+    BOOST_CHECK_EQUAL(snapshot.insert_results[std::size_t(InsertError::InvalidPrice)], 1);
+    BOOST_CHECK_EQUAL(snapshot.insert_results[std::size_t(InsertError::SymbolNotFound)], 1);
+    BOOST_CHECK_EQUAL(snapshot.delete_results[std::size_t(DeleteError::OK)], 1);
+    BOOST_CHECK_EQUAL(snapshot.delete_results[std::size_t(DeleteError::OrderNotFound)], 1);
+    BOOST_CHECK_EQUAL(snapshot.trades, 1);
+    // 100, 101 and 110 were created, 101 was swept and 110 deleted
+    BOOST_CHECK_EQUAL(snapshot.level_creates, 3);
+    BOOST_CHECK_EQUAL(snapshot.level_erases, 2);
+    BOOST_CHECK_EQUAL(snapshot.insert_ticks.Count(), 6);
+    BOOST_CHECK_EQUAL(snapshot.delete_ticks.Count(), 2);
+    // Only callbacks actually set are timed
+    BOOST_CHECK_EQUAL(snapshot.callback_ticks.Count(), 0);
+    BOOST_CHECK(snapshot.pool_bytes > 0);
+
+    BOOST_REQUIRE_EQUAL(snapshot.books.size(), 3);
+    const BookGauges& book = snapshot.books[aapl];
+    BOOST_CHECK_EQUAL(book.orders, 1);
+    BOOST_CHECK_EQUAL(book.bid_levels, 1);
+    BOOST_CHECK_EQUAL(book.ask_levels, 0);
+    BOOST_CHECK(book.memory_bytes > 0);
+
+    exchange.OnOrderDeleted = [](OrderId, DeleteError) {};
+    exchange.DeleteOrder(1);
+    exchange.Metrics().Snapshot(snapshot);
+    BOOST_CHECK_EQUAL(snapshot.callback_ticks.Count(), 1);
+    BOOST_CHECK_EQUAL(snapshot.books[aapl].orders, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestMetricsDoNotTimeStaticListeners)
+{
+    BasicExchange<RecordingListener> exchange;
+    exchange.InsertOrder("MSFT", Side::Buy, 100, 10, 1);
+    exchange.DeleteOrder(1);
+
+    MetricsSnapshot snapshot;
+    exchange.Metrics().Snapshot(snapshot);
+    BOOST_CHECK_EQUAL(exchange.EventListener().inserted.size(), 1);
+    BOOST_CHECK_EQUAL(snapshot.insert_ticks.Count(), 1);
+    BOOST_CHECK_EQUAL(snapshot.callback_ticks.Count(), 0);
+}
+#endif
+
+// Blocking client of the test gateway
+int ConnectGateway(const char* path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    BOOST_REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    return fd;
+}
+
+template <typename Message>
+void SendWire(int fd, const Message& message)
+{
+    BOOST_REQUIRE(::send(fd, &message, sizeof(message), MSG_NOSIGNAL) == ssize_t(sizeof(message)));
+}
+
+template <typename Ack>
+Ack ReceiveWire(int fd)
+{
+    Ack         ack;
+    std::size_t received = 0;
+    while (received < sizeof(ack))
+    {
+        ssize_t result = ::recv(fd, reinterpret_cast<char*>(&ack) + received, sizeof(ack) - received, 0);
+        BOOST_REQUIRE(result > 0);
+        received += std::size_t(result);
+    }
+    return ack;
+}
+
+BOOST_AUTO_TEST_CASE(TestGatewayAcksRequestsAndCancelsOnDisconnect)
+{
+    const char*   path = "test_gateway.sock";
+    GatewayConfig config;
+    config.unix_path = path;
+    Gateway     gateway(config);
+    std::thread server([&] { gateway.Run(); });
+
+    WireInsert insert       = MakeWire<WireInsert>(WireType::Insert);
+    insert.symbol           = 0;
+    insert.side             = std::uint8_t(Side::Buy);
+    insert.price            = 100;
+    insert.volume           = 10;
+    insert.userReference    = 1;
+    WireInsert bad_price    = insert;
+    bad_price.price         = 0;
+    bad_price.userReference = 2;
+    WireAmend amend         = MakeWire<WireAmend>(WireType::Amend);
+    amend.orderId           = 1;
+    amend.price             = 101;
+    amend.volume            = 5;
+    WireDelete unknown      = MakeWire<WireDelete>(WireType::Delete);
+    unknown.orderId         = 99;
+
+    // Pipelined requests are acked in order
+    int first = ConnectGateway(path);
+    SendWire(first, insert);
+    SendWire(first, bad_price);
+    SendWire(first, amend);
+    SendWire(first, unknown);
+    WireInsertAck inserted = ReceiveWire<WireInsertAck>(first);
+    BOOST_CHECK(inserted.header.type == WireType::InsertAck);
+    BOOST_CHECK_EQUAL(inserted.userReference, 1);
+    BOOST_CHECK_EQUAL(inserted.orderId, 1);
+    BOOST_CHECK_EQUAL(inserted.error, std::uint8_t(InsertError::OK));
+    WireInsertAck rejected = ReceiveWire<WireInsertAck>(first);
+    BOOST_CHECK_EQUAL(rejected.userReference, 2);
+    BOOST_CHECK_EQUAL(rejected.error, std::uint8_t(InsertError::InvalidPrice));
+    WireAmendAck amended = ReceiveWire<WireAmendAck>(first);
+    BOOST_CHECK(amended.header.type == WireType::AmendAck);
+    BOOST_CHECK_EQUAL(amended.error, std::uint8_t(AmendError::OK));
+    WireDeleteAck missing = ReceiveWire<WireDeleteAck>(first);
+    BOOST_CHECK_EQUAL(missing.orderId, 99);
+    BOOST_CHECK_EQUAL(missing.error, std::uint8_t(DeleteError::OrderNotFound));
+
+    // The orders of a client that goes away are cancelled
+    int second = ConnectGateway(path);
+    insert.userReference = 3;
+    SendWire(second, insert);
+    BOOST_CHECK_EQUAL(ReceiveWire<WireInsertAck>(second).orderId, 2);
+    ::close(first);
+    while (gateway.Connections() != 1)
+    {
+        std::this_thread::yield();
+    }
+    WireDelete request = MakeWire<WireDelete>(WireType::Delete);
+    request.orderId    = 1;
+    SendWire(second, request);
+    BOOST_CHECK_EQUAL(ReceiveWire<WireDeleteAck>(second).error, std::uint8_t(DeleteError::OrderNotFound));
+    request.orderId = 2;
+    SendWire(second, request);
+    BOOST_CHECK_EQUAL(ReceiveWire<WireDeleteAck>(second).error, std::uint8_t(DeleteError::OK));
+
+    ::close(second);
+    gateway.Stop();
+    server.join();
+}
+
+BOOST_AUTO_TEST_CASE(TestSharedMarketDataTopOfBookAndLog)
+{
+    ExchangeConfig config;
+    config.market_data_name    = "/tibra_test_market_data";
+    config.market_data_log     = 4;
+    config.market_data_symbols = 4;
+    // Whatever a crashed run left behind
+    config.market_data_replace = true;
+    MyExchange           exchange(config);
+    MarketDataSubscriber subscriber(config.market_data_name);
+    BOOST_CHECK_EQUAL(subscriber.SymbolCount(), 4);
+
+    // Another exchange may not take the segment from its readers
+    config.market_data_replace = false;
+    BOOST_CHECK_THROW(MyExchange second(config), std::runtime_error);
+
+    // Intraday listings get a slot until the table is full
+    SymbolParams listed;
+    listed.symbol = "TSLA";
+    BOOST_CHECK_EQUAL(exchange.AddSymbol(listed), 3u);
+    listed.symbol = "NVDA";
+    BOOST_CHECK(exchange.AddSymbol(listed) == kInvalidSymbol);
+
+    TopOfBook top;
+    BOOST_REQUIRE(subscriber.ReadTopOfBook(0, top));
+    BOOST_CHECK_EQUAL(top.sequence, 0);
+    MarketDataUpdate update;
+    BOOST_CHECK(subscriber.Next(update) == MarketDataSubscriber::Status::Empty);
+
+    // A new level logs its depth, then the best price
+    exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+    BOOST_REQUIRE(subscriber.Next(update) == MarketDataSubscriber::Status::Ok);
+    BOOST_CHECK(update.type == MarketDataUpdate::Type::Depth);
+    BOOST_CHECK(update.action == DepthUpdate::Action::Add);
+    BOOST_CHECK_EQUAL(update.price, 100);
+    BOOST_CHECK_EQUAL(update.volume, 10);
+    BOOST_REQUIRE(subscriber.Next(update) == MarketDataSubscriber::Status::Ok);
+    BOOST_CHECK(update.type == MarketDataUpdate::Type::BestPrice);
+    BOOST_CHECK_EQUAL(update.symbol, 0);
+    BOOST_CHECK_EQUAL(update.price, 100);
+    BOOST_CHECK_EQUAL(update.ask_price, 0);
+    BOOST_CHECK(subscriber.Next(update) == MarketDataSubscriber::Status::Empty);
+
+    // A reader that falls a whole log behind sees the overrun and resyncs
+    // from the table
+    exchange.InsertOrder("AAPL", Side::Sell, 105, 3, 2);
+    exchange.InsertOrder("AAPL", Side::Sell, 104, 4, 3);
+    exchange.InsertOrder("MSFT", Side::Buy, 50, 7, 4);
+    BOOST_CHECK(subscriber.Next(update) == MarketDataSubscriber::Status::Overrun);
+    subscriber.Resync();
+    BOOST_CHECK_EQUAL(subscriber.NextSequence(), 9);
+    BOOST_REQUIRE(subscriber.ReadTopOfBook(0, top));
+    BOOST_CHECK_EQUAL(top.bid, 100);
+    BOOST_CHECK_EQUAL(top.bid_volume, 10);
+    BOOST_CHECK_EQUAL(top.ask, 104);
+    BOOST_CHECK_EQUAL(top.ask_volume, 4);
+    BOOST_CHECK_EQUAL(top.sequence, 6);
+    BOOST_REQUIRE(subscriber.ReadTopOfBook(1, top));
+    BOOST_CHECK_EQUAL(top.bid, 50);
+    BOOST_CHECK_EQUAL(top.sequence, 8);
+    BOOST_CHECK(!subscriber.ReadTopOfBook(4, top));
+
+    exchange.DeleteOrder(4);
+    BOOST_REQUIRE(subscriber.Next(update) == MarketDataSubscriber::Status::Ok);
+    BOOST_CHECK(update.action == DepthUpdate::Action::Delete);
+    BOOST_CHECK_EQUAL(update.symbol, 1);
+    BOOST_REQUIRE(subscriber.Next(update) == MarketDataSubscriber::Status::Ok);
+    BOOST_CHECK_EQUAL(update.price, 0);
+
+    // A replaced publisher leaves the segment that replaced it alone
+    const char*         name     = "/tibra_test_replaced_market_data";
+    auto                replaced = std::make_unique<MarketDataPublisher>(name, 1, 4, true);
+    MarketDataPublisher replacement(name, 1, 4, true);
+    replaced.reset();
+    BOOST_CHECK_NO_THROW(MarketDataSubscriber{name});
+}
+
+// MyExchange that loses track of the third order it accepts
+class ForgetfulExchange : public IExchange
+{
+  public:
+    ForgetfulExchange()
+    {
+        m_exchange.OnOrderInserted = [this](UserReference userReference, InsertError error, OrderId orderId) {
+            OnOrderInserted(userReference, error, orderId);
+        };
+        m_exchange.OnOrderDeleted = [this](OrderId orderId, DeleteError error) { OnOrderDeleted(orderId, error); };
+        m_exchange.OnBestPriceChanged
+            = [this](const std::string& symbol, Price bid, Volume bid_volume, Price ask, Volume ask_volume) {
+                  OnBestPriceChanged(symbol, bid, bid_volume, ask, ask_volume);
+              };
+    }
+
+    virtual void InsertOrder(
+        const std::string& symbol, Side side, Price price, Volume volume, UserReference userReference) override
+    {
+        m_exchange.InsertOrder(symbol, side, price, volume, userReference);
+    }
+    virtual void DeleteOrder(OrderId orderId) override
+    {
+        if (orderId == 3)
+        {
+            OnOrderDeleted(orderId, DeleteError::OrderNotFound);
+            return;
+        }
+        m_exchange.DeleteOrder(orderId);
+    }
+
+  private:
+    MyExchange m_exchange;
+};
+
+BOOST_AUTO_TEST_CASE(TestDifferentialFuzzFindsAndShrinksDivergence)
+{
+    FuzzOptions options;
+    options.operations = 20000;
+    auto reference     = [] { return FuzzEngine{std::make_unique<MyExchange>(), {}}; };
+    auto ladder        = [] {
+        ExchangeConfig config;
+        config.ladder_levels = 64;
+        return FuzzEngine{std::make_unique<MyExchange>(config), {}};
+    };
+    auto forgetful = [] { return FuzzEngine{std::make_unique<ForgetfulExchange>(), {}}; };
+
+    // Prices over several ladder windows and shallow books, so orders fall
+    // back to the tree and the ladder recenters
+    FuzzOptions wide    = options;
+    wide.min_price      = 1000;
+    wide.max_price      = 1256;
+    wide.delete_percent = 50;
+    BOOST_CHECK(!RunDifferential(GenerateFuzzOps(wide), wide, reference, ladder).failed);
+
+    std::vector<FuzzOp> ops = GenerateFuzzOps(options);
+
+    FuzzResult result = RunDifferential(ops, options, reference, forgetful);
+    BOOST_REQUIRE(result.failed);
+    BOOST_CHECK(result.expected != result.actual);
+
+    // Three accepted inserts and the delete of the last one
+    std::vector<FuzzOp> shrunk = ShrinkFailure(ops, options, reference, forgetful);
+    BOOST_REQUIRE_EQUAL(shrunk.size(), 4);
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+        BOOST_CHECK(shrunk[i].type == FuzzOp::Type::Insert);
+        BOOST_CHECK(shrunk[i].price != 0 && shrunk[i].volume != 0 && shrunk[i].symbol < options.listed_symbols);
+    }
+    BOOST_CHECK(shrunk[3].type == FuzzOp::Type::Delete);
+    BOOST_CHECK_EQUAL(shrunk[3].target, 2);
+    result = RunDifferential(shrunk, options, reference, forgetful);
+    BOOST_CHECK(result.failed);
+    BOOST_CHECK_EQUAL(result.op, 3);
+}
+
+// MyExchange reporting every order id doubled, as an engine numbering
+// orders its own way
+class DoublingExchange : public IExchange
+{
+  public:
+    DoublingExchange()
+    {
+        m_exchange.OnOrderInserted = [this](UserReference userReference, InsertError error, OrderId orderId) {
+            OnOrderInserted(userReference, error, orderId * 2);
+        };
+        m_exchange.OnOrderDeleted = [this](OrderId orderId, DeleteError error) {
+            OnOrderDeleted(orderId > 0 ? orderId * 2 : orderId, error);
+        };
+        m_exchange.OnBestPriceChanged
+            = [this](const std::string& symbol, Price bid, Volume bid_volume, Price ask, Volume ask_volume) {
+                  OnBestPriceChanged(symbol, bid, bid_volume, ask, ask_volume);
+              };
+    }
+
+    virtual void InsertOrder(
+        const std::string& symbol, Side side, Price price, Volume volume, UserReference userReference) override
+    {
+        m_exchange.InsertOrder(symbol, side, price, volume, userReference);
+    }
+    virtual void DeleteOrder(OrderId orderId) override
+    {
+        if (orderId > 0 && orderId % 2 != 0)
+        {
+            OnOrderDeleted(orderId, DeleteError::OrderNotFound);
+            return;
+        }
+        m_exchange.DeleteOrder(orderId > 0 ? orderId / 2 : orderId);
+    }
+
+  private:
+    MyExchange m_exchange;
+};
+
+BOOST_AUTO_TEST_CASE(TestDifferentialFuzzBogusDeletesNeverHitLiveOrders)
+{
+    FuzzOptions options;
+    options.operations = 100000;
+
+    std::vector<FuzzOp> ops   = GenerateFuzzOps(options);
+    std::size_t         bogus = 0;
+    for (const FuzzOp& op : ops)
+    {
+        if (op.type == FuzzOp::Type::Delete && op.target == FuzzOp::kNoTarget)
+        {
+            BOOST_CHECK(op.order_id <= 0);
+            ++bogus;
+        }
+    }
+    BOOST_CHECK(bogus > 0);
+
+    auto reference = [] { return FuzzEngine{std::make_unique<MyExchange>(), {}}; };
+    auto doubling  = [] { return FuzzEngine{std::make_unique<DoublingExchange>(), {}}; };
+    BOOST_CHECK(!RunDifferential(ops, options, reference, doubling).failed);
+}
+
+BOOST_AUTO_TEST_CASE(TestPlacementArenaBacksOrderPool)
+{
+    BOOST_CHECK(PinCurrentThread(-1));
+
+    SymbolParams symbol;
+    symbol.symbol         = "AAPL";
+    symbol.expected_depth = 1 << 16;
+    ExchangeConfig config;
+    config.symbols                = {symbol};
+    config.order_pool.capacity    = 1 << 12;
+    config.placement.arena_bytes  = 1 << 20;
+    config.placement.huge_pages   = HugePages::Huge2MB;
+    config.placement.prefault     = true;
+    config.placement.numa_node    = CpuNumaNode(0);
+
+    // Without reserved huge pages the arena falls back to transparent or
+    // ordinary ones; pool chunks beyond it come from the heap
+    MyExchange         exchange(config);
+    const MemoryArena* arena = exchange.Arena();
+    BOOST_REQUIRE(arena != nullptr);
+    BOOST_CHECK(arena->GetBacking() != MemoryArena::Backing::None);
+    BOOST_CHECK_EQUAL(arena->Size() % (2 << 20), 0);
+    BOOST_CHECK(arena->Used() > 0);
+    BOOST_CHECK(arena->Used() <= arena->Size());
+
+    std::vector<OrderId> inserted;
+    exchange.OnOrderInserted = [&](UserReference, InsertError error, OrderId orderId) {
+        BOOST_CHECK(error == InsertError::OK);
+        inserted.push_back(orderId);
+    };
+    for (UserReference i = 0; i < 20000; ++i)
+    {
+        exchange.InsertOrder("AAPL", i % 2 ? Side::Buy : Side::Sell, i % 2 ? 100 : 101, 1, i);
+    }
+    int deleted = 0;
+    exchange.OnOrderDeleted = [&](OrderId, DeleteError error) { deleted += error == DeleteError::OK; };
+    for (OrderId orderId : inserted)
+    {
+        exchange.DeleteOrder(orderId);
+    }
+    BOOST_CHECK_EQUAL(deleted, 20000);
+
+    // A zero sized arena is never mapped
+    PlacementConfig empty;
+    MemoryArena     none(empty);
+    BOOST_CHECK(none.GetBacking() == MemoryArena::Backing::None);
+    BOOST_CHECK(none.Allocate(8, 8) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(TestConflationSkipsNetNoChangeAndKeepsCadence)
+{
+    using Clock = BestPriceConflator::Clock;
+    BestPriceConflator conflator(3);
+
+    std::vector<::BestPriceChangedEvent> on_demand;
+    std::vector<::BestPriceChangedEvent> paced;
+    auto demand_id = conflator.AddSubscriber([&](const ::BestPriceChangedEvent& event) { on_demand.push_back(event); });
+    auto paced_id  = conflator.AddSubscriber([&](const ::BestPriceChangedEvent& event) { paced.push_back(event); },
+                                            std::chrono::milliseconds(10));
+
+    BasicExchange<ConflatingListener> exchange(ExchangeConfig(), ConflatingListener{{}, &conflator});
+    exchange.InsertOrder(0, Side::Sell, 105, 10, 1);
+    // The best ask flickers away and back
+    exchange.DeleteOrder(1);
+    exchange.InsertOrder(0, Side::Sell, 105, 10, 2);
+    exchange.InsertOrder(1, Side::Buy, 50, 10, 3);
+
+    // Two dirty symbols, one event each with the latest prices
+    BOOST_CHECK_EQUAL(conflator.Dirty(demand_id), 2);
+    BOOST_CHECK_EQUAL(conflator.Publish(demand_id), 2);
+    BOOST_REQUIRE_EQUAL(on_demand.size(), 2);
+    BOOST_CHECK_EQUAL(on_demand[0].symbol, 0);
+    BOOST_CHECK_EQUAL(on_demand[0].bestAsk, 105);
+    BOOST_CHECK_EQUAL(on_demand[0].totalAskVolume, 10);
+    BOOST_CHECK_EQUAL(on_demand[1].bestBid, 50);
+
+    // A delete and insert at the same price nets out to nothing
+    exchange.DeleteOrder(2);
+    exchange.InsertOrder(0, Side::Sell, 105, 10, 4);
+    BOOST_CHECK_EQUAL(conflator.Dirty(demand_id), 1);
+    BOOST_CHECK_EQUAL(conflator.Publish(demand_id), 0);
+    BOOST_CHECK_EQUAL(on_demand.size(), 2);
+
+    // The paced subscriber is published to when due, and on demand ones never
+    Clock::time_point start = Clock::now();
+    BOOST_CHECK_EQUAL(conflator.Poll(start), 2);
+    BOOST_CHECK_EQUAL(paced.size(), 2);
+    exchange.DeleteOrder(4);
+    BOOST_CHECK_EQUAL(conflator.Poll(start + std::chrono::milliseconds(5)), 0);
+    BOOST_CHECK_EQUAL(conflator.Poll(start + std::chrono::milliseconds(10)), 1);
+    BOOST_REQUIRE_EQUAL(paced.size(), 3);
+    BOOST_CHECK_EQUAL(paced[2].bestAsk, 0);
+    BOOST_CHECK_EQUAL(on_demand.size(), 2);
+    BOOST_CHECK_EQUAL(conflator.Dirty(demand_id), 1);
+    BOOST_CHECK_EQUAL(conflator.Dirty(paced_id), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestRiskGateRejectsInsertsBreakingAccountLimits)
+{
+    ExchangeConfig config;
+    config.matching      = true;
+    config.risk.enabled  = true;
+    config.risk.accounts = 2;
+    MyExchange exchange(config);
+
+    RiskLimits limits;
+    limits.max_order_volume    = 100;
+    limits.max_open_orders     = 2;
+    limits.max_symbol_notional = 15000;
+    limits.price_band_bps      = 1000;
+    BOOST_CHECK(exchange.SetAccountLimits(1, limits));
+    BOOST_CHECK(!exchange.SetAccountLimits(2, limits));
+    BOOST_CHECK(exchange.BindSession(7, 1));
+    BOOST_CHECK(!exchange.BindSession(8, 2));
+
+    std::vector<RiskError> rejects;
+    std::vector<OrderId>   accepted;
+    exchange.OnOrderRejected = [&](UserReference, RiskError error) { rejects.push_back(error); };
+    exchange.OnOrderInserted = [&](UserReference, InsertError error, OrderId orderId) {
+        BOOST_CHECK(error == InsertError::OK);
+        accepted.push_back(orderId);
+    };
+
+    exchange.InsertOrder(0, Side::Buy, 100, 101, 1, 7);
+    exchange.InsertOrder(0, Side::Buy, 100, 100, 2, 7);
+    exchange.InsertOrder(0, Side::Buy, 100, 60, 3, 7);
+    BOOST_CHECK_EQUAL(accepted.size(), 1);
+    BOOST_CHECK_EQUAL(exchange.Risk().Notional(1, 0), 10000);
+    // Unbound sessions trade on account 0, which has no limits
+    exchange.InsertOrder(0, Side::Buy, 100, 1000, 4, 8);
+    exchange.InsertOrder(0, Side::Sell, 1000, 1, 5);
+    BOOST_CHECK_EQUAL(accepted.size(), 3);
+    // 10% around the best ask, or the best bid for sells
+    exchange.InsertOrder(0, Side::Buy, 899, 5, 6, 7);
+    exchange.InsertOrder(0, Side::Sell, 111, 10, 7, 7);
+    exchange.InsertOrder(0, Side::Sell, 110, 10, 8, 7);
+    BOOST_CHECK_EQUAL(accepted.size(), 4);
+    BOOST_CHECK_EQUAL(exchange.Risk().OpenOrders(1), 2);
+    exchange.InsertOrder(1, Side::Buy, 100, 10, 9, 7);
+
+    std::vector<RiskError> expected{RiskError::OrderVolume,
+                                    RiskError::SymbolNotional,
+                                    RiskError::PriceBand,
+                                    RiskError::PriceBand,
+                                    RiskError::OpenOrders};
+    BOOST_CHECK(rejects == expected);
+
+    // Fills, amends and deletes give the exposure back
+    exchange.InsertOrder(0, Side::Sell, 100, 40, 11);
+    BOOST_CHECK_EQUAL(exchange.Risk().Notional(1, 0), 7100);
+    AmendError amended = AmendError::OK;
+    exchange.OnOrderAmended = [&](OrderId, AmendError error) { amended = error; };
+    exchange.AmendOrder(accepted[0], 100, 200);
+    BOOST_CHECK(amended == AmendError::RiskRejected);
+    exchange.AmendOrder(accepted[0], 100, 30);
+    BOOST_CHECK(amended == AmendError::OK);
+    BOOST_CHECK_EQUAL(exchange.Risk().Notional(1, 0), 4100);
+    exchange.DeleteOrder(accepted[0]);
+    BOOST_CHECK_EQUAL(exchange.Risk().Notional(1, 0), 1100);
+    BOOST_CHECK_EQUAL(exchange.Risk().OpenOrders(1), 1);
+    exchange.MassCancel(MassCancelFilter::Session(7));
+    BOOST_CHECK_EQUAL(exchange.Risk().OpenOrders(1), 0);
+    BOOST_CHECK_EQUAL(exchange.Risk().Notional(1, 0), 0);
+
+    // Without OnOrderRejected the reject is a SystemError
+    exchange.OnOrderRejected = nullptr;
+    InsertError error        = InsertError::OK;
+    exchange.OnOrderInserted = [&](UserReference, InsertError inserted, OrderId) { error = inserted; };
+    exchange.InsertOrder(0, Side::Buy, 100, 500, 12, 7);
+    BOOST_CHECK(error == InsertError::SystemError);
+}
+
+BOOST_AUTO_TEST_CASE(TestRiskCheckedAmendsAreJournaled)
+{
+    const char* journal = "test_journal.bin";
+    std::remove(journal);
+    ExchangeConfig config;
+    config.journal_file = journal;
+    config.risk.enabled = true;
+    {
+        MyExchange exchange(config);
+        exchange.InsertOrder("AAPL", Side::Buy, 100, 10, 1);
+        exchange.AmendOrder(1, 101, 5);
+    }
+
+    MyExchange restored(config);
+    restored.OnBestPriceChanged = std::bind(&ExchangeFixtures::BestPriceChangedHandler, this, _1, _2, _3, _4, _5);
+    BOOST_CHECK_EQUAL(restored.Replay(), 2u);
+    BOOST_CHECK(mBestPriceChangedEvents.back() == BestPriceChangedEvent("AAPL", 101, 5, 0, 0));
+    std::remove(journal);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadersCopyBooksWhileTheWriterRuns)
+{
+    ExchangeConfig config;
+    config.matching      = true;
+    config.ladder_levels = 64;
+    config.reader_depth  = 3;
+    MyExchange exchange(config);
+
+    TopView   top;
+    DepthView depth;
+    OrderView order;
+    BOOST_CHECK(exchange.GetTopOfBook(0, top));
+    BOOST_CHECK(!exchange.GetTopOfBook(3, top));
+    BOOST_CHECK(!MyExchange().GetTopOfBook(0, top));
+
+    // Levels 20 and 500 fall outside the ladder window, in the tree
+    std::vector<OrderId> ids;
+    exchange.OnOrderInserted = [&](UserReference, InsertError, OrderId orderId) { ids.push_back(orderId); };
+    exchange.InsertOrder(0, Side::Buy, 100, 10, 1);
+    exchange.InsertOrder(0, Side::Buy, 101, 10, 2);
+    exchange.InsertOrder(0, Side::Buy, 20, 10, 3);
+    exchange.InsertOrder(0, Side::Buy, 99, 10, 4);
+    exchange.InsertOrder(0, Side::Sell, 500, 10, 5);
+    exchange.InsertOrder(0, Side::Sell, 105, 10, 6);
+    exchange.InsertOrder(0, Side::Sell, 101, 4, 7);
+
+    BOOST_CHECK(exchange.GetTopOfBook(0, top));
+    BOOST_CHECK_EQUAL(top.bid, 101);
+    BOOST_CHECK_EQUAL(top.bid_volume, 6);
+    BOOST_CHECK_EQUAL(top.ask, 105);
+    BOOST_CHECK(exchange.GetDepth(0, 10, depth));
+    std::vector<Price> bids, asks;
+    for (const DepthLevel& level : depth.bids)
+    {
+        bids.push_back(level.price);
+    }
+    for (const DepthLevel& level : depth.asks)
+    {
+        asks.push_back(level.price);
+    }
+    BOOST_CHECK((bids == std::vector<Price>{101, 100, 99}));
+    BOOST_CHECK((asks == std::vector<Price>{105, 500}));
+    BOOST_CHECK(exchange.GetDepth(0, 1, depth));
+    BOOST_CHECK_EQUAL(depth.bids.size(), 1);
+
+    BOOST_CHECK(exchange.GetOrder(ids[1], order));
+    BOOST_CHECK(order.side == Side::Buy);
+    BOOST_CHECK_EQUAL(order.price, 101);
+    BOOST_CHECK_EQUAL(order.volume, 6);
+    BOOST_CHECK(!exchange.GetOrder(ids[6], order));
+    exchange.DeleteOrder(ids[1]);
+    BOOST_CHECK(!exchange.GetOrder(ids[1], order));
+    BOOST_CHECK(exchange.GetTopOfBook(0, top));
+    BOOST_CHECK_EQUAL(top.bid, 100);
+    exchange.MassCancel(MassCancelFilter());
+    BOOST_CHECK(exchange.GetDepth(0, 10, depth));
+    BOOST_CHECK(depth.bids.empty() && depth.asks.empty());
+    BOOST_CHECK(!exchange.GetOrder(ids[0], order));
+
+    // Every order rests a volume that is a multiple of its price, which
+    // readers must see at every level however the writer is interleaved
+    std::atomic<bool> done{false};
+    std::atomic<int>  last_id{0};
+    std::size_t       broken = 0;
+    std::thread       reader([&] {
+        TopView   seen;
+        DepthView levels;
+        OrderView resting;
+        while (!done.load())
+        {
+            exchange.GetTopOfBook(1, seen);
+            broken += seen.bid != 0 && seen.bid_volume % seen.bid != 0;
+            exchange.GetDepth(1, 3, levels);
+            for (std::size_t i = 0; i < levels.bids.size(); ++i)
+            {
+                broken += levels.bids[i].volume % levels.bids[i].price != 0;
+                broken += i > 0 && levels.bids[i].price >= levels.bids[i - 1].price;
+            }
+            if (exchange.GetOrder(last_id.load() - 3, resting))
+            {
+                broken += resting.volume != resting.price || resting.symbol != 1;
+            }
+        }
+    });
+    std::vector<OrderId> live;
+    exchange.OnOrderInserted = [&](UserReference, InsertError, OrderId orderId) {
+        live.push_back(orderId);
+        last_id.store(orderId);
+    };
+    for (int i = 0; i < 20000; ++i)
+    {
+        Price price = Price(50 + (i * 37) % 100);
+        exchange.InsertOrder(1, Side::Buy, price, price, i);
+        if (live.size() > 50)
+        {
+            exchange.DeleteOrder(live[i % live.size()]);
+            live.erase(live.begin() + i % live.size());
+        }
+    }
+    done.store(true);
+    reader.join();
+    BOOST_CHECK_EQUAL(broken, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadersSeeEachRequestWhole)
+{
+    ExchangeConfig config;
+    config.matching     = true;
+    config.reader_depth = 3;
+    MyExchange exchange(config);
+
+    // Callbacks run before the request is done, so nothing of it is out yet
+    OrderId       inserted = 0;
+    OrderView     order;
+    DepthView     depth;
+    bool          early   = false;
+    std::uint64_t version = exchange.ReaderVersion();
+    exchange.OnOrderInserted    = [&](UserReference, InsertError, OrderId orderId) { inserted = orderId; };
+    exchange.OnBestPriceChanged = [&](const std::string&, Price, Volume, Price, Volume) {
+        early = exchange.GetOrder(inserted, order) || !exchange.GetDepth(0, 3, depth) || !depth.bids.empty()
+                || exchange.ReaderVersion() != version;
+    };
+    exchange.InsertOrder(0, Side::Buy, 100, 10, 1);
+    BOOST_CHECK(!early);
+    BOOST_CHECK_EQUAL(exchange.ReaderVersion(), version + 2);
+    BOOST_CHECK(exchange.GetOrder(inserted, order));
+    BOOST_CHECK(exchange.GetDepth(0, 3, depth));
+    BOOST_REQUIRE_EQUAL(depth.bids.size(), 1);
+    BOOST_CHECK_EQUAL(depth.bids[0].volume, 10);
+
+    // A fill and the level it empties go out together
+    OrderId resting             = inserted;
+    version                     = exchange.ReaderVersion();
+    exchange.OnBestPriceChanged = [&](const std::string&, Price, Volume, Price, Volume) {
+        early = !exchange.GetOrder(resting, order) || !exchange.GetDepth(0, 3, depth) || depth.bids.size() != 1;
+    };
+    exchange.InsertOrder(0, Side::Sell, 100, 10, 2);
+    BOOST_CHECK(!early);
+    BOOST_CHECK_EQUAL(exchange.ReaderVersion(), version + 2);
+    BOOST_CHECK(!exchange.GetOrder(resting, order));
+    BOOST_CHECK(exchange.GetDepth(0, 3, depth));
+    BOOST_CHECK(depth.bids.empty());
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
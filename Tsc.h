@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Cheapest available timestamp: the TSC on x86, steady_clock nanoseconds
+// elsewhere. Ticks are converted to nanoseconds with TscTicksPerNanosecond.
+inline std::uint64_t ReadTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#endif
+}
+
+// Measured once against steady_clock on first use, which takes ~20ms
+inline double TscTicksPerNanosecond()
+{
+    static const double ticks_per_ns = [] {
+        auto          wall_start = std::chrono::steady_clock::now();
+        std::uint64_t tsc_start  = ReadTsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::uint64_t tsc_end  = ReadTsc();
+        auto          wall_end = std::chrono::steady_clock::now();
+        double        ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(wall_end - wall_start).count());
+        return ns > 0 ? double(tsc_end - tsc_start) / ns : 1.0;
+    }();
+    return ticks_per_ns;
+}
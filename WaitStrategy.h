@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Spin-loop hint, lets the sibling hyperthread run while spinning
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// How a thread waits for an empty ring to be refilled
+enum class WaitStrategy
+{
+    BusySpin,  // lowest latency, burns the core
+    Yield,     // spins through sched_yield, gives the core to other runnable threads
+    Futex      // sleeps in the kernel until woken, costs a syscall on both sides
+};
+
+// Event count pairing a ring with a wait strategy. A consumer that found the
+// ring empty calls PrepareWait, checks the ring once more and then Waits with
+// the returned key. A producer calls Notify after publishing, which is a
+// single load unless a consumer is actually waiting.
+class EventCount
+{
+  public:
+    explicit EventCount(WaitStrategy strategy = WaitStrategy::Yield) : m_strategy(strategy) {}
+
+    std::uint32_t PrepareWait()
+    {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        // Orders the increment before the caller's re-check of the ring
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return m_epoch.load(std::memory_order_seq_cst);
+    }
+
+    void CancelWait() { m_waiters.fetch_sub(1, std::memory_order_seq_cst); }
+
+    void Wait(std::uint32_t key)
+    {
+        while (m_epoch.load(std::memory_order_acquire) == key)
+        {
+            switch (m_strategy)
+            {
+            case WaitStrategy::BusySpin:
+                CpuRelax();
+                break;
+            case WaitStrategy::Yield:
+                std::this_thread::yield();
+                break;
+            case WaitStrategy::Futex:
+                Futex(FUTEX_WAIT_PRIVATE, key);
+                break;
+            }
+        }
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void Notify()
+    {
+        // Orders the producer's publish before the waiter check, pairing with
+        // the seq_cst increment in PrepareWait
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (m_strategy == WaitStrategy::Futex)
+        {
+            Futex(FUTEX_WAKE_PRIVATE, INT_MAX);
+        }
+    }
+
+  private:
+    void Futex(int op, std::uint32_t value)
+    {
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&m_epoch), op, value, nullptr, nullptr, 0);
+    }
+
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "futex needs a plain 32 bit word");
+
+    const WaitStrategy         m_strategy;
+    std::atomic<std::uint32_t> m_epoch{0};
+    std::atomic<std::uint32_t> m_waiters{0};
+};
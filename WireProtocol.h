@@ -0,0 +1,107 @@
+#pragma once
+
+#include "ExchangeListener.h"
+#include "IExchange.h"
+#include "SymbolTable.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Order entry protocol of the Gateway. Every message is a fixed-layout struct
+// in host (little endian) byte order starting with a WireHeader whose length
+// covers the whole message. Symbols are SymbolIds in the order the gateway
+// lists them. Each request is answered by exactly one ack, in request order.
+// Messages are copied out of the receive buffer with memcpy, so they need not
+// be aligned.
+
+enum class WireType : std::uint8_t
+{
+    Insert    = 1,
+    Delete    = 2,
+    Amend     = 3,
+    InsertAck = 4,
+    DeleteAck = 5,
+    AmendAck  = 6
+};
+
+struct WireHeader
+{
+    std::uint16_t length;
+    WireType      type;
+    std::uint8_t  reserved;
+};
+
+struct WireInsert
+{
+    WireHeader    header;
+    SymbolId      symbol;
+    Price         price;
+    Volume        volume;
+    UserReference userReference;
+    std::uint8_t  side;
+    std::uint8_t  reserved[3];
+};
+
+struct WireDelete
+{
+    WireHeader header;
+    OrderId    orderId;
+};
+
+struct WireAmend
+{
+    WireHeader header;
+    OrderId    orderId;
+    Price      price;
+    Volume     volume;
+};
+
+// error holds the InsertError, DeleteError or AmendError of the request
+struct WireInsertAck
+{
+    WireHeader    header;
+    UserReference userReference;
+    OrderId       orderId;
+    std::uint8_t  error;
+    // RiskError of an insert the risk gate rejected
+    std::uint8_t risk;
+    std::uint8_t reserved[2];
+};
+
+struct WireDeleteAck
+{
+    WireHeader   header;
+    OrderId      orderId;
+    std::uint8_t error;
+    std::uint8_t reserved[3];
+};
+
+struct WireAmendAck
+{
+    WireHeader   header;
+    OrderId      orderId;
+    std::uint8_t error;
+    std::uint8_t reserved[3];
+};
+
+static_assert(sizeof(WireHeader) == 4, "wire header layout");
+static_assert(sizeof(WireInsert) == 24, "wire insert layout");
+static_assert(sizeof(WireDelete) == 8, "wire delete layout");
+static_assert(sizeof(WireAmend) == 16, "wire amend layout");
+static_assert(sizeof(WireInsertAck) == 16, "wire insert ack layout");
+static_assert(sizeof(WireDeleteAck) == 12, "wire delete ack layout");
+static_assert(sizeof(WireAmendAck) == 12, "wire amend ack layout");
+
+// Largest message either way
+constexpr std::size_t kWireMaxRequest = sizeof(WireInsert);
+constexpr std::size_t kWireMaxAck     = sizeof(WireInsertAck);
+
+// Zeroed message of type Message with its header filled in
+template <typename Message>
+Message MakeWire(WireType type)
+{
+    Message message{};
+    message.header.length = std::uint16_t(sizeof(Message));
+    message.header.type   = type;
+    return message;
+}